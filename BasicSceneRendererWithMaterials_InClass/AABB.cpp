@@ -1,14 +0,0 @@
-#include "AABB.h"
-
-
-
-AABB::AABB()
-{
-	//create bounding box
-
-}
-
-
-AABB::~AABB()
-{
-}
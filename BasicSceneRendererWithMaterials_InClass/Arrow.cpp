@@ -2,20 +2,18 @@
 #include <iostream>
 
 
-Arrow::Arrow()
+Arrow::Arrow(AssetCache& assets)
 {
 	this->isMoving = false;
+	mAssets = &assets;
 
 	glm::vec3 start = glm::vec3(0.0f, 0.0f, 0.0f);
 	glm::vec3 end = glm::vec3(0.0f, 0.0f, 40.0f);
 
-	//Direction Ray Mesh
-	directionRay = CreateLine(start, end);
-
 	//Create ARROW mesh, material and transform
-	mMesh = LoadMesh("meshes/arrow3.obj");
-	Texture* tex = new Texture("textures/water_drops_on_metal.tga", GL_REPEAT, GL_LINEAR);
-	mMaterial = new Material(tex);
+	mMesh = assets.getMesh("meshes/arrow3.obj");
+	mTexture = assets.getTexture("textures/water_drops_on_metal.tga", GL_REPEAT, GL_LINEAR);
+	mMaterial = new Material(mTexture);
 	mMaterial->specular = glm::vec3(1.0f, 1.0f, 1.0f);
 	mMaterial->shininess = 255;
 	mMaterial->emissive = glm::vec3(0.1f, 0.1f, 0.1f);
@@ -25,13 +23,26 @@ Arrow::Arrow()
 	mMax = end;
 
 	//Create child targetEntity
-	Texture* target = new Texture("textures/target.tga", GL_REPEAT, GL_LINEAR);
-	Material* myMaterial = new Material(target);
+	mTargetTexture = assets.getTexture("textures/target.tga", GL_REPEAT, GL_LINEAR);
+	mTargetMaterial = new Material(mTargetTexture);
 	float width = 10.0f;
 	glm::vec3 min = glm::vec3(-0.5f, -0.5f, -0.5f) * width;
 	glm::vec3 max = glm::vec3(0.5f, 0.5f, 0.5f) * width;
-	Mesh* cubeMesh = CreateTexturedCube(width);
-	targetEntity = new Entity(cubeMesh, myMaterial, Transform(0.0f, 0.0f, 30.0f), min, max);
+	mTargetMesh = CreateTexturedCube(width);
+	targetEntity = new Entity(mTargetMesh, mTargetMaterial, Transform(0.0f, 0.0f, 30.0f), min, max);
+}
+
+Arrow::~Arrow()
+{
+	// the target entity is in the scene's list and deleted with the others
+	if (mAssets) {
+		mAssets->release(mMesh);
+		mAssets->release(mTexture);
+		mAssets->release(mTargetTexture);
+		delete mMaterial;
+		delete mTargetMaterial;
+		delete mTargetMesh;
+	}
 }
 
 Arrow::Arrow(const Mesh* mesh, Material* material, const Transform& transform) {
@@ -49,11 +60,15 @@ Arrow::Arrow(const Mesh* mesh, Material* material, const Transform& transform, g
 }
 
 bool Arrow::isIntersecting(Entity* entity) {
+	return isIntersecting(entity->getWorldBounds());
+}
+
+bool Arrow::isIntersecting(const Bounds& bounds) {
 	glm::vec3 org = this->getMin();
 	glm::vec3 dir = glm::normalize(this->getMax() - this->getMin());
 
-	glm::vec3 lb = entity->getMin();  //left bottom of box
-	glm::vec3 rt = entity->getMax();  //right top of box
+	glm::vec3 lb = bounds.min;  //left bottom of box
+	glm::vec3 rt = bounds.max;  //right top of box
 
 	glm::vec3 dirfrac;
 	float t;
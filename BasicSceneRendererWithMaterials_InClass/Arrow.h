@@ -4,25 +4,35 @@
 #include "glshell.h"
 #include "Camera.h"
 #include <algorithm>
-#include "AABB.h"
+#include "AssetCache.h"
 
 
 class Arrow :
 	public Entity
 {
 public:
-	Arrow();
+	Arrow(AssetCache& assets);
 	Arrow(const Mesh* mesh, Material* material, const Transform& transform);
 	Arrow(const Mesh* mesh, Material* material, const Transform& transform, glm::vec3 min, glm::vec3 max);
+	~Arrow();
 
 	void update(float dt);
 	void draw();
 	void shoot();
 	bool isIntersecting(Entity* entity);
+	bool isIntersecting(const Bounds& bounds);	// world-space box
 
 	Entity* targetEntity;
-	Mesh* directionRay;
 	bool isMoving;
 	float elapsedTime = 0;
+
+private:
+	// what the arrow made for itself and its target, and the cache its mesh and textures
+	// came from (NULL if they were passed in)
+	AssetCache* mAssets = NULL;
+	const Texture* mTexture = NULL;
+	const Texture* mTargetTexture = NULL;
+	Material* mTargetMaterial = NULL;
+	Mesh* mTargetMesh = NULL;
 };
 
@@ -0,0 +1,100 @@
+#include "AssetCache.h"
+#include "common.h"
+
+AssetCache::AssetCache()
+    : mHits(0)
+    , mMisses(0)
+{
+}
+
+AssetCache::~AssetCache()
+{
+    clear();
+}
+
+const Texture* AssetCache::getTexture(const std::string& path, GLint wrapMode, GLint filteringMode)
+{
+    std::string key = CanonicalPath(path) + '#' + ToString(wrapMode) + '#' + ToString(filteringMode);
+
+    TextureMap::iterator it = mTextures.find(key);
+    if (it != mTextures.end()) {
+        ++mHits;
+        ++it->second.refs;
+        return it->second.asset;
+    }
+
+    ++mMisses;
+
+    Texture* tex = new Texture(CanonicalPath(path), wrapMode, filteringMode);
+    if (!tex->isValid()) {
+        delete tex;
+        return NULL;
+    }
+
+    Entry<Texture> entry = { tex, 1 };
+    mTextures[key] = entry;
+    mTextureKeys[tex] = key;
+    return tex;
+}
+
+const Mesh* AssetCache::getMesh(const std::string& path)
+{
+    std::string key = CanonicalPath(path);
+
+    MeshMap::iterator it = mMeshes.find(key);
+    if (it != mMeshes.end()) {
+        ++mHits;
+        ++it->second.refs;
+        return it->second.asset;
+    }
+
+    ++mMisses;
+
+    Mesh* mesh = LoadMesh(key);
+    if (!mesh)
+        return NULL;
+
+    Entry<Mesh> entry = { mesh, 1 };
+    mMeshes[key] = entry;
+    mMeshKeys[mesh] = key;
+    return mesh;
+}
+
+template <typename T>
+void AssetCache::Release(std::unordered_map<std::string, Entry<T> >& assets,
+                         std::unordered_map<const T*, std::string>& keys, const T* asset)
+{
+    typename std::unordered_map<const T*, std::string>::iterator key = keys.find(asset);
+    if (key == keys.end())
+        return;
+
+    typename std::unordered_map<std::string, Entry<T> >::iterator it = assets.find(key->second);
+    if (--it->second.refs == 0) {
+        delete it->second.asset;
+        assets.erase(it);
+        keys.erase(key);
+    }
+}
+
+void AssetCache::release(const Texture* tex)
+{
+    Release(mTextures, mTextureKeys, tex);
+}
+
+void AssetCache::release(const Mesh* mesh)
+{
+    Release(mMeshes, mMeshKeys, mesh);
+}
+
+void AssetCache::clear()
+{
+    for (TextureMap::iterator ti = mTextures.begin(); ti != mTextures.end(); ++ti)
+        delete ti->second.asset;
+    mTextures.clear();
+    mTextureKeys.clear();
+
+    for (MeshMap::iterator mi = mMeshes.begin(); mi != mMeshes.end(); ++mi)
+        delete mi->second.asset;
+    mMeshes.clear();
+    mMeshKeys.clear();
+}
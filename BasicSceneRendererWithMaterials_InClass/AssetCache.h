@@ -0,0 +1,63 @@
+#ifndef ASSET_CACHE_H_
+#define ASSET_CACHE_H_
+
+#include "Texture.h"
+#include "Mesh.h"
+
+#include <string>
+#include <unordered_map>
+
+//
+// Loads each texture and mesh file only once and hands out shared pointers to it.
+//
+// Assets are keyed by canonical path (and by wrap/filter mode for textures) and reference
+// counted: every successful getTexture()/getMesh() must be balanced by a release(), and the
+// asset is deleted when its last reference goes away. clear() deletes everything regardless.
+//
+class AssetCache {
+
+    template <typename T>
+    struct Entry {
+        T*          asset;
+        unsigned    refs;
+    };
+
+    // keyed by canonical path (plus sampling state for textures)
+    typedef std::unordered_map<std::string, Entry<Texture> >    TextureMap;
+    typedef std::unordered_map<std::string, Entry<Mesh> >       MeshMap;
+
+    TextureMap  mTextures;
+    MeshMap     mMeshes;
+
+    // the key of each asset handed out, so release() doesn't have to search for it
+    std::unordered_map<const Texture*, std::string>     mTextureKeys;
+    std::unordered_map<const Mesh*, std::string>        mMeshKeys;
+
+    unsigned    mHits;
+    unsigned    mMisses;
+
+    template <typename T>
+    static void     Release(std::unordered_map<std::string, Entry<T> >& assets,
+                            std::unordered_map<const T*, std::string>& keys, const T* asset);
+
+public:
+    AssetCache();
+    ~AssetCache();
+
+    // returns NULL if the file can't be loaded
+    const Texture*  getTexture(const std::string& path, GLint wrapMode = GL_REPEAT, GLint filteringMode = GL_LINEAR);
+    const Mesh*     getMesh(const std::string& path);
+
+    // NULL is ignored, like a failed get
+    void            release(const Texture* tex);
+    void            release(const Mesh* mesh);
+
+    void            clear();
+
+    unsigned        getNumTextures() const      { return mTextures.size(); }
+    unsigned        getNumMeshes() const        { return mMeshes.size(); }
+    unsigned        getHits() const             { return mHits; }
+    unsigned        getMisses() const           { return mMisses; }
+};
+
+#endif
@@ -2,19 +2,156 @@
 #include "Image.h"
 #include "Prefabs.h"
 #include "Arrow.h"
-#include "AABB.h"
+#include "common.h"
+#include "Profiler.h"
 
 #include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+#include <random>
+
+// memory budget for textures managed by the TextureManager
+const size_t TEXTURE_BUDGET_BYTES = 32 * 1024 * 1024;
+
+// projection parameters
+const float FIELD_OF_VIEW = 50.0f;      // vertical, in degrees
+const float Z_NEAR = 0.1f;
+const float Z_FAR = 1000.0f;
+
+// must match MAX_POINT_LIGHTS in BlinnPhongPerFragmentMultiLight-fs.glsl
+const unsigned MAX_SHADER_POINT_LIGHTS = 8;
+
+// directional lights used by the multi-light model
+const int NUM_MULTI_DIR_LIGHTS = 1;
+
+// lights are culled where their brightest channel is attenuated below this
+const float LIGHT_CUTOFF = 0.01f;
+
+// number of small random lights added with toggleExtraPointLights()
+const int NUM_EXTRA_POINT_LIGHTS = 1024;
+
+// per-draw data in the PerDraw uniform block (std140 layout, see the entity shaders)
+struct DrawData {
+    glm::mat4   modelview;
+    glm::vec4   normalMatrix[3];    // mat3 columns are padded to vec4
+    glm::vec4   tint;
+    glm::vec3   emissive;
+    GLint       texLayer;
+    glm::vec3   specular;
+    float       shininess;
+};
+
+static_assert(sizeof(DrawData) == 160, "DrawData must match the std140 layout of the PerDraw block");
+
+// uniform block binding point of the per-draw data
+const GLuint PER_DRAW_BINDING = 0;
+
+// capacity of the per-draw ring (entities plus visualized point lights)
+const unsigned MAX_DRAWS_PER_FRAME = 4096;
+
+// texture units used by deferred lighting (units 0-4 hold material textures and light clusters)
+const int GBUFFER_FIRST_UNIT = 5;
+const int DEFERRED_LIGHTS_UNIT = GBUFFER_FIRST_UNIT + GBuffer::NUM_TARGETS + 1;
+
+// tessellation of the deferred light volumes
+const int LIGHT_VOLUME_SLICES = 16;
+const int LIGHT_VOLUME_STACKS = 8;
+
+// shader variant features needed by a material (see ShaderVariants)
+static unsigned MultiLightFeatures(const Material* mat)
+{
+    unsigned features = 0;
+    if (mat->texArray)
+        features |= ShaderVariants::TEXTURE_ARRAY;
+    else if (mat->tex)
+        features |= ShaderVariants::TEXTURE_2D;
+    if (mat->specular != glm::vec3(0.0f))
+        features |= ShaderVariants::SPECULAR;
+    if (mat->emissive != glm::vec3(0.0f))
+        features |= ShaderVariants::EMISSIVE;
+    return features;
+}
+
+// per-draw record of an entity or light cube
+static DrawData MakeDrawData(const glm::mat4& modelview, const Material* mat)
+{
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelview)));
+
+    DrawData data;
+    data.modelview = modelview;
+    for (int i = 0; i < 3; i++)
+        data.normalMatrix[i] = glm::vec4(normalMatrix[i], 0.0f);
+    data.tint = mat->tint;
+    data.emissive = mat->emissive;
+    data.texLayer = mat->texArray ? mat->texLayer : -1;
+    data.specular = mat->specular;
+    data.shininess = mat->shininess;
+    return data;
+}
+
+// print how much of the geometry heap is in use
+static void PrintGeometryHeapStats()
+{
+    GeometryHeapStats stats = Mesh::GetGeometryHeap().getStats();
+    std::cout << "Geometry: " << stats.numAllocations << " meshes in " << stats.numBlocks << " buffers, "
+              << stats.usedBytes / 1024 << " KB used of " << stats.reservedBytes / 1024 << " KB ("
+              << (int)(100 * stats.utilization()) << "% utilization, " << stats.numFreeRanges << " free ranges, "
+              << (int)(100 * stats.fragmentation()) << "% fragmentation)" << std::endl;
+}
+
+// add dim, quickly fading lights scattered around the room (the same ones for the same seed)
+static void AddRandomPointLights(std::vector<PointLight>& lights, int count, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    for (int i = 0; i < count; i++) {
+        glm::vec3 pos(-30 + 60 * unit(rng), -3 + 8 * unit(rng), -25 + 50 * unit(rng));
+        glm::vec3 color(0.5f * unit(rng), 0.5f * unit(rng), 0.5f * unit(rng));
+        lights.push_back(PointLight(pos, color, 2.0f, 1.0f, 1.0f));
+    }
+}
+
+// point the G-buffer samplers of a deferred lighting program at their texture units
+static void SendGBufferUniforms(ShaderProgram* prog, const glm::mat4& invProjMatrix, int width, int height)
+{
+    prog->sendUniformInt("u_GBufAlbedo", GBUFFER_FIRST_UNIT + GBuffer::ALBEDO);
+    prog->sendUniformInt("u_GBufNormal", GBUFFER_FIRST_UNIT + GBuffer::NORMAL);
+    prog->sendUniformInt("u_GBufSpecular", GBUFFER_FIRST_UNIT + GBuffer::SPECULAR);
+    prog->sendUniformInt("u_GBufEmissive", GBUFFER_FIRST_UNIT + GBuffer::EMISSIVE);
+    prog->sendUniformInt("u_GBufDepth", GBUFFER_FIRST_UNIT + GBuffer::NUM_TARGETS);
+
+    prog->sendUniform("u_InvProjectionMatrix", invProjMatrix);
+    prog->sendUniform("u_ScreenSize", glm::vec2((float)width, (float)height));
+}
 
 BasicSceneRenderer::BasicSceneRenderer()
     : mLightingModel(BLINN_PHONG_PER_FRAGMENT_MULTI_LIGHT)
+    , mBokoblin(NULL)
+    , mTextureManager(TEXTURE_BUDGET_BYTES)
+    , mAnisotropy(1.0f)
+    , mUseMultiDraw(true)
+    , mNumScenePointLights(0)
+    , mUseShaderVariants(true)
+    , mDeferredAmbientProgram(NULL)
+    , mDeferredLightProgram(NULL)
+    , mScreenQuad(NULL)
+    , mLightVolume(NULL)
+    , mViewportWidth(0)
+    , mViewportHeight(0)
+    , mOutputFramebuffer(0)
     , mCamera(NULL)
     , mProjMatrix(1.0f)
     , mActiveEntityIndex(0)
-    , mDbgProgram(NULL)
-    , mAxes(NULL)
     , mVisualizePointLights(false)
+    , mDbgProgram(NULL)
+    , mDbgBoxProgram(NULL)
+    , mTracePath("trace.json")
+    , mNumDrawCalls(0)
+    , mNumTriangles(0)
 {
 }
 
@@ -29,6 +166,15 @@ Arrow* arrow;
 
 void BasicSceneRenderer::initialize()
 {
+    // profile from the start (loading included) if SCENE_TRACE names the trace file
+    std::string tracePath = GetEnv("SCENE_TRACE");
+    if (!tracePath.empty()) {
+        mTracePath = tracePath;
+        Profiler::BeginCapture();
+    }
+
+    PROFILE_ZONE("initialize");
+
     // print usage instructions
     std::cout << "Usage:" << std::endl;
     std::cout << "  Camera control:           WASD + Mouse" << std::endl;
@@ -38,6 +184,17 @@ void BasicSceneRenderer::initialize()
     std::cout << "  Translate active entity:  TFGH (local space)" << std::endl;
     std::cout << "  Cycle active entity:      X/Z" << std::endl;
     std::cout << "  Toggle point light vis.:  Tab" << std::endl;
+    std::cout << "  Print memory use:         M" << std::endl;
+    std::cout << "  Print state changes:      U" << std::endl;
+    std::cout << "  Anisotropic filtering:    N" << std::endl;
+    std::cout << "  Clustered lighting:       5" << std::endl;
+    std::cout << "  Deferred lighting:        6" << std::endl;
+    std::cout << "  Toggle shader variants:   V" << std::endl;
+    std::cout << "  Toggle multi-draw:        P" << std::endl;
+    std::cout << "  Toggle debug drawing:     Q" << std::endl;
+    std::cout << "  Toggle extra lights:      O" << std::endl;
+    std::cout << "  Benchmark light binning:  B" << std::endl;
+    std::cout << "  Start/stop CPU profiling: Y" << std::endl;
 
     glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
 
@@ -48,19 +205,57 @@ void BasicSceneRenderer::initialize()
     //glEnable(GL_BLEND);
     //glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+    // reuse programs linked by earlier runs (see shader load statistics printed below)
+    ShaderProgram::EnableBinaryCache("shadercache");
+
+    // every entity shader reads its transforms and material from the ring
+    ShaderProgram::SetBlockBinding("PerDraw", PER_DRAW_BINDING);
+
+    // compile all programs together, they are checked at the end of initialization
+    // (the driver can work on them while textures and meshes are loaded)
+    ShaderBatch shaderBatch;
+
     mPrograms.resize(NUM_LIGHTING_MODELS);
 
-    mPrograms[PER_VERTEX_DIR_LIGHT] = new ShaderProgram("shaders/PerVertexDirLight-vs.glsl",
-                                                                "shaders/PerVertexDirLight-fs.glsl");
+    mPrograms[PER_VERTEX_DIR_LIGHT] = shaderBatch.add("shaders/PerVertexDirLight-vs.glsl",
+                                                      "shaders/PerVertexDirLight-fs.glsl");
     
-    mPrograms[BLINN_PHONG_PER_FRAGMENT_DIR_LIGHT] = new ShaderProgram("shaders/BlinnPhongPerFragment-vs.glsl",
-                                                                      "shaders/BlinnPhongPerFragmentDirLight-fs.glsl");
+    mPrograms[BLINN_PHONG_PER_FRAGMENT_DIR_LIGHT] = shaderBatch.add("shaders/BlinnPhongPerFragment-vs.glsl",
+                                                                    "shaders/BlinnPhongPerFragmentDirLight-fs.glsl");
+
+    mPrograms[BLINN_PHONG_PER_FRAGMENT_POINT_LIGHT] = shaderBatch.add("shaders/BlinnPhongPerFragment-vs.glsl",
+                                                                      "shaders/BlinnPhongPerFragmentPointLight-fs.glsl");
+
+    mPrograms[BLINN_PHONG_PER_FRAGMENT_MULTI_LIGHT] = shaderBatch.add("shaders/BlinnPhongPerFragment-vs.glsl",
+                                                                      "shaders/BlinnPhongPerFragmentMultiLight-fs.glsl");
+
+    // specialized versions of the same shader (see the end of initialization)
+    mMultiLightVariants.setSources("shaders/BlinnPhongPerFragment-vs.glsl",
+                                   "shaders/BlinnPhongPerFragmentMultiLight-fs.glsl");
+
+    mPrograms[BLINN_PHONG_CLUSTERED_MULTI_LIGHT] = shaderBatch.add("shaders/BlinnPhongPerFragment-vs.glsl",
+                                                                   "shaders/BlinnPhongPerFragmentClustered-fs.glsl");
+
+    // deferred shading writes the material properties to the G-buffer and lights them afterwards
+    mPrograms[DEFERRED_MULTI_LIGHT] = shaderBatch.add("shaders/BlinnPhongPerFragment-vs.glsl",
+                                                      "shaders/DeferredGeometry-fs.glsl");
+
+    // the clustered and deferred shaders again, reading their per-draw data by draw index
+    mMultiDrawPrograms.resize(NUM_LIGHTING_MODELS, NULL);
+    if (MultiDraw::IsSupported()) {
+        mMultiDrawPrograms[BLINN_PHONG_CLUSTERED_MULTI_LIGHT] = shaderBatch.add("shaders/BlinnPhongPerFragment-vs.glsl",
+                                                                            "shaders/BlinnPhongPerFragmentClustered-fs.glsl",
+                                                                            MultiDraw::GetDefines());
+        mMultiDrawPrograms[DEFERRED_MULTI_LIGHT] = shaderBatch.add("shaders/BlinnPhongPerFragment-vs.glsl",
+                                                               "shaders/DeferredGeometry-fs.glsl",
+                                                               MultiDraw::GetDefines());
+    }
 
-    mPrograms[BLINN_PHONG_PER_FRAGMENT_POINT_LIGHT] = new ShaderProgram("shaders/BlinnPhongPerFragment-vs.glsl",
-                                                                        "shaders/BlinnPhongPerFragmentPointLight-fs.glsl");
+    mDeferredAmbientProgram = shaderBatch.add("shaders/DeferredScreen-vs.glsl",
+                                              "shaders/DeferredAmbient-fs.glsl");
 
-    mPrograms[BLINN_PHONG_PER_FRAGMENT_MULTI_LIGHT] = new ShaderProgram("shaders/BlinnPhongPerFragment-vs.glsl",
-                                                                        "shaders/BlinnPhongPerFragmentMultiLight-fs.glsl");
+    mDeferredLightProgram = shaderBatch.add("shaders/DeferredPointLight-vs.glsl",
+                                            "shaders/DeferredPointLight-fs.glsl");
 
 	glLineWidth(2.0f);
 
@@ -104,16 +299,32 @@ void BasicSceneRenderer::initialize()
     texNames.push_back("textures/black.tga");
 	texNames.push_back("textures/lava.tga");
 
+    // pack same-size textures into texture arrays, so materials can share a single binding
+    std::vector<int> texSlots;
     for (unsigned i = 0; i < texNames.size(); i++)
-        mTextures.push_back(new Texture(texNames[i], GL_MIRRORED_REPEAT, GL_LINEAR));
+        texSlots.push_back(mTextureArrays.add(texNames[i], GL_MIRRORED_REPEAT, GL_LINEAR));
+
+    std::vector<std::string> colorNames;
+    colorNames.push_back("textures/green.tga");
+    colorNames.push_back("textures/red.tga");
+    colorNames.push_back("textures/blue.tga");
+
+    std::vector<int> colorSlots;
+    for (unsigned i = 0; i < colorNames.size(); i++)
+        colorSlots.push_back(mTextureArrays.add(colorNames[i], GL_REPEAT, GL_LINEAR));
+
+    mTextureArrays.build();
 
     //
     // Create materials
     //
 
     // add a material for each loaded texture (with default tint)
-    for (unsigned i = 0; i < texNames.size(); i++)
-        mMaterials.push_back(new Material(mTextures[i]));
+    for (unsigned i = 0; i < texNames.size(); i++) {
+        Material* mat = new Material(NULL);
+        mat->setTextureLayer(mTextureArrays.getArray(texSlots[i]), mTextureArrays.getLayer(texSlots[i]));
+        mMaterials.push_back(mat);
+    }
 
     //
     // set extra material properties
@@ -170,11 +381,9 @@ void BasicSceneRenderer::initialize()
 	*/
 
 	//my custom entities 
-	Material* myMaterial = new Material(mTextures[5]);
+	Material* myMaterial = mMaterials[5];
 	Mesh* cubeMesh = CreateTexturedCube(5);
 	
-	Material* texmex = new Material(new Texture("textures/target.tga", GL_REPEAT, GL_LINEAR));
-	
 	Material* emptyTex = new Material(new Texture());
 	//active = new Entity(wireframeCube, myMaterial, Transform(-10.0f, 0.0f, z));
 	//mEntities.push_back(active);
@@ -202,7 +411,7 @@ void BasicSceneRenderer::initialize()
 		mEntities.push_back(wireframeCube);*/
 	}
 
-	arrow = new Arrow();
+	arrow = new Arrow(mAssets);
 	Entity* target = arrow->targetEntity;
 	//wireframeCube = target;
 	mEntities.push_back(arrow);
@@ -211,19 +420,16 @@ void BasicSceneRenderer::initialize()
 
 
 	//LOAD MODELS FOR FUN
-	Material* texy = new Material(new Texture("textures/green.tga", GL_REPEAT, GL_LINEAR));
+	Material* texy = new Material(NULL);
+	texy->setTextureLayer(mTextureArrays.getArray(colorSlots[0]), mTextureArrays.getLayer(colorSlots[0]));
 
-	Material* objTexture = new Material(mTextures[0]);
-	Mesh* bokoblin = LoadMesh("meshes/Bokoblin-centered.obj");
-	//Entity* bunny = new Entity(bokoblin, texy, Transform(0.0f, 0.0f, -22.0f));
+	Material* objTexture = mMaterials[0];
+	mBokoblin = mAssets.getMesh("meshes/Bokoblin-centered.obj");
+	//Entity* bunny = new Entity(mBokoblin, texy, Transform(0.0f, 0.0f, -22.0f));
 	//mEntities.push_back(bunny);
 
 	
 
-	std::vector<Texture*> texs;
-	texs.push_back(new Texture("textures/green.tga", GL_REPEAT, GL_LINEAR));
-	texs.push_back(new Texture("textures/red.tga", GL_REPEAT, GL_LINEAR));
-	texs.push_back(new Texture("textures/blue.tga", GL_REPEAT, GL_LINEAR));
 
 	// water drops (sharp and strong specular highlight)
 	mMaterials[3]->specular = glm::vec3(1.0f, 1.0f, 1.0f);
@@ -239,11 +445,12 @@ void BasicSceneRenderer::initialize()
 
 	for (int i = 0; i < 3; i++)
 	{
-		Material* m = new Material(texs[i]);
+		Material* m = new Material(NULL);
+		m->setTextureLayer(mTextureArrays.getArray(colorSlots[i]), mTextureArrays.getLayer(colorSlots[i]));
 		m->specular = glm::vec3(0.3f, 0.3f, 0.3f);
 		m->shininess = 8;
 
-		Entity* e = new Entity(bokoblin, m, Transform(10.0f *i -15, 0.0f, 22.0f));
+		Entity* e = new Entity(mBokoblin, m, Transform(10.0f *i -15, 0.0f, 22.0f));
 		e->createBoundingBox();
 		//e->rotate(180, glm::vec3(0, 1.0f, 0));
 		mEntities.push_back(e);
@@ -257,6 +464,8 @@ void BasicSceneRenderer::initialize()
     // Create room
     //
 
+    unsigned firstRoomEntity = mEntities.size();
+
     // back wall
     mEntities.push_back(new Entity(fbMesh, mMaterials[8], Transform(0, 0, -0.5f * roomDepth)));
     //// front wall
@@ -270,6 +479,23 @@ void BasicSceneRenderer::initialize()
     //// ceiling
     //mEntities.push_back(new Entity(cfMesh, mMaterials[0], Transform(0, 0.5f * roomHeight, 0, glm::angleAxis(glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)))));
 
+    mRoomEntities.assign(mEntities.begin() + firstRoomEntity, mEntities.end());
+
+    trackEntityTextures();
+
+    std::cout << "Asset cache: " << mAssets.getNumTextures() << " textures, " << mAssets.getNumMeshes() << " meshes ("
+              << mAssets.getHits() << " hits, " << mAssets.getMisses() << " misses)" << std::endl;
+
+    //
+    // Create point lights
+    //
+
+    mPointLights.push_back(PointLight(glm::vec3(-7, 5, -12)));
+    mPointLights.push_back(PointLight(glm::vec3(7, 5, -12)));
+    mPointLights.push_back(PointLight(glm::vec3(-7, -5, 15)));
+    mPointLights.push_back(PointLight(glm::vec3(0, 10, 22)));
+    mNumScenePointLights = mPointLights.size();
+
     //
     // create the camera
     //
@@ -279,30 +505,101 @@ void BasicSceneRenderer::initialize()
     mCamera->lookAt(1, 1, 0);
     mCamera->setSpeed(2);
 
+    // a benchmark replaces the game with its first scene
+    if (mBenchmark.isActive()) {
+        mBenchmark.setDeviceInfo((const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION));
+        loadBenchmarkScene(mBenchmark.getScene());
+    }
+
     // create shader program for debug geometry
-    mDbgProgram = new ShaderProgram("shaders/vpc-vs.glsl",
-                                    "shaders/vcolor-fs.glsl");
+    mDbgProgram = shaderBatch.add("shaders/vpc-vs.glsl",
+                                  "shaders/vcolor-fs.glsl");
+    mDbgBoxProgram = shaderBatch.add("shaders/DebugBox-vs.glsl",
+                                     "shaders/vcolor-fs.glsl");
+
+    mDrawData.create(PER_DRAW_BINDING, sizeof(DrawData), MAX_DRAWS_PER_FRAME);
+    std::cout << "Per-draw data: " << mDrawData.getNumFrames() << " x " << mDrawData.getFrameBytes() / 1024 << " KB ring ("
+              << (mDrawData.isPersistent() ? "persistently mapped" : "mapped per draw") << ")" << std::endl;
+
+    // per-draw arrays for multi-draw
+    if (MultiDraw::IsSupported()) {
+        mMultiDrawData.create(PER_DRAW_BINDING, MultiDraw::MAX_DRAWS_PER_CALL * sizeof(DrawData),
+                              MAX_DRAWS_PER_FRAME / MultiDraw::MAX_DRAWS_PER_CALL);
+        mMultiDraw.setRecordSize(sizeof(DrawData));
+    } else {
+        mUseMultiDraw = false;
+        std::cout << "Multi-draw: not supported (needs ARB_multi_draw_indirect and ARB_shader_draw_parameters)" << std::endl;
+    }
 
-    // create geometry for axes
-    mAxes = CreateAxes(2);
+    if (!mGpuProfiler.create())
+        std::cout << "GPU profiling: not supported (needs ARB_timer_query)" << std::endl;
+
+    // geometry for deferred lighting passes
+    mScreenQuad = CreateTexturedQuad(2, 2, 1, 1);
+    mLightVolume = CreateSolidSphere_Nolight(1, LIGHT_VOLUME_SLICES, LIGHT_VOLUME_STACKS);
 
 	spline_t = 0;
 
+    shaderBatch.finish();
+
+    // compile the multi-light variants that entities can ask for now rather than while drawing
+    std::vector<unsigned> variantKeys;
+    for (unsigned i = 0; i < mEntities.size(); i++) {
+        unsigned features = MultiLightFeatures(mEntities[i]->getMaterial());
+        for (unsigned n = 0; n <= MAX_SHADER_POINT_LIGHTS; n++)
+            variantKeys.push_back(ShaderVariants::MakeKey(features, NUM_MULTI_DIR_LIGHTS, n));
+    }
+    mMultiLightVariants.compile(variantKeys);
+
+    // startup cost of the shaders (compare a cold run with an empty shadercache directory to a warm one)
+    const ShaderLoadStats& shaderStats = ShaderProgram::GetLoadStats();
+    std::cout << "Shaders: " << shaderStats.numPrograms << " programs loaded in " << 1000 * shaderStats.loadSeconds << " ms ("
+              << shaderStats.cacheHits << " cached, " << shaderStats.cacheMisses << " compiled, "
+              << shaderStats.cacheRejected << " rejected)" << std::endl;
+
+    PrintGeometryHeapStats();
+
     CHECK_GL_ERRORS("initialization");
 }
 
 void BasicSceneRenderer::shutdown()
 {
+    // don't lose a capture that is still running
+    if (Profiler::IsCapturing())
+        toggleProfilerCapture();
+
     for (unsigned i = 0; i < mPrograms.size(); i++)
         delete mPrograms[i];
     mPrograms.clear();
 
+    for (unsigned i = 0; i < mMultiDrawPrograms.size(); i++)
+        delete mMultiDrawPrograms[i];
+    mMultiDrawPrograms.clear();
+
+    mMultiLightVariants.clear();
+    mSentPointLights.clear();
+
     delete mDbgProgram;
     mDbgProgram = NULL;
+    delete mDbgBoxProgram;
+    mDbgBoxProgram = NULL;
+
+    delete mDeferredAmbientProgram;
+    mDeferredAmbientProgram = NULL;
+
+    delete mDeferredLightProgram;
+    mDeferredLightProgram = NULL;
 
     delete mCamera;
     mCamera = NULL;
 
+    // benchmark scenes without the room leave it out of the entity list
+    for (unsigned i = 0; i < mRoomEntities.size(); i++) {
+        if (std::find(mEntities.begin(), mEntities.end(), mRoomEntities[i]) == mEntities.end())
+            delete mRoomEntities[i];
+    }
+    mRoomEntities.clear();
+
     for (unsigned i = 0; i < mEntities.size(); i++)
         delete mEntities[i];
     mEntities.clear();
@@ -319,34 +616,87 @@ void BasicSceneRenderer::shutdown()
         delete mTextures[i];
     mTextures.clear();
 
-    delete mDbgProgram;
-    mDbgProgram = NULL;
-    
-    delete mAxes;
-    mAxes = NULL;
+    mTextureArrays.clear();
+
+    mTextureManager.clear();
+
+    mSamplers.clear();
+
+    mPointLights.clear();
+    mLightClusters.destroy();
+
+    mGBuffer.destroy();
+    mDeferredLights.destroy();
+
+    mDrawData.destroy();
+    mMultiDrawData.destroy();
+    mMultiDraw.destroy();
+    mGpuProfiler.destroy();
+
+    // release everything loaded from files (entities that referenced them are gone by now)
+    mAssets.release(mBokoblin);
+    mBokoblin = NULL;
+    mAssets.clear();
+
+    mDebugDraw.destroy();
+
+    delete mScreenQuad;
+    mScreenQuad = NULL;
+
+    delete mLightVolume;
+    mLightVolume = NULL;
 }
 
 void BasicSceneRenderer::resize(int width, int height)
 {
     glViewport(0, 0, width, height);
 
+    // the G-buffer is reallocated to match on the next deferred frame
+    mViewportWidth = width;
+    mViewportHeight = height;
+
     // compute new projection matrix
-    mProjMatrix = glm::perspective(glm::radians(50.f), width / (float)height, 0.1f, 1000.0f);
+    mProjMatrix = glm::perspective(glm::radians(FIELD_OF_VIEW), width / (float)height, Z_NEAR, Z_FAR);
+
+    // light clusters are laid out in screen space
+    mLightClusters.setProjection(glm::radians(FIELD_OF_VIEW), width / (float)height, Z_NEAR, Z_FAR, width, height);
 }
 
 void BasicSceneRenderer::draw()
 {
+    PROFILE_ZONE("draw");
+
+    // deferred shading draws into the G-buffer first, and needs to know where to go back to
+    GLint outputFramebuffer = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &outputFramebuffer);
+    mOutputFramebuffer = outputFramebuffer;
+
+    mNumDrawCalls = 0;
+    mNumTriangles = 0;
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    mTextureManager.beginFrame();
+    mGLState.beginFrame();
+    mDrawData.beginFrame();
+    mMultiDrawData.beginFrame();
+    mGpuProfiler.beginFrame();
+
+    // with multi-draw, entities and light cubes are queued and submitted after the entity loop,
+    // and the lighting model's multi-draw program gets the per-frame uniforms instead
+    bool multiDraw = mUseMultiDraw && mMultiDrawPrograms[mLightingModel];
+    mMultiDraw.clear();
+
     // activate current program
-    ShaderProgram* prog = mPrograms[mLightingModel];
-    prog->activate();
+    ShaderProgram* prog = multiDraw ? mMultiDrawPrograms[mLightingModel] : mPrograms[mLightingModel];
+    mGLState.useProgram(prog);
 
     // send projection matrix
     prog->sendUniform("u_ProjectionMatrix", mProjMatrix);
 
-    // send the texture sampler id to shader
+    // send the texture sampler ids to shader (plain textures on unit 0, texture arrays on unit 1)
     prog->sendUniformInt("u_TexSampler", 0);
+    prog->sendUniformInt("u_TexArraySampler", 1);
 
     // get the view matrix from the camera
     glm::mat4 viewMatrix = mCamera->getViewMatrix();
@@ -355,6 +705,8 @@ void BasicSceneRenderer::draw()
     // light setup depends on lighting model
     //
 
+    mGpuProfiler.beginPass("light setup");
+
     if (mLightingModel == PER_VERTEX_DIR_LIGHT) {
 
         //----------------------------------------------------------------------------------//
@@ -418,12 +770,14 @@ void BasicSceneRenderer::draw()
         // render the light as an emissive cube, if desired
         if (mVisualizePointLights) {
             const Mesh* lightMesh = mMeshes[0];
-            lightMesh->activate();
-            glBindTexture(GL_TEXTURE_2D, mTextures[7]->id());  // use black texture
-            prog->sendUniform("u_MatEmissiveColor", lightColor);
-            prog->sendUniform("u_ModelviewMatrix", glm::translate(viewMatrix, glm::vec3(lightPos)));
-            prog->sendUniform("u_NormalMatrix", glm::mat3(1.0f));
+            mGLState.bindMesh(lightMesh);
+            Material lightMat = *mMaterials[7];     // use black texture
+            lightMat.specular = glm::vec3(0.0f);
+            lightMat.emissive = lightColor;
+            bindMaterialTexture(&lightMat);
+            pushDrawData(glm::translate(viewMatrix, glm::vec3(lightPos)), &lightMat);
             lightMesh->draw();
+            countDraw(lightMesh);
         }
 
     } else if (mLightingModel == BLINN_PHONG_PER_FRAGMENT_MULTI_LIGHT) {
@@ -434,156 +788,568 @@ void BasicSceneRenderer::draw()
         //                                                                                  //
         //----------------------------------------------------------------------------------//
 
-        prog->sendUniform("u_AmbientLightColor", glm::vec3(0.1f, 0.1f, 0.1f));
+        // point lights are picked per entity (see selectEntityPointLights)
+        updateViewPointLights(viewMatrix);
 
-        prog->sendUniformInt("u_NumDirLights", 1);
-        prog->sendUniformInt("u_NumPointLights", 4);
+        // programs are set up on first use each frame (entities may pick other variants)
+        mSentPointLights.clear();
+        setupMultiLightProgram(prog, viewMatrix);
+
+        // render the point lights as emissive cubes, if desirable
+        if (mVisualizePointLights)
+            drawPointLightCubes(viewMatrix, multiDraw);
+
+    } else if (mLightingModel == BLINN_PHONG_CLUSTERED_MULTI_LIGHT) {
+
+        //----------------------------------------------------------------------------------//
+        //                                                                                  //
+        // Directional light and any number of point lights, binned into clusters           //
+        //                                                                                  //
+        //----------------------------------------------------------------------------------//
+
+        prog->sendUniform("u_AmbientLightColor", glm::vec3(0.1f, 0.1f, 0.1f));
 
         // directional light
         glm::vec4 lightDir = glm::normalize(glm::vec4(1, 3, 2, 0));
+        prog->sendUniformInt("u_NumDirLights", 1);
         prog->sendUniform("u_DirLights[0].dir", glm::vec3(viewMatrix * lightDir));
         prog->sendUniform("u_DirLights[0].color", glm::vec3(0.3f, 0.3f, 0.3f));
 
-        // point light
-        glm::vec3 lightPos1 = glm::vec3(-7, 5, -12);
-        glm::vec3 lightColor1 = glm::vec3(1.0f, 1.0f, 1.0f);
-        prog->sendUniform("u_PointLights[0].pos", glm::vec3(viewMatrix * glm::vec4(lightPos1, 1)));
-        prog->sendUniform("u_PointLights[0].color", lightColor1);
-        prog->sendUniform("u_PointLights[0].attQuat", 0.01f);
-        prog->sendUniform("u_PointLights[0].attLin", 0.1f);
-        prog->sendUniform("u_PointLights[0].attConst", 1.0f);
-
-        // point light
-        glm::vec3 lightPos2 = glm::vec3(7, 5, -12);
-        glm::vec3 lightColor2 = glm::vec3(1.0f, 1.0f, 1.0f);
-        prog->sendUniform("u_PointLights[1].pos", glm::vec3(viewMatrix * glm::vec4(lightPos2, 1)));
-        prog->sendUniform("u_PointLights[1].color", lightColor2);
-        prog->sendUniform("u_PointLights[1].attQuat", 0.01f);
-        prog->sendUniform("u_PointLights[1].attLin", 0.1f);
-        prog->sendUniform("u_PointLights[1].attConst", 1.0f);
-
-        // point light
-        glm::vec3 lightPos3 = glm::vec3(-7, -5, 15);
-        glm::vec3 lightColor3 = glm::vec3(1.0f, 1.0f, 1.0f);
-        prog->sendUniform("u_PointLights[2].pos", glm::vec3(viewMatrix * glm::vec4(lightPos3, 1)));
-        prog->sendUniform("u_PointLights[2].color", lightColor3);
-        prog->sendUniform("u_PointLights[2].attQuat", 0.01f);
-        prog->sendUniform("u_PointLights[2].attLin", 0.1f);
-        prog->sendUniform("u_PointLights[2].attConst", 1.0f);
-
-		// point light
-		glm::vec3 lightPos4 = glm::vec3(0, 10, 22);
-		glm::vec3 lightColor4 = glm::vec3(1.0f, 1.0f, 1.0f);
-		prog->sendUniform("u_PointLights[3].pos", glm::vec3(viewMatrix * glm::vec4(lightPos4, 1)));
-		prog->sendUniform("u_PointLights[3].color", lightColor4);
-		prog->sendUniform("u_PointLights[3].attQuat", 0.01f);
-		prog->sendUniform("u_PointLights[3].attLin", 0.1f);
-		prog->sendUniform("u_PointLights[3].attConst", 1.0f);
+        // bin the point lights in view space and hand the cluster lists to the shader
+        updateViewPointLights(viewMatrix);
+
+        mLightClusters.build(mViewPointLights, LIGHT_CUTOFF);
+        mLightClusters.upload();
+        mLightClusters.bind(prog, 2);   // units 0 and 1 are used by material textures
 
         // render the point lights as emissive cubes, if desirable
-        if (mVisualizePointLights) {
-            glBindTexture(GL_TEXTURE_2D, mTextures[7]->id());  // use black texture
-            prog->sendUniform("u_NormalMatrix", glm::mat3(1.0f));
-            const Mesh* lightMesh = mMeshes[0];
-            lightMesh->activate();
-            prog->sendUniform("u_MatEmissiveColor", lightColor1);
-            prog->sendUniform("u_ModelviewMatrix", glm::translate(viewMatrix, glm::vec3(lightPos1)));
-            lightMesh->draw();
-            prog->sendUniform("u_MatEmissiveColor", lightColor2);
-            prog->sendUniform("u_ModelviewMatrix", glm::translate(viewMatrix, glm::vec3(lightPos2)));
-            lightMesh->draw();
-            prog->sendUniform("u_MatEmissiveColor", lightColor3);
-            prog->sendUniform("u_ModelviewMatrix", glm::translate(viewMatrix, glm::vec3(lightPos3)));
-            lightMesh->draw();
-			prog->sendUniform("u_MatEmissiveColor", lightColor4);
-			prog->sendUniform("u_ModelviewMatrix", glm::translate(viewMatrix, glm::vec3(lightPos4)));
-			lightMesh->draw();
+        if (mVisualizePointLights)
+            drawPointLightCubes(viewMatrix, multiDraw);
+
+    } else if (mLightingModel == DEFERRED_MULTI_LIGHT) {
+
+        //----------------------------------------------------------------------------------//
+        //                                                                                  //
+        // Deferred shading: fill the G-buffer here, light it after the entities are drawn  //
+        //                                                                                  //
+        //----------------------------------------------------------------------------------//
+
+        // reallocating the targets leaves unit 0 bound to nothing
+        if (mGBuffer.getWidth() != mViewportWidth || mGBuffer.getHeight() != mViewportHeight) {
+            mGBuffer.resize(mViewportWidth, mViewportHeight);
+            mGLState.invalidate();
         }
+        mGBuffer.bindFramebuffer();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // render the point lights as emissive cubes, if desirable
+        if (mVisualizePointLights)
+            drawPointLightCubes(viewMatrix, multiDraw);
     }
 
     // render all entities
+    mGpuProfiler.beginPass("entities");
+
     for (unsigned i = 0; i < mEntities.size(); i++) {
 
         Entity* ent = mEntities[i];
 		const Texture* tex = ent->mMaterial->tex;
 	
-		//only for bounding boxes
-		//render without textures/lighting
-		if (ent->hasBoundingBox == true)
-		{
-			mDbgProgram->activate();
-			mDbgProgram->sendUniform("u_ModelviewMatrix", viewMatrix * ent->getWorldMatrix());
-			ent->boundingBox->active->activate();
-			ent->boundingBox->active->draw();
+		// compute modelview matrix
+		glm::mat4 modelview = viewMatrix * ent->getWorldMatrix();
+
+		const Material* mat = ent->getMaterial();
+
+		// drawn with the other entities in the same bucket after the loop
+		if (multiDraw) {
+			DrawData data = MakeDrawData(modelview, mat);
+			mMultiDraw.queue(ent->getMesh(), mat, &data);
+			continue;
 		}
-		
-		
-		prog->activate();
+
+		// find the point lights that reach this entity, and the cheapest shader that can light it
+		ShaderProgram* entProg = prog;
+		unsigned numEntityLights = 0;
+		if (mLightingModel == BLINN_PHONG_PER_FRAGMENT_MULTI_LIGHT) {
+			numEntityLights = selectEntityPointLights(ent->getMesh(), modelview);
+			if (mUseShaderVariants)
+				entProg = getMultiLightVariant(mat, numEntityLights, viewMatrix);
+		}
+
+		mGLState.useProgram(entProg);
 			
 		// use the entity's material
-		const Material* mat = ent->getMaterial();
-		glBindTexture(GL_TEXTURE_2D, mat->tex->id());   // bind texture
-		prog->sendUniform("u_Tint", mat->tint);     // send tint color
-
-		// send the Blinn-Phong parameters, if required
-		if (mLightingModel > PER_VERTEX_DIR_LIGHT) {
-			prog->sendUniform("u_MatEmissiveColor", mat->emissive);
-			prog->sendUniform("u_MatSpecularColor", mat->specular);
-			prog->sendUniform("u_MatShininess", mat->shininess);
-		}
+		bindMaterialTexture(mat);             // bind texture (or array)
 
-		// compute modelview matrix
-		glm::mat4 modelview = viewMatrix * ent->getWorldMatrix();
+		// the entity's transforms and material parameters go to the ring in one write
+		pushDrawData(modelview, mat);
 
-		// send the entity's modelview and normal matrix
-		prog->sendUniform("u_ModelviewMatrix", modelview);
-		prog->sendUniform("u_NormalMatrix", glm::transpose(glm::inverse(glm::mat3(modelview))));
+		// send only the point lights that reach this entity
+		if (mLightingModel == BLINN_PHONG_PER_FRAGMENT_MULTI_LIGHT)
+			sendEntityPointLights(entProg, numEntityLights);
 
 		// use the entity's mesh
 		const Mesh* mesh = ent->getMesh();
-		mesh->activate();
+		mGLState.bindMesh(mesh);
 		mesh->draw();
+		countDraw(mesh);
 		
     }
 
-	//draw stuff without materials/textures or using simple colorshaders here
+    if (multiDraw)
+        submitMultiDraw();
+
+    if (mLightingModel == DEFERRED_MULTI_LIGHT) {
+        mGpuProfiler.beginPass("deferred lighting");
+        drawDeferredLighting(viewMatrix);
+    }
+
+    mGpuProfiler.beginPass("debug");
 
-	// load shader with no lighting
-    mDbgProgram->activate();
-    mDbgProgram->sendUniform("u_ProjectionMatrix", mProjMatrix);
+    //draw stuff without materials/textures or using simple colorshaders here
+    // (collected by mDebugDraw and drawn in one go; deferred shading could not draw them
+    // earlier anyway, they have no place in the G-buffer)
 
-	//DRAW 3 AXIS ON ACTIVE OBJECT
-    /*Entity* activeEntity = mEntities[mActiveEntityIndex];
-    mDbgProgram->sendUniform("u_ModelviewMatrix", viewMatrix * activeEntity->getWorldMatrix());
-    mAxes->activate();
-    mAxes->draw();*/
+    // bounding boxes, red while the arrow's ray hits them (skipped as a whole when debug
+    // drawing is off, so the world matrices aren't built for nothing)
+    if (mDebugDraw.isEnabled()) {
+        for (unsigned i = 0; i < mEntities.size(); i++) {
+            Entity* ent = mEntities[i];
+            if (ent->hasBoundingBox == true) {
+                mDebugDraw.box(ent->getWorldMatrix(), ent->mMin, ent->mMax, ent->boundingBoxHit ? glm::vec4(1, 0, 0, 1) : glm::vec4(0, 1, 0, 1));
+            }
+        }
+    }
 
-	//DRAW 3 AXIS AT ORIGIN
-	mDbgProgram->sendUniform("u_ModelviewMatrix", viewMatrix * glm::translate(glm::mat4(), glm::vec3(0,10,0)));
-	mAxes->activate();
-	mAxes->draw();
+    //DRAW 3 AXIS ON ACTIVE OBJECT
+    //mDebugDraw.axes(mEntities[mActiveEntityIndex]->getWorldMatrix(), 2);
 
-	//DRAW RAY
-	/*mDbgProgram->sendUniform("u_ModelviewMatrix", viewMatrix * ray->getWorldMatrix());
-	rayMesh->activate();
-	rayMesh->draw();*/
+    //DRAW 3 AXIS AT ORIGIN
+    mDebugDraw.axes(glm::translate(glm::mat4(), glm::vec3(0, 10, 0)), 2);
 
-	//wireframe cube
-	//mDbgProgram->sendUniform("u_ModelviewMatrix", viewMatrix * wireframeCube->getWorldMatrix());
-	//wireframeCube->getMesh()->activate();
-	//wireframeCube->getMesh()->draw();
+    //DRAW RAY (there is no arrow in benchmark scenes)
+    if (arrow)
+        mDebugDraw.line(arrow->getMin(), arrow->getMax(), glm::vec4(1, 0, 0, 1));
+
+    mDebugDraw.flush(mGLState, mDbgProgram, mDbgBoxProgram, mProjMatrix, viewMatrix);
+    mNumDrawCalls += (mDebugDraw.getNumLines() > 0) + (mDebugDraw.getNumBoxes() > 0);
+
+    mGpuProfiler.endFrame();
 
-	mDbgProgram->sendUniform("u_ModelviewMatrix", viewMatrix * arrow->getWorldMatrix());
-	arrow->directionRay->activate();
-	arrow->directionRay->draw();
+    // apply the texture budget now that we know what was used this frame
+    mTextureManager.endFrame();
 
-	//draw bounding box for 
+    // the GPU is done with this frame's draw data once it gets past here
+    mDrawData.endFrame();
+    mMultiDrawData.endFrame();
+
+    // benchmark frames end when the GPU is done with them, so each one's time includes its GPU work
+    if (mBenchmark.isActive()) {
+        glFinish();
+
+        BenchmarkFrame frame;
+        frame.gpuMillis = -1;
+        if (mGpuProfiler.isEnabled() && mGpuProfiler.getNumPasses() > 0) {
+            frame.gpuMillis = 0;
+            for (unsigned i = 0; i < mGpuProfiler.getNumPasses(); i++)
+                frame.gpuMillis += mGpuProfiler.getPassMillis(i);
+        }
+        frame.drawCalls = mNumDrawCalls;
+        frame.stateChanges = mGLState.getCurrentStats().totalIssued();
+        frame.triangles = mNumTriangles;
+        mBenchmark.endFrame(frame);
+    }
 
     CHECK_GL_ERRORS("drawing");
 }
 
+void BasicSceneRenderer::bindMaterialTexture(const Material* mat)
+{
+    // materials that share a texture or array are not rebound (see GLStateCache);
+    // the array layer is part of the per-draw data
+    if (mat->texArray) {
+        mGLState.bindTexture(1, GL_TEXTURE_2D_ARRAY, mat->texArray->id());
+        mGLState.bindSampler(1, mSamplers.get(mat->texArray->getWrapMode(), mat->texArray->getFilteringMode(), mAnisotropy));
+    } else {
+        mGLState.bindTexture(0, GL_TEXTURE_2D, mat->tex ? mat->tex->id() : 0);
+        if (mat->tex)
+            mGLState.bindSampler(0, mSamplers.get(mat->tex->getWrapMode(), mat->tex->getFilteringMode(), mAnisotropy));
+        mTextureManager.touch(mat->tex);
+    }
+}
+
+void BasicSceneRenderer::pushDrawData(const glm::mat4& modelview, const Material* mat)
+{
+    DrawData data = MakeDrawData(modelview, mat);
+    mDrawData.push(&data);    // reports once if MAX_DRAWS_PER_FRAME is too small
+}
+
+void BasicSceneRenderer::drawPointLightCubes(const glm::mat4& viewMatrix, bool multiDraw)
+{
+    // black texture, no highlights, glowing in the light's color
+    Material lightMat = *mMaterials[7];
+    lightMat.specular = glm::vec3(0.0f);
+
+    const Mesh* lightMesh = mMeshes[0];
+
+    if (multiDraw) {
+        // the bucket binds the texture later, so it gets the long-lived material
+        for (unsigned i = 0; i < mPointLights.size(); i++) {
+            lightMat.emissive = mPointLights[i].color;
+            DrawData data = MakeDrawData(glm::translate(viewMatrix, mPointLights[i].pos), &lightMat);
+            mMultiDraw.queue(lightMesh, mMaterials[7], &data);
+        }
+        return;
+    }
+
+    bindMaterialTexture(&lightMat);
+    mGLState.bindMesh(lightMesh);
+
+    for (unsigned i = 0; i < mPointLights.size(); i++) {
+        lightMat.emissive = mPointLights[i].color;
+        pushDrawData(glm::translate(viewMatrix, mPointLights[i].pos), &lightMat);
+        lightMesh->draw();
+        countDraw(lightMesh);
+    }
+}
+
+void BasicSceneRenderer::submitMultiDraw()
+{
+    PROFILE_ZONE("submitMultiDraw");
+
+    mMultiDraw.upload();
+
+    for (unsigned b = 0; b < mMultiDraw.getNumBuckets(); b++) {
+        mGLState.bindMesh(mMultiDraw.getBucketMesh(b));
+        bindMaterialTexture(mMultiDraw.getBucketMaterial(b));
+        mMultiDraw.drawBucket(b, mMultiDrawData);
+    }
+
+    mNumDrawCalls += mMultiDraw.getNumCalls();
+    mNumTriangles += mMultiDraw.getNumTriangles();
+}
+
+void BasicSceneRenderer::countDraw(const Mesh* mesh, GLsizei numInstances)
+{
+    ++mNumDrawCalls;
+    mNumTriangles += mesh->getNumTriangles() * numInstances;
+}
+
+void BasicSceneRenderer::updateViewPointLights(const glm::mat4& viewMatrix)
+{
+    mViewPointLights.resize(mPointLights.size());
+    mPointLightRadii.resize(mPointLights.size());
+
+    for (unsigned i = 0; i < mPointLights.size(); i++) {
+        mViewPointLights[i] = mPointLights[i];
+        mViewPointLights[i].pos = glm::vec3(viewMatrix * glm::vec4(mPointLights[i].pos, 1));
+        mPointLightRadii[i] = LightRadius(mPointLights[i], LIGHT_CUTOFF);
+    }
+}
+
+void BasicSceneRenderer::setupMultiLightProgram(ShaderProgram* prog, const glm::mat4& viewMatrix)
+{
+    prog->sendUniform("u_ProjectionMatrix", mProjMatrix);
+
+    prog->sendUniformInt("u_TexSampler", 0);
+    prog->sendUniformInt("u_TexArraySampler", 1);
+
+    prog->sendUniform("u_AmbientLightColor", glm::vec3(0.1f, 0.1f, 0.1f));
+
+    prog->sendUniformInt("u_NumDirLights", NUM_MULTI_DIR_LIGHTS);
+    prog->sendUniformInt("u_NumPointLights", 0);
+
+    // directional light
+    glm::vec4 lightDir = glm::normalize(glm::vec4(1, 3, 2, 0));
+    prog->sendUniform("u_DirLights[0].dir", glm::vec3(viewMatrix * lightDir));
+    prog->sendUniform("u_DirLights[0].color", glm::vec3(0.3f, 0.3f, 0.3f));
+
+    // no point lights sent yet
+    mSentPointLights[prog].assign(MAX_SHADER_POINT_LIGHTS, -1);
+}
+
+ShaderProgram* BasicSceneRenderer::getMultiLightVariant(const Material* mat, unsigned numPointLights, const glm::mat4& viewMatrix)
+{
+    unsigned key = ShaderVariants::MakeKey(MultiLightFeatures(mat), NUM_MULTI_DIR_LIGHTS, numPointLights);
+    ShaderProgram* variant = mMultiLightVariants.get(key);
+
+    // first use this frame
+    if (mSentPointLights.find(variant) == mSentPointLights.end()) {
+        mGLState.useProgram(variant);
+        setupMultiLightProgram(variant, viewMatrix);
+    }
+
+    return variant;
+}
+
+unsigned BasicSceneRenderer::selectEntityPointLights(const Mesh* mesh, const glm::mat4& modelview)
+{
+    // bounding sphere in view space (entity transforms are rigid, so the radius is unchanged)
+    glm::vec3 center = glm::vec3(modelview * glm::vec4(mesh->mBoundsCenter, 1));
+    float radius = mesh->mBoundsRadius;
+
+    // lights whose range reaches the sphere, scored by their intensity at its nearest point
+    mLightScores.clear();
+    for (unsigned i = 0; i < mViewPointLights.size(); i++) {
+        float dist = glm::length(mViewPointLights[i].pos - center);
+        if (dist < mPointLightRadii[i] + radius)
+            mLightScores.push_back(std::make_pair(LightIntensity(mViewPointLights[i], std::max(dist - radius, 0.0f)), i));
+    }
+
+    // keep the brightest ones
+    unsigned numLights = std::min((unsigned)mLightScores.size(), MAX_SHADER_POINT_LIGHTS);
+    std::partial_sort(mLightScores.begin(), mLightScores.begin() + numLights, mLightScores.end(),
+                      std::greater<std::pair<float, unsigned> >());
+
+    return numLights;
+}
+
+void BasicSceneRenderer::sendEntityPointLights(ShaderProgram* prog, unsigned numLights)
+{
+    prog->sendUniformInt("u_NumPointLights", numLights);
+
+    // neighbouring entities tend to share lights, so only send the slots that changed
+    std::vector<int>& sentLights = mSentPointLights[prog];
+    for (unsigned k = 0; k < numLights; k++) {
+        unsigned index = mLightScores[k].second;
+        if (sentLights[k] == (int)index)
+            continue;
+
+        const PointLight& light = mViewPointLights[index];
+        std::string name = "u_PointLights[" + ToString(k) + "]";
+        prog->sendUniform(name + ".pos", light.pos);
+        prog->sendUniform(name + ".color", light.color);
+        prog->sendUniform(name + ".attQuad", light.attQuad);
+        prog->sendUniform(name + ".attLin", light.attLin);
+        prog->sendUniform(name + ".attConst", light.attConst);
+
+        sentLights[k] = index;
+    }
+}
+
+void BasicSceneRenderer::drawDeferredLighting(const glm::mat4& viewMatrix)
+{
+    PROFILE_ZONE("drawDeferredLighting");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, mOutputFramebuffer);
+    mGBuffer.bindTextures(GBUFFER_FIRST_UNIT);
+
+    glm::mat4 invProjMatrix = glm::inverse(mProjMatrix);
+
+    //
+    // emissive, ambient and directional light, one full-screen pass
+    // (also copies the scene depth, so light volumes and debug geometry are tested against it)
+    //
+
+    mGLState.useProgram(mDeferredAmbientProgram);
+    SendGBufferUniforms(mDeferredAmbientProgram, invProjMatrix, mGBuffer.getWidth(), mGBuffer.getHeight());
+
+    mDeferredAmbientProgram->sendUniform("u_AmbientLightColor", glm::vec3(0.1f, 0.1f, 0.1f));
+
+    glm::vec4 lightDir = glm::normalize(glm::vec4(1, 3, 2, 0));
+    mDeferredAmbientProgram->sendUniformInt("u_NumDirLights", 1);
+    mDeferredAmbientProgram->sendUniform("u_DirLights[0].dir", glm::vec3(viewMatrix * lightDir));
+    mDeferredAmbientProgram->sendUniform("u_DirLights[0].color", glm::vec3(0.3f, 0.3f, 0.3f));
+
+    mGLState.setDepthFunc(GL_ALWAYS);
+    mGLState.bindMesh(mScreenQuad);
+    mScreenQuad->draw();
+    countDraw(mScreenQuad);
+    mGLState.setDepthFunc(GL_LESS);
+
+    //
+    // point lights, one instanced sphere each
+    //
+
+    updateViewPointLights(viewMatrix);
+
+    // no light needs to reach past the far plane
+    mDeferredLights.upload(mViewPointLights, LIGHT_CUTOFF, Z_FAR);
+    if (mDeferredLights.getNumLights() == 0)
+        return;
+    mDeferredLights.bind(DEFERRED_LIGHTS_UNIT);
+
+    mGLState.useProgram(mDeferredLightProgram);
+    SendGBufferUniforms(mDeferredLightProgram, invProjMatrix, mGBuffer.getWidth(), mGBuffer.getHeight());
+    mDeferredLightProgram->sendUniform("u_ProjectionMatrix", mProjMatrix);
+    mDeferredLightProgram->sendUniformInt("u_LightData", DEFERRED_LIGHTS_UNIT);
+
+    // the tessellated sphere lies inside the unit sphere, grow it until its faces enclose it
+    float faceDist = std::cos(3.14159f / LIGHT_VOLUME_SLICES) * std::cos(0.5f * 3.14159f / LIGHT_VOLUME_STACKS);
+    mDeferredLightProgram->sendUniform("u_VolumeScale", 1.0f / faceDist);
+
+    // Draw the back faces of each volume where the scene is in front of them, so a light covers
+    // the same pixels whether or not the camera is inside it (no stencil pass needed).
+    // Depth clamping keeps back faces behind the far plane from being clipped away.
+    mGLState.setEnabled(GL_BLEND, true);
+    mGLState.setBlendFunc(GL_ONE, GL_ONE);
+    mGLState.setDepthMask(false);
+    mGLState.setDepthFunc(GL_GEQUAL);
+    mGLState.setCullFace(GL_FRONT);
+    mGLState.setEnabled(GL_DEPTH_CLAMP, true);
+
+    mGLState.bindMesh(mLightVolume);
+    mLightVolume->drawInstanced(mDeferredLights.getNumLights());
+    countDraw(mLightVolume, mDeferredLights.getNumLights());
+
+    mGLState.setEnabled(GL_DEPTH_CLAMP, false);
+    mGLState.setCullFace(GL_BACK);
+    mGLState.setDepthFunc(GL_LESS);
+    mGLState.setDepthMask(true);
+    mGLState.setEnabled(GL_BLEND, false);
+}
+
+void BasicSceneRenderer::toggleExtraPointLights()
+{
+    if (mPointLights.size() > mNumScenePointLights) {
+        mPointLights.resize(mNumScenePointLights);
+    } else {
+        AddRandomPointLights(mPointLights, NUM_EXTRA_POINT_LIGHTS, 1);
+    }
+
+    std::cout << "Point lights: " << mPointLights.size() << std::endl;
+}
+
+void BasicSceneRenderer::trackEntityTextures()
+{
+    mTextureManager.clear();
+    for (unsigned i = 0; i < mEntities.size(); i++) {
+        const Material* mat = mEntities[i]->getMaterial();
+        if (mat->texArray)
+            mTextureManager.add(mat->texArray);
+        else
+            mTextureManager.add(mat->tex);
+    }
+}
+
+void BasicSceneRenderer::loadBenchmarkScene(const BenchmarkScene& scene)
+{
+    // the game's entities (or the last scene's) go, the room is kept for the scenes that want it
+    for (unsigned i = 0; i < mEntities.size(); i++) {
+        if (std::find(mRoomEntities.begin(), mRoomEntities.end(), mEntities[i]) == mRoomEntities.end())
+            delete mEntities[i];
+    }
+    mEntities.clear();
+    mActiveEntityIndex = 0;
+    arrow = NULL;
+
+    // the grid cycles through these
+    std::vector<const Mesh*> meshes;
+    meshes.push_back(mMeshes[0]);   // cube
+    meshes.push_back(mMeshes[1]);   // chunky cylinder
+    meshes.push_back(mMeshes[2]);   // smooth cylinder
+    if (mBokoblin)
+        meshes.push_back(mBokoblin);
+
+    // a square grid on the floor, each entity turned a little further than the last
+    const float spacing = 4;
+    int numEntities = scene.entitiesPerMesh * meshes.size();
+    int columns = (int)std::ceil(std::sqrt((float)numEntities));
+    float offset = 0.5f * spacing * (columns - 1);
+    for (int i = 0; i < numEntities; i++) {
+        float x = spacing * (i % columns) - offset;
+        float z = spacing * (i / columns) - offset;
+        glm::quat orientation = glm::angleAxis(glm::radians(37.0f * i), glm::vec3(0.0f, 1.0f, 0.0f));
+        mEntities.push_back(new Entity(meshes[i % meshes.size()], mMaterials[i % mMaterials.size()], Transform(x, 0, z, orientation)));
+    }
+
+    if (scene.room)
+        mEntities.insert(mEntities.end(), mRoomEntities.begin(), mRoomEntities.end());
+
+    // the arrow's textures went with it
+    trackEntityTextures();
+
+    mPointLights.clear();
+    AddRandomPointLights(mPointLights, scene.numPointLights, 1);
+    mNumScenePointLights = mPointLights.size();
+
+    mLightingModel = (LightingModel)scene.lightingModel;
+
+    std::cout << "Benchmark scene '" << scene.name << "': " << numEntities << " entities, "
+              << mPointLights.size() << " point lights" << (scene.room ? ", room" : "") << std::endl;
+}
+
+void BasicSceneRenderer::benchmarkLightClusters()
+{
+    static const int lightCounts[] = { 1000, 2000, 5000, 10000 };
+    const int numBuilds = 20;
+
+    // fixed 1280x720 view, so results don't depend on the window
+    const int width = 1280;
+    const int height = 720;
+    float tanHalfY = std::tan(0.5f * glm::radians(FIELD_OF_VIEW));
+    float tanHalfX = tanHalfY * width / height;
+
+    LightClusters clusters(mLightClusters.getDimX(), mLightClusters.getDimY(), mLightClusters.getDimZ());
+    clusters.setProjection(glm::radians(FIELD_OF_VIEW), width / (float)height, Z_NEAR, Z_FAR, width, height);
+
+    // compare a single thread against all of them
+    int threadCounts[] = { 1, mLightClusters.getNumThreads() };
+    int numThreadCounts = threadCounts[1] > 1 ? 2 : 1;
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    std::cout << "Light binning, " << clusters.getDimX() << "x" << clusters.getDimY() << "x" << clusters.getDimZ()
+              << " clusters, average of " << numBuilds << " builds:" << std::endl;
+
+    for (unsigned n = 0; n < sizeof(lightCounts) / sizeof(lightCounts[0]); n++) {
+
+        // small lights scattered through the first 100 units of the view frustum (view space)
+        std::vector<PointLight> lights(lightCounts[n]);
+        for (unsigned i = 0; i < lights.size(); i++) {
+            float depth = 1 + 99 * unit(rng);
+            glm::vec3 pos((2 * unit(rng) - 1) * tanHalfX * depth, (2 * unit(rng) - 1) * tanHalfY * depth, -depth);
+            lights[i] = PointLight(pos, glm::vec3(0.5f, 0.5f, 0.5f), 2.0f, 1.0f, 1.0f);
+        }
+
+        for (int t = 0; t < numThreadCounts; t++) {
+            clusters.setNumThreads(threadCounts[t]);
+            clusters.build(lights, LIGHT_CUTOFF);   // warm up
+
+            std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+            for (int k = 0; k < numBuilds; k++)
+                clusters.build(lights, LIGHT_CUTOFF);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+            std::cout << "  " << lights.size() << " lights, " << threadCounts[t] << " thread(s): "
+                      << elapsed.count() / numBuilds << " ms ("
+                      << clusters.getNumIndices() << " light references, at most "
+                      << clusters.getMaxLightsPerCluster() << " per cluster)" << std::endl;
+        }
+    }
+}
+
+void BasicSceneRenderer::toggleProfilerCapture()
+{
+    if (Profiler::IsCapturing()) {
+        Profiler::EndCapture();
+        Profiler::WriteChromeTrace(mTracePath);
+        return;
+    }
+
+    // measured first, the measurement discards recorded zones
+    std::cout << "Profiler zone overhead: " << Profiler::MeasureZoneOverhead(false) << " ns idle, "
+              << Profiler::MeasureZoneOverhead(true) << " ns recording" << std::endl;
+
+    Profiler::BeginCapture();
+    std::cout << "Profiling (press Y again to write " << mTracePath << ")" << std::endl;
+}
+
 bool BasicSceneRenderer::update(float dt)
 {
+    PROFILE_ZONE("update");
+
+    // benchmark frames are timed from here until the GPU has drawn them
+    if (mBenchmark.isActive()) {
+        if (mBenchmark.isSceneDone()) {
+            if (!mBenchmark.nextScene())
+                return false;
+            loadBenchmarkScene(mBenchmark.getScene());
+        }
+        mBenchmark.beginFrame(dt);
+    }
+
 	//SHOOTING
 
 	int toDelete = -1;
@@ -598,16 +1364,27 @@ bool BasicSceneRenderer::update(float dt)
 			//e->translate(glm::vec3(0, 0, -0.01));
 			glm::vec3 dir = glm::vec3(0.0f, 0.0f, -10.0f) - e->getPosition();
 			e->translate(glm::normalize(dir) * 0.1f);
+		}
+	}
 
+	// world-space boxes of everything at its new position, in one pass
+	ComputeWorldBounds(mEntities, mEntityBounds);
+
+	for (unsigned i = 0; i < mEntities.size(); i++)
+	{
+		Entity* e = mEntities[i];
+
+		if (e->hasBoundingBox == true)
+		{
 			//check for collision with ray
-			bool result = arrow->isIntersecting(e);
+			bool result = arrow->isIntersecting(mEntityBounds[i]);
 			if (result == true)
 			{
 				//toDelete = i;
-				e->boundingBox->active = e->boundingBox->mMesh2;
+				e->boundingBoxHit = true;
 
 				//if arrow touching a box
-				if (arrow->getPosition().z > e->getMin().z)
+				if (arrow->getPosition().z > mEntityBounds[i].min.z)
 				{
 					//toDelete = i;
 
@@ -624,7 +1401,7 @@ bool BasicSceneRenderer::update(float dt)
 			}
 			else
 			{
-				e->boundingBox->active = e->boundingBox->mMesh;
+				e->boundingBoxHit = false;
 			}
 		}
 
@@ -642,9 +1419,10 @@ bool BasicSceneRenderer::update(float dt)
 
     const Keyboard* kb = getKeyboard();
 
-	arrow->update(dt);
+	if (arrow)
+		arrow->update(dt);
 
-	if (kb->keyPressed(KC_SPACE))
+	if (arrow && kb->keyPressed(KC_SPACE))
 	{
 		arrow->isMoving = true;
 	
@@ -724,14 +1502,96 @@ bool BasicSceneRenderer::update(float dt)
         mLightingModel = BLINN_PHONG_PER_FRAGMENT_POINT_LIGHT;
     if (kb->keyPressed(KC_4))
         mLightingModel = BLINN_PHONG_PER_FRAGMENT_MULTI_LIGHT;
+    if (kb->keyPressed(KC_5))
+        mLightingModel = BLINN_PHONG_CLUSTERED_MULTI_LIGHT;
+    if (kb->keyPressed(KC_6))
+        mLightingModel = DEFERRED_MULTI_LIGHT;
+
+    // switch the multi-light model between specialized shaders and the general one
+    if (kb->keyPressed(KC_V)) {
+        mUseShaderVariants = !mUseShaderVariants;
+        std::cout << "Shader variants: " << (mUseShaderVariants ? "on" : "off")
+                  << " (" << mMultiLightVariants.size() << " compiled)" << std::endl;
+    }
+
+    // switch the clustered and deferred models between indirect multi-draw and a draw per entity
+    if (kb->keyPressed(KC_P)) {
+        if (MultiDraw::IsSupported()) {
+            mUseMultiDraw = !mUseMultiDraw;
+            std::cout << "Multi-draw: " << (mUseMultiDraw ? "on" : "off") << " (last frame: "
+                      << mMultiDraw.getNumDraws() << " draws in " << mMultiDraw.getNumCalls() << " calls)" << std::endl;
+        } else {
+            std::cout << "Multi-draw: not supported" << std::endl;
+        }
+    }
+
+    // add/remove lots of small lights
+    if (kb->keyPressed(KC_O))
+        toggleExtraPointLights();
+
+    if (kb->keyPressed(KC_B))
+        benchmarkLightClusters();
+
+    if (kb->keyPressed(KC_Y))
+        toggleProfilerCapture();
+
+    // toggle bounding boxes, axes and the arrow's ray
+    if (kb->keyPressed(KC_Q)) {
+        mDebugDraw.setEnabled(!mDebugDraw.isEnabled());
+        std::cout << "Debug drawing: " << (mDebugDraw.isEnabled() ? "on" : "off") << std::endl;
+    }
 
     // toggle visualization of point lights
     if (kb->keyPressed(KC_TAB))
         mVisualizePointLights = !mVisualizePointLights;
 
+    // toggle anisotropic filtering (only affects sampler objects, textures are left alone)
+    if (kb->keyPressed(KC_N)) {
+        mAnisotropy = mAnisotropy > 1.0f ? 1.0f : mSamplers.getMaxAnisotropy();
+        std::cout << "Anisotropic filtering: " << mAnisotropy << "x" << std::endl;
+    }
+
+    // print how many state changes the last frame issued and filtered out
+    if (kb->keyPressed(KC_U)) {
+        static const char* names[GLStateCache::NUM_COUNTERS] = { "programs", "meshes", "textures", "samplers", "render state" };
+        const GLStateCache::Stats& stats = mGLState.getFrameStats();
+        std::cout << "GL state changes: " << stats.totalIssued() << " issued, " << stats.totalFiltered() << " filtered (";
+        for (int i = 0; i < GLStateCache::NUM_COUNTERS; i++)
+            std::cout << (i ? ", " : "") << names[i] << " " << stats.issued[i] << "/" << stats.filtered[i];
+        std::cout << ")" << std::endl;
+        std::cout << "Per-draw records: " << mDrawData.getNumRecords() << ", ring stalls: " << mDrawData.getNumStalls() << std::endl;
+        std::cout << "Draw calls: " << mNumDrawCalls << " (" << mNumTriangles << " triangles)" << std::endl;
+
+        if (mGpuProfiler.isEnabled()) {
+            std::cout << "GPU passes " << GpuProfiler::NUM_FRAMES << " frames ago:";
+            for (unsigned i = 0; i < mGpuProfiler.getNumPasses(); i++)
+                std::cout << (i ? ", " : " ") << mGpuProfiler.getPassName(i) << " " << mGpuProfiler.getPassMillis(i) << " ms";
+            std::cout << " (" << mGpuProfiler.getNumDropped() << " frames not ready in time)" << std::endl;
+        }
+    }
+
+    // print texture residency and geometry heap statistics
+    if (kb->keyPressed(KC_M)) {
+        const TextureResidencyStats& stats = mTextureManager.getStats();
+        std::cout << "Textures: " << stats.numTextures
+                  << " (" << stats.numArrays << " arrays, " << stats.numFullRes << " full res, " << stats.numReduced << " reduced, "
+                  << stats.numFallback << " fallback, " << stats.numLoading << " loading), "
+                  << stats.residentBytes / 1024 << " KB resident of " << stats.budgetBytes / 1024 << " KB budget"
+                  << " (" << stats.fullResBytes / 1024 << " KB at full res)" << std::endl;
+        PrintGeometryHeapStats();
+    }
+
     // update the camera
     mCamera->update(dt);
 
+    // benchmarks fly it along a fixed path
+    if (mBenchmark.isActive()) {
+        glm::vec3 position, target;
+        SceneBenchmark::GetCameraPose(mBenchmark.getSceneTime(), position, target);
+        mCamera->setPosition(position);
+        mCamera->lookAt(target);
+    }
+
 	spline_t += 1; //not correct
 
 	//
@@ -773,19 +1633,20 @@ void Swap(float& t1, float& t2)
 // return intersection distance tmin and point q of intersection
 int BasicSceneRenderer::IntersectRayAABB(glm::vec3 p, glm::vec3 d, Entity* a, float &tmin, glm::vec3 &q)
 {
+	Bounds box = a->getWorldBounds();
 	tmin = 0; // set to -FLT_MAX to get first hit on line
 	float tmax = FLT_MAX; // set to max distance ray can travel (for segment)
 						  // For all three slabs
 	for (int i = 0; i < 3; i++) {
 		if (std::abs(d[i]) < std::numeric_limits<float>::epsilon()) {
 			// Ray is parallel to slab. No hit if origin not within slab
-			if (p[i] < a->getMin()[i] || p[i] > a->getMax()[i]) return 0;
+			if (p[i] < box.min[i] || p[i] > box.max[i]) return 0;
 		}
 		else {
 			// Compute intersection t value of ray with near and far plane of slab
 			float ood = 1.0f / d[i];
-			float t1 = (a->getMin()[i] - p[i]) * ood;
-			float t2 = (a->getMax()[i] - p[i]) * ood;
+			float t1 = (box.min[i] - p[i]) * ood;
+			float t2 = (box.max[i] - p[i]) * ood;
 			// Make t1 be intersection with near plane, t2 with far plane
 			if (t1 > t2) Swap(t1, t2);
 			// Compute the intersection of slab intersection intervals
@@ -804,8 +1665,9 @@ int BasicSceneRenderer::IntersectRayAABB(glm::vec3 p, glm::vec3 d, Entity* a, fl
 
 
 bool BasicSceneRenderer::intersect(Entity* ent, glm::vec3 org, glm::vec3 dir) {
-	glm::vec3 lb = ent->getMin();  //left bottom of box
-	glm::vec3 rt = ent->getMax();  //right top of box
+	Bounds box = ent->getWorldBounds();
+	glm::vec3 lb = box.min;  //left bottom of box
+	glm::vec3 rt = box.max;  //right top of box
 
 	glm::vec3 dirfrac;
 	float t;
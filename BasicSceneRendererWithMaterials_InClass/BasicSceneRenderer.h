@@ -4,7 +4,21 @@
 #include "Shaders.h"
 #include "Camera.h"
 #include "Entity.h"
-#include "AABB.h"
+#include "TextureArray.h"
+#include "TextureManager.h"
+#include "AssetCache.h"
+#include "SamplerCache.h"
+#include "LightClusters.h"
+#include "GBuffer.h"
+#include "LightBuffer.h"
+#include "ShaderVariants.h"
+#include "GLStateCache.h"
+#include "UniformRing.h"
+#include "MultiDraw.h"
+#include "DebugDraw.h"
+#include "GpuProfiler.h"
+#include "Benchmark.h"
+#include <map>
 #include <vector>
 
 enum LightingModel {
@@ -12,6 +26,8 @@ enum LightingModel {
     BLINN_PHONG_PER_FRAGMENT_DIR_LIGHT,
     BLINN_PHONG_PER_FRAGMENT_POINT_LIGHT,
     BLINN_PHONG_PER_FRAGMENT_MULTI_LIGHT,
+    BLINN_PHONG_CLUSTERED_MULTI_LIGHT,
+    DEFERRED_MULTI_LIGHT,
 
     NUM_LIGHTING_MODELS
 };
@@ -29,8 +45,69 @@ class BasicSceneRenderer : public GLApp {
     std::vector<Mesh*>          mMeshes;
     std::vector<Material*>      mMaterials;
 
+    // texture arrays shared by materials (one per group of same-size textures)
+    TextureArrayPacker          mTextureArrays;
+
+    // textures and meshes loaded from files, shared by path
+    AssetCache                  mAssets;
+    const Mesh*                 mBokoblin;              // the game and the benchmark scenes both show it
+
+    // keeps plain textures under a memory budget
+    TextureManager              mTextureManager;
+
+    // sampling state shared by all textures
+    SamplerCache                mSamplers;
+    float                       mAnisotropy;        // 1 = anisotropic filtering off
+
+    // drops redundant program, mesh, texture and render state changes while drawing
+    GLStateCache                mGLState;
+
+    // per-draw transforms and material parameters (the PerDraw uniform block)
+    UniformRing                 mDrawData;
+
+    // indirect multi-draw submission for the clustered and deferred models: entities and light
+    // cubes are queued while drawing and submitted with one call per bucket (see MultiDraw)
+    MultiDraw                   mMultiDraw;
+    UniformRing                 mMultiDrawData;         // PerDraw arrays of MultiDraw::MAX_DRAWS_PER_CALL records
+    std::vector<ShaderProgram*> mMultiDrawPrograms;     // per lighting model, NULL if it has no multi-draw version
+    bool                        mUseMultiDraw;
+
     // scene objects
     std::vector<Entity*>        mEntities;
+    std::vector<Bounds>         mEntityBounds;          // world-space boxes, updated for all entities each update
+
+    // point lights in world space
+    std::vector<PointLight>     mPointLights;
+    unsigned                    mNumScenePointLights;   // lights before the optional extra ones
+
+    // per-frame light binning for clustered shading
+    LightClusters               mLightClusters;
+    std::vector<PointLight>     mViewPointLights;       // mPointLights in view space
+    std::vector<float>          mPointLightRadii;       // range of each light (see LightRadius)
+
+    // per-entity light selection for the multi-light model
+    std::vector<std::pair<float, unsigned> >    mLightScores;       // (intensity, light index) of candidates
+
+    // compile-time specializations of the multi-light shader, picked per material and light count
+    ShaderVariants              mMultiLightVariants;
+    bool                        mUseShaderVariants;
+
+    // programs set up for the multi-light model this frame, with the light in each of their
+    // point light slots (or -1)
+    std::map<const ShaderProgram*, std::vector<int> >   mSentPointLights;
+
+    // deferred shading: entities fill the G-buffer, then lights are drawn as instanced spheres
+    GBuffer                     mGBuffer;
+    LightBuffer                 mDeferredLights;        // view-space lights read by the light volumes
+    ShaderProgram*              mDeferredAmbientProgram;    // emissive, ambient and directional light
+    ShaderProgram*              mDeferredLightProgram;      // one point light per volume
+    Mesh*                       mScreenQuad;
+    Mesh*                       mLightVolume;           // unit sphere
+
+    int                         mViewportWidth, mViewportHeight;
+
+    // framebuffer bound when draw() was called: 0 for the window, an FBO when running headless
+    GLuint                      mOutputFramebuffer;
 
     Camera*                     mCamera;
 
@@ -46,11 +123,26 @@ class BasicSceneRenderer : public GLApp {
     // debug visualization
     //
 
-    // shader used to render active entity axes
+    // shaders used to render debug lines, and instanced bounding boxes
     ShaderProgram*              mDbgProgram;
+    ShaderProgram*              mDbgBoxProgram;
+
+    // lines, boxes and axes collected while drawing, drawn at the end of the frame
+    DebugDraw                   mDebugDraw;
+
+    // where the CPU profiler's trace goes when the capture ends (see toggleProfilerCapture)
+    std::string                 mTracePath;
+
+    // GPU time of the light setup, entity, deferred lighting and debug passes
+    GpuProfiler                 mGpuProfiler;
+
+    // draw calls and triangles submitted by the last draw()
+    unsigned                    mNumDrawCalls;
+    unsigned                    mNumTriangles;
 
-    // geometry of axes
-    Mesh*                       mAxes;
+    // fixed scenes in place of the game, when set up before initialize (see SceneBenchmark)
+    SceneBenchmark              mBenchmark;
+    std::vector<Entity*>        mRoomEntities;          // walls and floor, left out of some scenes
 
 public:
                         BasicSceneRenderer();
@@ -60,8 +152,63 @@ public:
     void                resize(int width, int height);
     void                draw();
     bool                update(float dt);
-	int IntersectRayAABB(glm::vec3 p, glm::vec3 d, Entity* a, float &tmin, glm::vec3 &q);
-	bool intersect(Entity* ent, glm::vec3 org, glm::vec3 dir);
+	static int IntersectRayAABB(glm::vec3 p, glm::vec3 d, Entity* a, float &tmin, glm::vec3 &q);
+	static bool intersect(Entity* ent, glm::vec3 org, glm::vec3 dir);
+
+    // run these scenes instead of the game (call before initialize, and run headless)
+    void                setBenchmarkScenes(const std::vector<BenchmarkScene>& scenes)   { mBenchmark.setScenes(scenes); }
+    const SceneBenchmark&   getBenchmark() const    { return mBenchmark; }
+
+    // pass times of the frames drawn so far (kept after shutdown)
+    const GpuProfiler&      getGpuProfiler() const  { return mGpuProfiler; }
+
+private:
+    void                bindMaterialTexture(const Material* mat);
+
+    // write the transforms and material parameters of the next draw to the ring and bind them
+    void                pushDrawData(const glm::mat4& modelview, const Material* mat);
+
+    // render the point lights as small emissive cubes (queued to mMultiDraw if multiDraw is set)
+    void                drawPointLightCubes(const glm::mat4& viewMatrix, bool multiDraw);
+
+    // start a profiler capture, or end it and write the trace
+    void                toggleProfilerCapture();
+
+    // draw the buckets queued to mMultiDraw this frame with the current program
+    void                submitMultiDraw();
+
+    // add a draw call of a mesh to this frame's counters
+    void                countDraw(const Mesh* mesh, GLsizei numInstances = 1);
+
+    // transform the point lights to view space and compute their range
+    void                updateViewPointLights(const glm::mat4& viewMatrix);
+
+    // send the per-frame uniforms of the multi-light model
+    void                setupMultiLightProgram(ShaderProgram* prog, const glm::mat4& viewMatrix);
+
+    // find the brightest point lights that reach a mesh and return how many there are (multi-light model only)
+    unsigned            selectEntityPointLights(const Mesh* mesh, const glm::mat4& modelview);
+
+    // send the lights found by selectEntityPointLights
+    void                sendEntityPointLights(ShaderProgram* prog, unsigned numLights);
+
+    // get the cheapest multi-light shader variant for a material, set up for this frame
+    ShaderProgram*      getMultiLightVariant(const Material* mat, unsigned numPointLights, const glm::mat4& viewMatrix);
+
+    // light the G-buffer into the output framebuffer (deferred model only)
+    void                drawDeferredLighting(const glm::mat4& viewMatrix);
+
+    // add or remove a large number of small random point lights
+    void                toggleExtraPointLights();
+
+    // put the textures and texture arrays of the current entities under mTextureManager's budget
+    void                trackEntityTextures();
+
+    // replace the entities and point lights with a benchmark scene
+    void                loadBenchmarkScene(const BenchmarkScene& scene);
+
+    // time light binning with 1k-10k lights and print the results
+    void                benchmarkLightClusters();
 };
 
 #endif
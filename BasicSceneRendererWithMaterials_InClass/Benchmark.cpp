@@ -0,0 +1,200 @@
+#include "Benchmark.h"
+#include "BasicSceneRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+// one lap of the camera path, in seconds
+const float CAMERA_LAP_SECONDS = 20.0f;
+
+static BenchmarkScene MakeScene(const char* name, int entitiesPerMesh, int numPointLights, bool room,
+                                LightingModel lightingModel, int numFrames)
+{
+    BenchmarkScene scene;
+    scene.name = name;
+    scene.entitiesPerMesh = entitiesPerMesh;
+    scene.numPointLights = numPointLights;
+    scene.room = room;
+    scene.lightingModel = lightingModel;
+    scene.numFrames = numFrames;
+    return scene;
+}
+
+const std::vector<BenchmarkScene>& SceneBenchmark::GetScenes()
+{
+    static std::vector<BenchmarkScene> scenes;
+    if (scenes.empty()) {
+        scenes.push_back(MakeScene("baseline", 8, 4, true, BLINN_PHONG_PER_FRAGMENT_MULTI_LIGHT, 300));
+        scenes.push_back(MakeScene("many-entities", 256, 16, true, BLINN_PHONG_PER_FRAGMENT_MULTI_LIGHT, 300));
+        scenes.push_back(MakeScene("clustered", 64, 1024, true, BLINN_PHONG_CLUSTERED_MULTI_LIGHT, 300));
+        scenes.push_back(MakeScene("deferred", 64, 1024, true, DEFERRED_MULTI_LIGHT, 300));
+        scenes.push_back(MakeScene("no-room", 64, 16, false, BLINN_PHONG_CLUSTERED_MULTI_LIGHT, 300));
+    }
+    return scenes;
+}
+
+const BenchmarkScene* SceneBenchmark::FindScene(const std::string& name)
+{
+    const std::vector<BenchmarkScene>& scenes = GetScenes();
+    for (unsigned i = 0; i < scenes.size(); i++) {
+        if (scenes[i].name == name)
+            return &scenes[i];
+    }
+    return NULL;
+}
+
+void SceneBenchmark::GetCameraPose(float t, glm::vec3& position, glm::vec3& target)
+{
+    // circle the middle of the room, bobbing up and down twice per lap
+    float angle = 2 * 3.14159265f * t / CAMERA_LAP_SECONDS;
+    position = glm::vec3(18 * std::sin(angle), 4 + 2 * std::sin(2 * angle), 18 * std::cos(angle));
+    target = glm::vec3(0, 0, 0);
+}
+
+SceneBenchmark::SceneBenchmark()
+    : mSceneIndex(0)
+    , mSceneTime(0)
+{
+}
+
+void SceneBenchmark::setScenes(const std::vector<BenchmarkScene>& scenes)
+{
+    mScenes = scenes;
+    mFrames.assign(scenes.size(), std::vector<BenchmarkFrame>());
+    mSceneIndex = 0;
+    mSceneTime = 0;
+}
+
+bool SceneBenchmark::isSceneDone() const
+{
+    return (int)mFrames[mSceneIndex].size() >= mScenes[mSceneIndex].numFrames;
+}
+
+bool SceneBenchmark::nextScene()
+{
+    if (mSceneIndex + 1 >= mScenes.size())
+        return false;
+
+    ++mSceneIndex;
+    mSceneTime = 0;
+    return true;
+}
+
+void SceneBenchmark::beginFrame(float deltaT)
+{
+    mFrameStart = std::chrono::high_resolution_clock::now();
+    mSceneTime += deltaT;
+}
+
+void SceneBenchmark::endFrame(BenchmarkFrame& frame)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - mFrameStart;
+    frame.frameMillis = elapsed.count();
+    mFrames[mSceneIndex].push_back(frame);
+}
+
+void SceneBenchmark::setDeviceInfo(const std::string& renderer, const std::string& version)
+{
+    mRenderer = renderer;
+    mVersion = version;
+}
+
+// nearest-rank percentile of sorted values
+static double Percentile(const std::vector<double>& sorted, double p)
+{
+    size_t rank = (size_t)std::ceil(p / 100 * sorted.size());
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static std::string JsonString(const std::string& str)
+{
+    std::string quoted = "\"";
+    for (unsigned i = 0; i < str.size(); i++) {
+        if (str[i] == '"' || str[i] == '\\')
+            quoted += '\\';
+        quoted += str[i];
+    }
+    return quoted + "\"";
+}
+
+static void WriteTimes(std::ostream& out, const char* name, std::vector<double>& times)
+{
+    std::sort(times.begin(), times.end());
+
+    double sum = 0;
+    for (unsigned i = 0; i < times.size(); i++)
+        sum += times[i];
+
+    out << "      " << JsonString(name) << ": { \"mean\": " << sum / times.size()
+        << ", \"p50\": " << Percentile(times, 50) << ", \"p99\": " << Percentile(times, 99)
+        << ", \"min\": " << times.front() << ", \"max\": " << times.back() << " },\n";
+}
+
+bool SceneBenchmark::writeJson(const std::string& path, const HeadlessSettings& settings) const
+{
+    static const char* modelNames[NUM_LIGHTING_MODELS] = {
+        "per-vertex-dir", "per-fragment-dir", "per-fragment-point", "multi-light", "clustered", "deferred"
+    };
+
+    std::ofstream out(path.c_str());
+    if (!out.good()) {
+        std::cerr << "*** Failed to open file '" << path << "' for writing" << std::endl;
+        return false;
+    }
+
+    out << "{\n";
+    out << "  \"renderer\": " << JsonString(mRenderer) << ",\n";
+    out << "  \"version\": " << JsonString(mVersion) << ",\n";
+    out << "  \"width\": " << settings.width << ", \"height\": " << settings.height << ", \"dt\": " << settings.deltaT << ",\n";
+    out << "  \"warmup_frames\": " << (int)WARMUP_FRAMES << ",\n";
+    out << "  \"scenes\": [";
+
+    bool first = true;
+    for (unsigned s = 0; s < mScenes.size(); s++) {
+        const BenchmarkScene& scene = mScenes[s];
+        const std::vector<BenchmarkFrame>& frames = mFrames[s];
+
+        // scenes that did not get past the warmup have nothing to report
+        if ((int)frames.size() <= WARMUP_FRAMES)
+            continue;
+
+        std::vector<double> frameTimes, gpuTimes;
+        double drawCalls = 0, stateChanges = 0, triangles = 0;
+        for (unsigned i = WARMUP_FRAMES; i < frames.size(); i++) {
+            frameTimes.push_back(frames[i].frameMillis);
+            if (frames[i].gpuMillis >= 0)
+                gpuTimes.push_back(frames[i].gpuMillis);
+            drawCalls += frames[i].drawCalls;
+            stateChanges += frames[i].stateChanges;
+            triangles += frames[i].triangles;
+        }
+        double numMeasured = (double)frameTimes.size();
+
+        out << (first ? "\n" : ",\n") << "    {\n";
+        out << "      \"name\": " << JsonString(scene.name) << ",\n";
+        out << "      \"entities_per_mesh\": " << scene.entitiesPerMesh << ", \"point_lights\": " << scene.numPointLights
+            << ", \"room\": " << (scene.room ? "true" : "false")
+            << ", \"lighting_model\": " << JsonString(modelNames[scene.lightingModel]) << ",\n";
+        out << "      \"frames\": " << frames.size() << ",\n";
+        WriteTimes(out, "frame_ms", frameTimes);
+        if (!gpuTimes.empty())
+            WriteTimes(out, "gpu_ms", gpuTimes);
+        out << "      \"draw_calls\": " << drawCalls / numMeasured
+            << ", \"state_changes\": " << stateChanges / numMeasured
+            << ", \"triangles\": " << triangles / numMeasured << "\n";
+        out << "    }";
+        first = false;
+    }
+
+    out << "\n  ]\n}\n";
+
+    if (!out.good()) {
+        std::cerr << "*** Failed to write file '" << path << "'" << std::endl;
+        return false;
+    }
+
+    std::cout << "Benchmark results written to " << path << std::endl;
+    return true;
+}
@@ -0,0 +1,98 @@
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include "glshell.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+//
+// A fixed scene: a grid with the same number of entities of each mesh type, point lights
+// scattered through the room (the same ones every run), the room itself if wanted, and the
+// lighting model to draw them with.
+//
+struct BenchmarkScene {
+    std::string     name;
+    int             entitiesPerMesh;
+    int             numPointLights;
+    bool            room;
+    int             lightingModel;      // a LightingModel
+    int             numFrames;
+};
+
+//
+// What one frame cost
+//
+struct BenchmarkFrame {
+    double          frameMillis;        // update and draw, until the GPU is done with it
+    double          gpuMillis;          // GPU passes of a frame a few frames back, < 0 if not measured
+    unsigned        drawCalls;
+    unsigned        stateChanges;       // GL calls issued by the state cache
+    unsigned        triangles;
+};
+
+
+//
+// Runs a list of scenes one after the other and summarizes them as JSON, so renderer
+// performance can be compared across commits.
+//
+// The app runs headless with a fixed time step (see GLShell::RunHeadless) and the camera follows
+// a scripted path, so every run draws the same frames. The renderer builds each scene, calls
+// beginFrame before updating and endFrame once the GPU has finished drawing. The first
+// WARMUP_FRAMES of each scene (shader variants compiled on first use, texture uploads) are
+// recorded but left out of the summary.
+//
+class SceneBenchmark {
+public:
+    static const int    WARMUP_FRAMES = 30;
+
+    // the built-in scenes
+    static const std::vector<BenchmarkScene>&   GetScenes();
+
+    // NULL if no built-in scene has that name
+    static const BenchmarkScene*    FindScene(const std::string& name);
+
+    // where the camera is and what it looks at 't' seconds into a scene
+    static void     GetCameraPose(float t, glm::vec3& position, glm::vec3& target);
+
+    SceneBenchmark();
+
+    void            setScenes(const std::vector<BenchmarkScene>& scenes);
+
+    bool            isActive() const            { return !mScenes.empty(); }
+
+    const BenchmarkScene&   getScene() const    { return mScenes[mSceneIndex]; }
+    float           getSceneTime() const        { return mSceneTime; }
+
+    // true once the current scene has drawn all its frames
+    bool            isSceneDone() const;
+
+    // move on to the next scene; returns false after the last one
+    bool            nextScene();
+
+    void            beginFrame(float deltaT);
+
+    // record a frame (the counters filled in by the caller, the time by this)
+    void            endFrame(BenchmarkFrame& frame);
+
+    // GL_RENDERER and GL_VERSION, for the report
+    void            setDeviceInfo(const std::string& renderer, const std::string& version);
+
+    // mean, median and 99th percentile frame times and mean counters of each scene run so far
+    bool            writeJson(const std::string& path, const HeadlessSettings& settings) const;
+
+private:
+    std::vector<BenchmarkScene>                 mScenes;
+    std::vector<std::vector<BenchmarkFrame> >   mFrames;        // per scene
+
+    unsigned                                    mSceneIndex;
+    float                                       mSceneTime;
+
+    std::chrono::high_resolution_clock::time_point  mFrameStart;
+
+    std::string                                 mRenderer;
+    std::string                                 mVersion;
+};
+
+#endif
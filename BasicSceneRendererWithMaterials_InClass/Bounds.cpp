@@ -0,0 +1,96 @@
+#include "Bounds.h"
+#include "Entity.h"
+#include "Profiler.h"
+
+#include <cmath>
+
+// use SSE to transform the boxes where available
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#  define BOUNDS_USE_SSE
+#  include <xmmintrin.h>
+#endif
+
+namespace {
+
+#ifdef BOUNDS_USE_SSE
+
+// x, y, z of a box in lanes 0-2; lane 3 carries no meaning
+inline void TransformBox(const float* m, const glm::vec3& min, const glm::vec3& max, Bounds& out)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+
+    __m128 lo = _mm_setr_ps(min.x, min.y, min.z, 0.0f);
+    __m128 hi = _mm_setr_ps(max.x, max.y, max.z, 0.0f);
+    __m128 center = _mm_mul_ps(_mm_add_ps(lo, hi), half);
+    __m128 extent = _mm_mul_ps(_mm_sub_ps(hi, lo), half);
+
+    // glm matrices are stored by column
+    __m128 c0 = _mm_loadu_ps(m);
+    __m128 c1 = _mm_loadu_ps(m + 4);
+    __m128 c2 = _mm_loadu_ps(m + 8);
+    __m128 c3 = _mm_loadu_ps(m + 12);
+
+    // center as a point: c0 * x + c1 * y + c2 * z + c3
+    __m128 wc = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_shuffle_ps(center, center, _MM_SHUFFLE(0, 0, 0, 0))),
+                                      _mm_mul_ps(c1, _mm_shuffle_ps(center, center, _MM_SHUFFLE(1, 1, 1, 1)))),
+                           _mm_add_ps(_mm_mul_ps(c2, _mm_shuffle_ps(center, center, _MM_SHUFFLE(2, 2, 2, 2))), c3));
+
+    // extents through the absolute matrix: |c0| * ex + |c1| * ey + |c2| * ez
+    __m128 a0 = _mm_max_ps(c0, _mm_sub_ps(zero, c0));
+    __m128 a1 = _mm_max_ps(c1, _mm_sub_ps(zero, c1));
+    __m128 a2 = _mm_max_ps(c2, _mm_sub_ps(zero, c2));
+    __m128 we = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(0, 0, 0, 0))),
+                                      _mm_mul_ps(a1, _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(1, 1, 1, 1)))),
+                           _mm_mul_ps(a2, _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(2, 2, 2, 2))));
+
+    float outMin[4], outMax[4];
+    _mm_storeu_ps(outMin, _mm_sub_ps(wc, we));
+    _mm_storeu_ps(outMax, _mm_add_ps(wc, we));
+    out.min = glm::vec3(outMin[0], outMin[1], outMin[2]);
+    out.max = glm::vec3(outMax[0], outMax[1], outMax[2]);
+}
+
+#else
+
+inline void TransformBox(const float* m, const glm::vec3& min, const glm::vec3& max, Bounds& out)
+{
+    glm::vec3 center = 0.5f * (min + max);
+    glm::vec3 extent = 0.5f * (max - min);
+
+    // m[4 * col + row]
+    for (int i = 0; i < 3; i++) {
+        float c = m[12 + i];
+        float e = 0;
+        for (int j = 0; j < 3; j++) {
+            c += m[4 * j + i] * center[j];
+            e += std::abs(m[4 * j + i]) * extent[j];
+        }
+        out.min[i] = c - e;
+        out.max[i] = c + e;
+    }
+}
+
+#endif
+
+}
+
+Bounds TransformBounds(const glm::mat4& m, const glm::vec3& min, const glm::vec3& max)
+{
+    Bounds out;
+    TransformBox(glm::value_ptr(m), min, max, out);
+    return out;
+}
+
+void ComputeWorldBounds(const std::vector<Entity*>& entities, std::vector<Bounds>& bounds)
+{
+    PROFILE_ZONE("ComputeWorldBounds");
+
+    bounds.resize(entities.size());
+
+    for (unsigned i = 0; i < entities.size(); i++) {
+        const Entity* ent = entities[i];
+        glm::mat4 world = ent->getWorldMatrix();
+        TransformBox(glm::value_ptr(world), ent->mMin, ent->mMax, bounds[i]);
+    }
+}
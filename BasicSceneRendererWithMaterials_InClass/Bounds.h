@@ -0,0 +1,39 @@
+#ifndef BOUNDS_H_
+#define BOUNDS_H_
+
+#include "glshell.h"
+
+#include <vector>
+
+class Entity;
+
+//
+// Axis-aligned box
+//
+struct Bounds {
+    glm::vec3   min;
+    glm::vec3   max;
+
+    Bounds()
+        : min(0.0f), max(0.0f)
+    { }
+
+    Bounds(const glm::vec3& min, const glm::vec3& max)
+        : min(min), max(max)
+    { }
+};
+
+//
+// Smallest axis-aligned box around the box min..max transformed by an affine matrix.
+//
+// Uses Arvo's method: the center is transformed as a point, and each half-extent of the result
+// is the dot product of a row of the absolute 3x3 part of the matrix with the local
+// half-extents. That is exact for rotations (unlike transforming only the min and max corners)
+// and cheaper than transforming all 8 corners.
+//
+Bounds TransformBounds(const glm::mat4& m, const glm::vec3& min, const glm::vec3& max);
+
+// world-space boxes of entities' local bounds (mMin, mMax), one per entity
+void ComputeWorldBounds(const std::vector<Entity*>& entities, std::vector<Bounds>& bounds);
+
+#endif
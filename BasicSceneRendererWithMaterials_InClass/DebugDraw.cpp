@@ -0,0 +1,181 @@
+#include "DebugDraw.h"
+#include "GLStateCache.h"
+#include "Mesh.h"
+#include "Profiler.h"
+#include "Shaders.h"
+
+#include <cmath>
+
+DebugDraw::DebugDraw()
+    : mEnabled(true)
+    , mBuffer(0)
+    , mNumLinesFlushed(0)
+    , mBoxBuffer(0)
+    , mUnitBox(NULL)
+    , mNumBoxesFlushed(0)
+{
+}
+
+DebugDraw::~DebugDraw()
+{
+    destroy();
+}
+
+void DebugDraw::addLine(const glm::vec3& a, const glm::vec3& b, const glm::vec4& color)
+{
+    mVertices.push_back(VertexPositionColor(a.x, a.y, a.z, color.x, color.y, color.z, color.w));
+    mVertices.push_back(VertexPositionColor(b.x, b.y, b.z, color.x, color.y, color.z, color.w));
+}
+
+void DebugDraw::addBox(const glm::mat4& transform, const glm::vec3& min, const glm::vec3& max, const glm::vec4& color)
+{
+    // stretch the unit cube over min..max
+    BoxInstance box;
+    box.transform = glm::scale(glm::translate(transform, min), max - min);
+    box.color = color;
+    mBoxes.push_back(box);
+}
+
+void DebugDraw::addSphere(const glm::vec3& center, float radius, const glm::vec4& color)
+{
+    const float step = 2 * 3.14159265f / SPHERE_SEGMENTS;
+
+    glm::vec2 prev(radius, 0.0f);
+    for (int i = 1; i <= SPHERE_SEGMENTS; i++) {
+        glm::vec2 next(radius * std::cos(i * step), radius * std::sin(i * step));
+
+        addLine(center + glm::vec3(prev.x, prev.y, 0), center + glm::vec3(next.x, next.y, 0), color);
+        addLine(center + glm::vec3(prev.x, 0, prev.y), center + glm::vec3(next.x, 0, next.y), color);
+        addLine(center + glm::vec3(0, prev.x, prev.y), center + glm::vec3(0, next.x, next.y), color);
+
+        prev = next;
+    }
+}
+
+void DebugDraw::addAxes(const glm::mat4& transform, float scale)
+{
+    glm::vec3 origin(transform[3]);
+    addLine(origin, glm::vec3(transform * glm::vec4(scale, 0, 0, 1)), glm::vec4(1, 0, 0, 1));
+    addLine(origin, glm::vec3(transform * glm::vec4(0, scale, 0, 1)), glm::vec4(0, 1, 0, 1));
+    addLine(origin, glm::vec3(transform * glm::vec4(0, 0, scale, 1)), glm::vec4(0, 0, 1, 1));
+}
+
+Mesh* DebugDraw::CreateUnitBox()
+{
+    // corner i has x, y and z set to 1 where bits 0, 1 and 2 of i are set,
+    // and edges join corners that differ in one bit
+    std::vector<VertexPosition> vertices;
+    for (int i = 0; i < 8; i++) {
+        for (int bit = 1; bit < 8; bit <<= 1) {
+            if (!(i & bit)) {
+                int j = i | bit;
+                vertices.push_back(VertexPosition((GLfloat)(i & 1), (GLfloat)((i >> 1) & 1), (GLfloat)((i >> 2) & 1)));
+                vertices.push_back(VertexPosition((GLfloat)(j & 1), (GLfloat)((j >> 1) & 1), (GLfloat)((j >> 2) & 1)));
+            }
+        }
+    }
+
+    Mesh* mesh = new Mesh;
+    mesh->loadFromData(&vertices[0], vertices.size(), sizeof(vertices[0]), GL_LINES, vertices[0].getFormat());
+    return mesh;
+}
+
+void DebugDraw::flush(GLStateCache& state, ShaderProgram* lineProg, ShaderProgram* boxProg,
+                      const glm::mat4& projMatrix, const glm::mat4& viewMatrix)
+{
+    PROFILE_ZONE("DebugDraw::flush");
+
+    drawLines(state, lineProg, projMatrix, viewMatrix);
+    drawBoxes(state, boxProg, projMatrix, viewMatrix);
+}
+
+void DebugDraw::drawLines(GLStateCache& state, ShaderProgram* prog, const glm::mat4& projMatrix, const glm::mat4& viewMatrix)
+{
+    mNumLinesFlushed = mVertices.size() / 2;
+    if (mVertices.empty())
+        return;
+
+    if (!mBuffer)
+        glGenBuffers(1, &mBuffer);
+
+    // orphan last frame's storage instead of waiting for the GPU to finish with it
+    glBindBuffer(GL_ARRAY_BUFFER, mBuffer);
+    glBufferData(GL_ARRAY_BUFFER, mVertices.size() * sizeof(VertexPositionColor), &mVertices[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    state.useProgram(prog);
+    prog->sendUniform("u_ProjectionMatrix", projMatrix);
+    prog->sendUniform("u_ModelviewMatrix", viewMatrix);     // vertices are in world space
+
+    state.bindVertexBuffer(mBuffer, &VertexPositionColor::Format);
+    glDrawArrays(GL_LINES, 0, mVertices.size());
+
+    mVertices.clear();
+}
+
+void DebugDraw::drawBoxes(GLStateCache& state, ShaderProgram* prog, const glm::mat4& projMatrix, const glm::mat4& viewMatrix)
+{
+    mNumBoxesFlushed = mBoxes.size();
+    if (mBoxes.empty())
+        return;
+
+    if (!mUnitBox)
+        mUnitBox = CreateUnitBox();
+    if (!mBoxBuffer)
+        glGenBuffers(1, &mBoxBuffer);
+
+    state.useProgram(prog);
+    prog->sendUniform("u_ProjectionMatrix", projMatrix);
+    prog->sendUniform("u_ModelviewMatrix", viewMatrix);     // instance transforms end in world space
+
+    // positions come from the unit cube
+    state.bindMesh(mUnitBox);
+
+    // color and transform advance once per instance
+    const GLsizei stride = sizeof(BoxInstance);
+    glBindBuffer(GL_ARRAY_BUFFER, mBoxBuffer);
+    glBufferData(GL_ARRAY_BUFFER, mBoxes.size() * sizeof(BoxInstance), &mBoxes[0], GL_STREAM_DRAW);
+
+    for (int col = 0; col < 4; col++) {
+        glVertexAttribPointer(VA_TRANSFORM + col, 4, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)(col * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(VA_TRANSFORM + col);
+        glVertexAttribDivisor(VA_TRANSFORM + col, 1);
+    }
+    glVertexAttribPointer(VA_COLOR, 4, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)sizeof(glm::mat4));
+    glEnableVertexAttribArray(VA_COLOR);
+    glVertexAttribDivisor(VA_COLOR, 1);
+
+    // back to the buffer the state cache knows about
+    glBindBuffer(GL_ARRAY_BUFFER, mUnitBox->mVBO);
+
+    mUnitBox->drawInstanced(mBoxes.size());
+
+    // other meshes read these locations per vertex
+    for (int col = 0; col < 4; col++) {
+        glVertexAttribDivisor(VA_TRANSFORM + col, 0);
+        glDisableVertexAttribArray(VA_TRANSFORM + col);
+    }
+    glVertexAttribDivisor(VA_COLOR, 0);
+    glDisableVertexAttribArray(VA_COLOR);
+
+    mBoxes.clear();
+}
+
+void DebugDraw::destroy()
+{
+    mVertices.clear();
+    mBoxes.clear();
+
+    if (mBuffer) {
+        glDeleteBuffers(1, &mBuffer);
+        mBuffer = 0;
+    }
+
+    if (mBoxBuffer) {
+        glDeleteBuffers(1, &mBoxBuffer);
+        mBoxBuffer = 0;
+    }
+
+    delete mUnitBox;
+    mUnitBox = NULL;
+}
@@ -0,0 +1,107 @@
+#ifndef DEBUG_DRAW_H_
+#define DEBUG_DRAW_H_
+
+#include "Vertex.h"
+
+#include <vector>
+
+class GLStateCache;
+class ShaderProgram;
+class Mesh;
+
+//
+// Immediate-mode debug geometry.
+//
+// Lines, spheres and axes are appended to a vertex list in world space as they are requested
+// during the frame, and flush() draws all of them with a single GL_LINES call from a streaming
+// vertex buffer. Boxes only add an instance (transform and color) and are drawn with one
+// instanced call from a shared unit cube, so they cost the same memory however many there are.
+// While disabled, the calls return before doing any work.
+//
+class DebugDraw {
+public:
+    DebugDraw();
+    ~DebugDraw();
+
+    void                setEnabled(bool enabled)    { mEnabled = enabled; }
+    bool                isEnabled() const           { return mEnabled; }
+
+    void                line(const glm::vec3& a, const glm::vec3& b, const glm::vec4& color)
+    {
+        if (mEnabled)
+            addLine(a, b, color);
+    }
+
+    // box with corners min and max in the space given by 'transform'
+    void                box(const glm::mat4& transform, const glm::vec3& min, const glm::vec3& max, const glm::vec4& color)
+    {
+        if (mEnabled)
+            addBox(transform, min, max, color);
+    }
+
+    // three great circles
+    void                sphere(const glm::vec3& center, float radius, const glm::vec4& color)
+    {
+        if (mEnabled)
+            addSphere(center, radius, color);
+    }
+
+    // x, y and z axes in red, green and blue
+    void                axes(const glm::mat4& transform, float scale)
+    {
+        if (mEnabled)
+            addAxes(transform, scale);
+    }
+
+    //
+    // draw everything added since the last flush, and clear it: lines with a position/color
+    // program, boxes with one that reads the instance attributes (see DebugBox-vs.glsl)
+    //
+    void                flush(GLStateCache& state, ShaderProgram* lineProg, ShaderProgram* boxProg,
+                              const glm::mat4& projMatrix, const glm::mat4& viewMatrix);
+
+    void                destroy();
+
+    // lines drawn by the last flush
+    unsigned            getNumLines() const         { return mNumLinesFlushed; }
+
+    // boxes drawn by the last flush
+    unsigned            getNumBoxes() const         { return mNumBoxesFlushed; }
+
+private:
+                        DebugDraw(const DebugDraw&);
+    DebugDraw&          operator=(const DebugDraw&);
+
+    // segments of each circle drawn by sphere()
+    static const int    SPHERE_SEGMENTS = 24;
+
+    void                addLine(const glm::vec3& a, const glm::vec3& b, const glm::vec4& color);
+    void                addBox(const glm::mat4& transform, const glm::vec3& min, const glm::vec3& max, const glm::vec4& color);
+    void                addSphere(const glm::vec3& center, float radius, const glm::vec4& color);
+    void                addAxes(const glm::mat4& transform, float scale);
+
+    void                drawLines(GLStateCache& state, ShaderProgram* prog, const glm::mat4& projMatrix, const glm::mat4& viewMatrix);
+    void                drawBoxes(GLStateCache& state, ShaderProgram* prog, const glm::mat4& projMatrix, const glm::mat4& viewMatrix);
+
+    // edges of the cube from (0, 0, 0) to (1, 1, 1), in GL_LINES order
+    static Mesh*        CreateUnitBox();
+
+    // per-instance attributes of a box
+    struct BoxInstance {
+        glm::mat4       transform;      // unit cube to world space
+        glm::vec4       color;
+    };
+
+    bool                                mEnabled;
+
+    std::vector<VertexPositionColor>    mVertices;
+    GLuint                              mBuffer;
+    unsigned                            mNumLinesFlushed;
+
+    std::vector<BoxInstance>            mBoxes;
+    GLuint                              mBoxBuffer;
+    Mesh*                               mUnitBox;
+    unsigned                            mNumBoxesFlushed;
+};
+
+#endif
@@ -5,8 +5,8 @@
 #include "Transform.h"
 #include "Material.h"
 #include "Mesh.h"
-#include "AABB.h"
 #include "Prefabs.h"
+#include "Bounds.h"
 
 
 
@@ -14,12 +14,16 @@ class Entity {
     
 public:
 	Entity()
+		: mMin(0.0f)
+		, mMax(0.0f)
 	{}
 
     Entity(const Mesh* mesh, Material* material, const Transform& transform)
         : mTransform(transform)
         , mMesh(mesh)
         , mMaterial(material)
+        , mMin(0.0f)
+        , mMax(0.0f)
 
     { }
 
@@ -32,6 +36,10 @@ public:
 
 	{ }
 
+	// Arrow cleans up what it made for itself
+	virtual ~Entity()
+	{ }
+
 	Transform           mTransform;
 	const Mesh*         mMesh;
 	Material*     mMaterial;
@@ -39,10 +47,11 @@ public:
 	glm::vec3     mMin;
 	glm::vec3     mMax;
 
-	AABB* boundingBox = new AABB;
-
 	bool hasBoundingBox = false;
 
+	// drawn highlighted while something (the arrow's ray) touches the bounding box
+	bool boundingBoxHit = false;
+
     //
     // a bunch of useful getters
     //
@@ -53,6 +62,8 @@ public:
     const glm::vec3&    getPosition() const     { return mTransform.position; }
     const glm::quat&    getOrientation() const  { return mTransform.orientation; }
 
+	// mMin and mMax transformed as points (the ends of the arrow's ray, for example);
+	// once the entity is rotated they no longer bound it, see getWorldBounds
 	glm::vec3 getMin() { 
 		glm::vec4 worldPos = mTransform.toMatrix() * glm::vec4(mMin.x, mMin.y, mMin.z, 1);
 		return glm::vec3(worldPos);
@@ -63,39 +74,18 @@ public:
 		return glm::vec3(worldPos);
 	}
 
+	// world-space box around the local bounds mMin..mMax
+	Bounds getWorldBounds() const {
+		return TransformBounds(getWorldMatrix(), mMin, mMax);
+	}
+
+	// use the bounds of the mesh, computed when it was loaded
 	void createBoundingBox()
 	{
-		float maxX=0, minX=0, maxY=0, minY=0, maxZ=0, minZ=0;
-
-		for (VertexPositionNormal v : this->getMesh()->mVertices)
-		{
-			if (v.x > maxX) maxX = v.x;
-			if (v.x < minX) minX = v.x;
-			
-			if (v.y > maxY) maxY = v.y;
-			if (v.y < minY) minY = v.y;
-			
-			if (v.z > maxZ) maxZ = v.z;
-			if (v.z < minZ) minZ = v.z;
-		}
-
-		this->mMin = glm::vec3(minX, minY, minZ);
-		this->mMax = glm::vec3(maxX, maxY, maxZ);
-			
-		//build mesh
-
-		float width = maxX - minX;
-		float height = maxY - minY;
-		float depth = maxZ - minZ;
-
-		//green
-		this->boundingBox->mMesh = CreateWireframeBox(height, width, depth);
-
-		//red
-		this->boundingBox->mMesh2 = CreateWireframeBox2(height, width, depth);
-		
-		this->boundingBox->active = this->boundingBox->mMesh;
+		this->mMin = this->getMesh()->mBoundsMin;
+		this->mMax = this->getMesh()->mBoundsMax;
 
+		// no mesh of its own, the renderer draws it from a shared unit cube (see DebugDraw)
 		this->hasBoundingBox = true;
 	}
 	
@@ -0,0 +1,112 @@
+#include "GBuffer.h"
+
+#include <iostream>
+
+namespace {
+
+// allocate a render target texture (sampled with texelFetch, so filtering never applies)
+GLuint CreateTarget(GLenum internalFormat, GLenum format, GLenum type, int width, int height)
+{
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+
+    if (GLEW_ARB_texture_storage)
+        glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, width, height);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    return tex;
+}
+
+}
+
+
+GBuffer::GBuffer()
+    : mFBO(0)
+    , mDepthTexture(0)
+    , mWidth(0)
+    , mHeight(0)
+{
+    for (int i = 0; i < NUM_TARGETS; i++)
+        mTextures[i] = 0;
+}
+
+GBuffer::~GBuffer()
+{
+    destroy();
+}
+
+bool GBuffer::resize(int width, int height)
+{
+    if (mFBO && width == mWidth && height == mHeight)
+        return true;
+
+    destroy();
+
+    mWidth = width;
+    mHeight = height;
+
+    mTextures[ALBEDO] = CreateTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    mTextures[NORMAL] = CreateTarget(GL_RGBA16F, GL_RGBA, GL_FLOAT, width, height);
+    mTextures[SPECULAR] = CreateTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    mTextures[EMISSIVE] = CreateTarget(GL_RGBA16F, GL_RGBA, GL_FLOAT, width, height);
+    mDepthTexture = CreateTarget(GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &mFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+
+    GLenum drawBuffers[NUM_TARGETS];
+    for (int i = 0; i < NUM_TARGETS; i++) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, mTextures[i], 0);
+        drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+    }
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, mDepthTexture, 0);
+    glDrawBuffers(NUM_TARGETS, drawBuffers);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "*** G-buffer is incomplete (status 0x" << std::hex << status << std::dec << ")" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void GBuffer::destroy()
+{
+    if (mFBO) {
+        glDeleteFramebuffers(1, &mFBO);
+        glDeleteTextures(NUM_TARGETS, mTextures);
+        glDeleteTextures(1, &mDepthTexture);
+
+        mFBO = 0;
+        for (int i = 0; i < NUM_TARGETS; i++)
+            mTextures[i] = 0;
+        mDepthTexture = 0;
+    }
+}
+
+void GBuffer::bindFramebuffer() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+}
+
+void GBuffer::bindTextures(int firstUnit) const
+{
+    for (int i = 0; i < NUM_TARGETS; i++) {
+        glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+        glBindTexture(GL_TEXTURE_2D, mTextures[i]);
+    }
+    glActiveTexture(GL_TEXTURE0 + firstUnit + NUM_TARGETS);
+    glBindTexture(GL_TEXTURE_2D, mDepthTexture);
+
+    glActiveTexture(GL_TEXTURE0);
+}
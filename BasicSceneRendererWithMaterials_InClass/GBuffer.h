@@ -0,0 +1,57 @@
+#ifndef GBUFFER_H_
+#define GBUFFER_H_
+
+#include "glshell.h"
+
+//
+// Render targets for deferred shading.
+//
+// The geometry pass writes the surface attributes of the nearest fragment at every pixel,
+// and the lighting passes read them back with texelFetch:
+//   albedo:    RGBA8       material color
+//   normal:    RGBA16F     view-space normal
+//   specular:  RGBA8       specular color, shininess / MAX_SHININESS (see the deferred shaders)
+//   emissive:  RGBA16F     emissive color
+//   depth:     DEPTH24     used to reconstruct the view-space position
+//
+class GBuffer {
+public:
+    enum Target {
+        ALBEDO,
+        NORMAL,
+        SPECULAR,
+        EMISSIVE,
+
+        NUM_TARGETS
+    };
+
+    GBuffer();
+    ~GBuffer();
+
+    // (re)allocate the targets if the size changed; returns false if the framebuffer is incomplete
+    bool                resize(int width, int height);
+
+    void                destroy();
+
+    // render into the G-buffer
+    void                bindFramebuffer() const;
+
+    // bind the targets to units [firstUnit, firstUnit + NUM_TARGETS) and depth to firstUnit + NUM_TARGETS
+    void                bindTextures(int firstUnit) const;
+
+    GLuint              getTexture(Target target) const     { return mTextures[target]; }
+    GLuint              getDepthTexture() const             { return mDepthTexture; }
+    int                 getWidth() const                    { return mWidth; }
+    int                 getHeight() const                   { return mHeight; }
+
+private:
+                        GBuffer(const GBuffer&);
+    GBuffer&            operator=(const GBuffer&);
+
+    GLuint              mFBO;
+    GLuint              mTextures[NUM_TARGETS];
+    GLuint              mDepthTexture;
+    int                 mWidth, mHeight;
+};
+
+#endif
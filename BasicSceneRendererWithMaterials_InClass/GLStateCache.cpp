@@ -0,0 +1,194 @@
+#include "GLStateCache.h"
+#include "Shaders.h"
+#include "Mesh.h"
+
+namespace {
+
+// marks shadowed bindings and enums whose value is not known
+const GLuint UNKNOWN = 0xFFFFFFFF;
+
+}
+
+unsigned GLStateCache::Stats::totalIssued() const
+{
+    unsigned total = 0;
+    for (int i = 0; i < NUM_COUNTERS; i++)
+        total += issued[i];
+    return total;
+}
+
+unsigned GLStateCache::Stats::totalFiltered() const
+{
+    unsigned total = 0;
+    for (int i = 0; i < NUM_COUNTERS; i++)
+        total += filtered[i];
+    return total;
+}
+
+GLStateCache::GLStateCache()
+{
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        mStats.issued[i] = mStats.filtered[i] = 0;
+        mFrameStats.issued[i] = mFrameStats.filtered[i] = 0;
+    }
+
+    invalidate();
+}
+
+void GLStateCache::beginFrame()
+{
+    mFrameStats = mStats;
+    for (int i = 0; i < NUM_COUNTERS; i++)
+        mStats.issued[i] = mStats.filtered[i] = 0;
+
+    invalidate();
+}
+
+void GLStateCache::invalidate()
+{
+    mProgramKnown = false;
+    mProgram = NULL;
+    mVertexBuffer = UNKNOWN;
+    mVertexFormat = NULL;
+
+    for (int u = 0; u < MAX_TEXTURE_UNITS; u++) {
+        for (int t = 0; t < NUM_TARGET_SLOTS; t++)
+            mTextures[u][t] = UNKNOWN;
+        mSamplers[u] = UNKNOWN;
+    }
+
+    mEnabled.clear();
+    mDepthFunc = UNKNOWN;
+    mDepthMask = -1;
+    mCullFace = UNKNOWN;
+    mBlendSrc = mBlendDst = UNKNOWN;
+    mLineWidth = 0;
+}
+
+int GLStateCache::SlotIndex(GLenum target)
+{
+    switch (target) {
+    case GL_TEXTURE_2D:         return SLOT_2D;
+    case GL_TEXTURE_2D_ARRAY:   return SLOT_2D_ARRAY;
+    case GL_TEXTURE_BUFFER:     return SLOT_BUFFER;
+    default:                    return -1;
+    }
+}
+
+bool GLStateCache::check(Counter counter, bool changed)
+{
+    if (changed)
+        ++mStats.issued[counter];
+    else
+        ++mStats.filtered[counter];
+    return changed;
+}
+
+void GLStateCache::useProgram(const ShaderProgram* prog)
+{
+    if (check(PROGRAM, !mProgramKnown || prog != mProgram)) {
+        if (prog)
+            prog->activate();
+        else
+            glUseProgram(0);
+        mProgram = prog;
+        mProgramKnown = true;
+    }
+}
+
+void GLStateCache::bindMesh(const Mesh* mesh)
+{
+    bindVertexBuffer(mesh->mVBO, mesh->mFormat);
+}
+
+void GLStateCache::bindVertexBuffer(GLuint buffer, const VertexFormat* format)
+{
+    if (check(MESH, buffer != mVertexBuffer || format != mVertexFormat)) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        format->activate();
+        mVertexBuffer = buffer;
+        mVertexFormat = format;
+    }
+}
+
+void GLStateCache::bindTexture(int unit, GLenum target, GLuint tex)
+{
+    int slot = SlotIndex(target);
+    bool shadowed = slot >= 0 && unit < MAX_TEXTURE_UNITS;
+
+    if (check(TEXTURE, !shadowed || mTextures[unit][slot] != tex)) {
+        if (unit != 0)
+            glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, tex);
+        if (unit != 0)
+            glActiveTexture(GL_TEXTURE0);
+
+        if (shadowed)
+            mTextures[unit][slot] = tex;
+    }
+}
+
+void GLStateCache::bindSampler(int unit, GLuint sampler)
+{
+    bool shadowed = unit < MAX_TEXTURE_UNITS;
+
+    if (check(SAMPLER, !shadowed || mSamplers[unit] != sampler)) {
+        glBindSampler(unit, sampler);
+        if (shadowed)
+            mSamplers[unit] = sampler;
+    }
+}
+
+void GLStateCache::setEnabled(GLenum cap, bool enabled)
+{
+    std::map<GLenum, bool>::iterator it = mEnabled.find(cap);
+
+    if (check(RENDER_STATE, it == mEnabled.end() || it->second != enabled)) {
+        if (enabled)
+            glEnable(cap);
+        else
+            glDisable(cap);
+        mEnabled[cap] = enabled;
+    }
+}
+
+void GLStateCache::setDepthFunc(GLenum func)
+{
+    if (check(RENDER_STATE, func != mDepthFunc)) {
+        glDepthFunc(func);
+        mDepthFunc = func;
+    }
+}
+
+void GLStateCache::setDepthMask(bool mask)
+{
+    if (check(RENDER_STATE, mDepthMask != (int)mask)) {
+        glDepthMask(mask ? GL_TRUE : GL_FALSE);
+        mDepthMask = mask;
+    }
+}
+
+void GLStateCache::setCullFace(GLenum face)
+{
+    if (check(RENDER_STATE, face != mCullFace)) {
+        glCullFace(face);
+        mCullFace = face;
+    }
+}
+
+void GLStateCache::setBlendFunc(GLenum srcFactor, GLenum dstFactor)
+{
+    if (check(RENDER_STATE, srcFactor != mBlendSrc || dstFactor != mBlendDst)) {
+        glBlendFunc(srcFactor, dstFactor);
+        mBlendSrc = srcFactor;
+        mBlendDst = dstFactor;
+    }
+}
+
+void GLStateCache::setLineWidth(float width)
+{
+    if (check(RENDER_STATE, width != mLineWidth)) {
+        glLineWidth(width);
+        mLineWidth = width;
+    }
+}
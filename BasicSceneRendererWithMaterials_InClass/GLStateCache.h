@@ -0,0 +1,106 @@
+#ifndef GL_STATE_CACHE_H_
+#define GL_STATE_CACHE_H_
+
+#include "glshell.h"
+#include <map>
+
+class ShaderProgram;
+class Mesh;
+class VertexFormat;
+
+//
+// Shadows the GL state the renderer changes while drawing and drops calls that would not
+// change anything.
+//
+// The cache only knows about changes made through it, so it forgets everything at the start
+// of each frame (textures are reloaded between frames, for example). Code that changes the
+// same state directly in the middle of a frame must call invalidate() afterwards.
+//
+// Texture and sampler bindings follow the renderer's convention of leaving texture unit 0
+// active.
+//
+class GLStateCache {
+public:
+    enum Counter {
+        PROGRAM,
+        MESH,
+        TEXTURE,
+        SAMPLER,
+        RENDER_STATE,   // enables, depth, cull, blend and line width
+
+        NUM_COUNTERS
+    };
+
+    struct Stats {
+        unsigned    issued[NUM_COUNTERS];       // calls passed on to GL
+        unsigned    filtered[NUM_COUNTERS];     // redundant calls dropped
+
+        unsigned    totalIssued() const;
+        unsigned    totalFiltered() const;
+    };
+
+    static const int    MAX_TEXTURE_UNITS = 16;
+
+    GLStateCache();
+
+    // forget the shadowed state and start counting a new frame
+    void                beginFrame();
+
+    // forget the shadowed state (the next call of each kind goes to GL)
+    void                invalidate();
+
+    void                useProgram(const ShaderProgram* prog);
+    // vertex buffer and vertex format (meshes that share both, like most meshes in the
+    // geometry heap, don't need a rebind)
+    void                bindMesh(const Mesh* mesh);
+    void                bindVertexBuffer(GLuint buffer, const VertexFormat* format);
+
+    void                bindTexture(int unit, GLenum target, GLuint tex);
+    void                bindSampler(int unit, GLuint sampler);
+
+    void                setEnabled(GLenum cap, bool enabled);
+    void                setDepthFunc(GLenum func);
+    void                setDepthMask(bool mask);
+    void                setCullFace(GLenum face);
+    void                setBlendFunc(GLenum srcFactor, GLenum dstFactor);
+    void                setLineWidth(float width);
+
+    // counters of the last complete frame, and of the current one so far
+    const Stats&        getFrameStats() const       { return mFrameStats; }
+    const Stats&        getCurrentStats() const     { return mStats; }
+
+private:
+    // texture targets shadowed per unit (others are passed through)
+    enum TargetSlot {
+        SLOT_2D,
+        SLOT_2D_ARRAY,
+        SLOT_BUFFER,
+
+        NUM_TARGET_SLOTS
+    };
+
+    static int          SlotIndex(GLenum target);     // -1 if not shadowed
+
+    // count a call and return whether it has to be issued
+    bool                check(Counter counter, bool changed);
+
+    bool                    mProgramKnown;
+    const ShaderProgram*    mProgram;
+    GLuint                  mVertexBuffer;      // UNKNOWN if not known
+    const VertexFormat*     mVertexFormat;
+
+    GLuint                  mTextures[MAX_TEXTURE_UNITS][NUM_TARGET_SLOTS];
+    GLuint                  mSamplers[MAX_TEXTURE_UNITS];
+
+    std::map<GLenum, bool>  mEnabled;
+    GLenum                  mDepthFunc;
+    int                     mDepthMask;         // -1 = unknown
+    GLenum                  mCullFace;
+    GLenum                  mBlendSrc, mBlendDst;
+    float                   mLineWidth;         // <= 0 = unknown
+
+    Stats                   mStats;
+    Stats                   mFrameStats;
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include "GeometryHeap.h"
+
+#include <algorithm>
+#include <iostream>
+
+GeometryHeap::GeometryHeap()
+{
+}
+
+GeometryHeap::~GeometryHeap()
+{
+    // blocks left here belong to meshes that were never deleted, and go away with the context
+}
+
+bool GeometryHeap::AllocateFromBlock(Block& block, GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset)
+{
+    std::map<GLintptr, GLsizeiptr>::iterator it;
+    for (it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it) {
+        GLintptr start = it->first;
+        GLintptr end = it->first + it->second;
+        GLintptr aligned = (start + alignment - 1) / alignment * alignment;
+
+        if (aligned + size > end)
+            continue;
+
+        // keep what is left on either side
+        block.freeRanges.erase(it);
+        if (aligned > start)
+            block.freeRanges[start] = aligned - start;
+        if (aligned + size < end)
+            block.freeRanges[aligned + size] = end - (aligned + size);
+
+        offset = aligned;
+        ++block.numAllocations;
+        return true;
+    }
+
+    return false;
+}
+
+GeometryHeap::Allocation GeometryHeap::allocate(GLsizeiptr size, GLsizeiptr alignment, const void* data)
+{
+    Allocation alloc;
+    if (size <= 0)
+        return alloc;
+
+    alignment = std::max<GLsizeiptr>(alignment, 1);
+
+    unsigned b = 0;
+    while (b < mBlocks.size() && !AllocateFromBlock(mBlocks[b], size, alignment, alloc.offset))
+        ++b;
+
+    if (b == mBlocks.size()) {
+        Block block;
+        block.size = size > BLOCK_SIZE ? size : BLOCK_SIZE;
+        block.freeRanges[0] = block.size;
+        block.numAllocations = 0;
+
+        glGenBuffers(1, &block.buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, block.buffer);
+        glBufferData(GL_ARRAY_BUFFER, block.size, NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        mBlocks.push_back(block);
+        AllocateFromBlock(mBlocks.back(), size, alignment, alloc.offset);
+    }
+
+    alloc.buffer = mBlocks[b].buffer;
+    alloc.size = size;
+
+    if (data) {
+        glBindBuffer(GL_ARRAY_BUFFER, alloc.buffer);
+        glBufferSubData(GL_ARRAY_BUFFER, alloc.offset, size, data);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    return alloc;
+}
+
+void GeometryHeap::free(const Allocation& alloc)
+{
+    if (!alloc.buffer)
+        return;
+
+    unsigned b = 0;
+    while (b < mBlocks.size() && mBlocks[b].buffer != alloc.buffer)
+        ++b;
+
+    if (b == mBlocks.size()) {
+        std::cerr << "*** Freeing geometry that is not in the heap (buffer " << alloc.buffer << ")" << std::endl;
+        return;
+    }
+
+    Block& block = mBlocks[b];
+
+    if (--block.numAllocations == 0) {
+        glDeleteBuffers(1, &block.buffer);
+        mBlocks.erase(mBlocks.begin() + b);
+        return;
+    }
+
+    // merge with the free ranges right before and after it
+    GLintptr start = alloc.offset;
+    GLintptr end = alloc.offset + alloc.size;
+
+    std::map<GLintptr, GLsizeiptr>::iterator next = block.freeRanges.lower_bound(start);
+    if (next != block.freeRanges.end() && next->first == end) {
+        end += next->second;
+        next = block.freeRanges.erase(next);
+    }
+
+    if (next != block.freeRanges.begin()) {
+        std::map<GLintptr, GLsizeiptr>::iterator prev = next;
+        --prev;
+        if (prev->first + prev->second == start) {
+            start = prev->first;
+            block.freeRanges.erase(prev);
+        }
+    }
+
+    block.freeRanges[start] = end - start;
+}
+
+GeometryHeapStats GeometryHeap::getStats() const
+{
+    GeometryHeapStats stats;
+    stats.numBlocks = mBlocks.size();
+
+    for (unsigned b = 0; b < mBlocks.size(); b++) {
+        const Block& block = mBlocks[b];
+        stats.numAllocations += block.numAllocations;
+        stats.numFreeRanges += block.freeRanges.size();
+        stats.reservedBytes += block.size;
+
+        std::map<GLintptr, GLsizeiptr>::const_iterator it;
+        for (it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it) {
+            stats.freeBytes += it->second;
+            stats.largestFreeBytes = std::max(stats.largestFreeBytes, it->second);
+        }
+    }
+
+    stats.usedBytes = stats.reservedBytes - stats.freeBytes;
+    return stats;
+}
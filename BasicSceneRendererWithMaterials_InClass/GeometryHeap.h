@@ -0,0 +1,84 @@
+#ifndef GEOMETRY_HEAP_H_
+#define GEOMETRY_HEAP_H_
+
+#include "glshell.h"
+
+#include <map>
+#include <vector>
+
+//
+// Memory statistics, computed by GeometryHeap::getStats()
+//
+struct GeometryHeapStats {
+    unsigned    numBlocks;
+    unsigned    numAllocations;
+    unsigned    numFreeRanges;
+
+    GLsizeiptr  reservedBytes;      // size of all blocks
+    GLsizeiptr  usedBytes;          // bytes in allocations
+    GLsizeiptr  freeBytes;          // including the gaps left by alignment
+    GLsizeiptr  largestFreeBytes;   // largest allocation that fits without a new block
+
+    GeometryHeapStats()
+        : numBlocks(0), numAllocations(0), numFreeRanges(0)
+        , reservedBytes(0), usedBytes(0), freeBytes(0), largestFreeBytes(0)
+    { }
+
+    // fraction of the reserved memory in use
+    float       utilization() const     { return reservedBytes ? (float)usedBytes / reservedBytes : 0.0f; }
+
+    // 0 when all free memory is in one range, approaching 1 as it is split into small pieces
+    float       fragmentation() const   { return freeBytes ? 1.0f - (float)largestFreeBytes / freeBytes : 0.0f; }
+};
+
+
+//
+// Sub-allocates vertex data from a few large buffers, so meshes don't each need their own.
+//
+// Each block is a BLOCK_SIZE vertex buffer (larger allocations get a block of their own) with a
+// free list of byte ranges, kept sorted so freed ranges merge with their neighbors. Allocations
+// are first fit, aligned to a multiple of the vertex size so they can be drawn with the first
+// vertex argument of glDrawArrays. Blocks are released when their last allocation is freed.
+//
+class GeometryHeap {
+public:
+    static const GLsizeiptr     BLOCK_SIZE = 4 << 20;
+
+    struct Allocation {
+        GLuint          buffer;     // 0 if nothing is allocated
+        GLintptr        offset;
+        GLsizeiptr      size;
+
+        Allocation()
+            : buffer(0), offset(0), size(0)
+        { }
+    };
+
+    GeometryHeap();
+    ~GeometryHeap();
+
+    // allocate 'size' bytes at a multiple of 'alignment' and upload 'data' (if not NULL) there
+    Allocation          allocate(GLsizeiptr size, GLsizeiptr alignment, const void* data);
+
+    void                free(const Allocation& alloc);
+
+    GeometryHeapStats   getStats() const;
+
+private:
+                        GeometryHeap(const GeometryHeap&);
+    GeometryHeap&       operator=(const GeometryHeap&);
+
+    struct Block {
+        GLuint                          buffer;
+        GLsizeiptr                      size;
+        std::map<GLintptr, GLsizeiptr>  freeRanges;     // offset -> size, never adjacent
+        unsigned                        numAllocations;
+    };
+
+    // carve an allocation out of a block; returns false if it does not fit
+    static bool         AllocateFromBlock(Block& block, GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset);
+
+    std::vector<Block>  mBlocks;
+};
+
+#endif
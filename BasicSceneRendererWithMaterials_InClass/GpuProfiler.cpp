@@ -0,0 +1,137 @@
+#include "GpuProfiler.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <cstring>
+
+GpuProfiler::GpuProfiler()
+    : mFrameIndex(0)
+    , mCurrent(NULL)
+    , mNumResults(0)
+    , mNumFrames(0)
+    , mNumRead(0)
+    , mNumDropped(0)
+{
+    std::memset(mFrames, 0, sizeof(mFrames));
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    // queries go away with the context
+}
+
+bool GpuProfiler::create()
+{
+    if (!GLEW_VERSION_3_3 && !GLEW_ARB_timer_query)
+        return false;
+
+    for (int f = 0; f < NUM_FRAMES; f++) {
+        glGenQueries(2 * MAX_PASSES, mFrames[f].queries);
+        mFrames[f].numPasses = 0;
+        mFrames[f].passOpen = false;
+    }
+
+    mFrameIndex = 0;
+    mNumResults = 0;
+    mNumFrames = 0;
+    mNumRead = 0;
+    mNumDropped = 0;
+    return true;
+}
+
+void GpuProfiler::destroy()
+{
+    if (!isEnabled())
+        return;
+
+    for (int f = 0; f < NUM_FRAMES; f++)
+        glDeleteQueries(2 * MAX_PASSES, mFrames[f].queries);
+
+    std::memset(mFrames, 0, sizeof(mFrames));
+    mCurrent = NULL;
+}
+
+bool GpuProfiler::readFrame(Frame& frame)
+{
+    if (frame.numPasses == 0)
+        return true;
+
+    // queries finish in order, so the last one being ready means they all are
+    GLint available = 0;
+    glGetQueryObjectiv(frame.queries[2 * frame.numPasses - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return false;
+
+    mNumResults = frame.numPasses;
+    ++mNumRead;
+
+    for (unsigned i = 0; i < frame.numPasses; i++) {
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(frame.queries[2 * i], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(frame.queries[2 * i + 1], GL_QUERY_RESULT, &end);
+
+        mResultNames[i] = frame.names[i];
+        mResultMillis[i] = (end - start) * 1e-6;
+
+        Profiler::RecordGpu(frame.names[i], (long long)start + frame.cpuOffsetNanos, (long long)end + frame.cpuOffsetNanos);
+    }
+
+    return true;
+}
+
+void GpuProfiler::beginFrame()
+{
+    if (!isEnabled())
+        return;
+
+    // this slot was issued NUM_FRAMES frames ago
+    Frame& frame = mFrames[mFrameIndex];
+    if (!readFrame(frame))
+        ++mNumDropped;
+
+    frame.numPasses = 0;
+    frame.passOpen = false;
+    ++mNumFrames;
+
+    // the GPU clock has its own epoch; remember how it relates to the CPU's right now
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    long long cpuNow = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    frame.cpuOffsetNanos = cpuNow - gpuNow;
+
+    mCurrent = &frame;
+}
+
+void GpuProfiler::endFrame()
+{
+    if (!mCurrent)
+        return;
+
+    endPass();
+    mCurrent = NULL;
+    mFrameIndex = (mFrameIndex + 1) % NUM_FRAMES;
+}
+
+void GpuProfiler::beginPass(const char* name)
+{
+    if (!mCurrent)
+        return;
+
+    endPass();
+    if (mCurrent->numPasses == MAX_PASSES)
+        return;
+
+    glQueryCounter(mCurrent->queries[2 * mCurrent->numPasses], GL_TIMESTAMP);
+    mCurrent->names[mCurrent->numPasses] = name;
+    mCurrent->passOpen = true;
+}
+
+void GpuProfiler::endPass()
+{
+    if (!mCurrent || !mCurrent->passOpen)
+        return;
+
+    glQueryCounter(mCurrent->queries[2 * mCurrent->numPasses + 1], GL_TIMESTAMP);
+    ++mCurrent->numPasses;
+    mCurrent->passOpen = false;
+}
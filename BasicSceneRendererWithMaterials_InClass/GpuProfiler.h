@@ -0,0 +1,79 @@
+#ifndef GPU_PROFILER_H_
+#define GPU_PROFILER_H_
+
+#include "glshell.h"
+
+//
+// Measures render passes on the GPU with timestamp queries.
+//
+// Each pass is bracketed by two glQueryCounter(GL_TIMESTAMP) queries. The queries of a frame
+// are read back NUM_FRAMES frames later, when the GPU is normally done with them, so reading
+// never waits; frames whose results are still not ready are dropped. Results go into the CPU
+// profiler's trace while it captures (converted to CPU time with the offset between the two
+// clocks when the frame was issued), and the pass times of the last frame read are kept for
+// printing.
+//
+// Timer queries are core in GL 3.3, so this also works on Mesa's software rasterizers.
+//
+class GpuProfiler {
+public:
+    static const int    NUM_FRAMES = 3;
+    static const int    MAX_PASSES = 8;
+
+    GpuProfiler();
+    ~GpuProfiler();
+
+    // returns false (and stays disabled) without timer queries
+    bool                create();
+    void                destroy();
+
+    bool                isEnabled() const                   { return mFrames[0].queries[0] != 0; }
+
+    // read back the oldest frame, then start measuring this one
+    void                beginFrame();
+    void                endFrame();
+
+    // passes don't nest; beginning one ends the previous one. Names must be string literals.
+    void                beginPass(const char* name);
+    void                endPass();
+
+    // the last frame read back
+    unsigned            getNumPasses() const                { return mNumResults; }
+    const char*         getPassName(unsigned i) const       { return mResultNames[i]; }
+    double              getPassMillis(unsigned i) const     { return mResultMillis[i]; }
+
+    // frames measured, frames read back, and frames whose results were not ready in time
+    // (the last NUM_FRAMES frames measured are never read)
+    unsigned            getNumFrames() const                { return mNumFrames; }
+    unsigned            getNumRead() const                  { return mNumRead; }
+    unsigned            getNumDropped() const               { return mNumDropped; }
+
+private:
+                        GpuProfiler(const GpuProfiler&);
+    GpuProfiler&        operator=(const GpuProfiler&);
+
+    struct Frame {
+        GLuint          queries[2 * MAX_PASSES];    // start and end of each pass
+        const char*     names[MAX_PASSES];
+        unsigned        numPasses;
+        bool            passOpen;
+        long long       cpuOffsetNanos;             // steady_clock minus GPU time when issued
+    };
+
+    // read a frame's results if they are ready; returns false if they are not
+    bool                readFrame(Frame& frame);
+
+    Frame               mFrames[NUM_FRAMES];
+    unsigned            mFrameIndex;
+    Frame*              mCurrent;                   // NULL outside beginFrame/endFrame
+
+    unsigned            mNumResults;
+    const char*         mResultNames[MAX_PASSES];
+    double              mResultMillis[MAX_PASSES];
+
+    unsigned            mNumFrames;
+    unsigned            mNumRead;
+    unsigned            mNumDropped;
+};
+
+#endif
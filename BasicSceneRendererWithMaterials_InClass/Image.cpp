@@ -2,6 +2,15 @@
 
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// use SSE2 stores to fill RLE runs where available
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define TGA_USE_SSE2
+#  include <emmintrin.h>
+#endif
 
 enum TargaFileType {
     TARGA_RGB               = 2,
@@ -60,6 +69,42 @@ void Image::Deallocate()
     mBytesPerPixel = 0;
 }
 
+void Image::Downsample(int levels)
+{
+    for (int level = 0; level < levels && (mWidth > 1 || mHeight > 1); level++) {
+        int srcWidth = mWidth;
+        int srcHeight = mHeight;
+        int bpp = mBytesPerPixel;
+        int dstWidth = std::max(srcWidth / 2, 1);
+        int dstHeight = std::max(srcHeight / 2, 1);
+
+        const unsigned char* src = reinterpret_cast<const unsigned char*>(mData);
+        unsigned char* dst = new unsigned char[dstWidth * dstHeight * bpp];
+
+        for (int j = 0; j < dstHeight; j++) {
+            // clamp the second row/column for odd (or 1 pixel) dimensions
+            int j0 = 2 * j;
+            int j1 = std::min(j0 + 1, srcHeight - 1);
+            for (int i = 0; i < dstWidth; i++) {
+                int i0 = 2 * i;
+                int i1 = std::min(i0 + 1, srcWidth - 1);
+                for (int c = 0; c < bpp; c++) {
+                    unsigned sum = src[(j0 * srcWidth + i0) * bpp + c]
+                                 + src[(j0 * srcWidth + i1) * bpp + c]
+                                 + src[(j1 * srcWidth + i0) * bpp + c]
+                                 + src[(j1 * srcWidth + i1) * bpp + c];
+                    dst[(j * dstWidth + i) * bpp + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+
+        delete [] mData;
+        mData = reinterpret_cast<char*>(dst);
+        mWidth = dstWidth;
+        mHeight = dstHeight;
+    }
+}
+
 bool Image::LoadTarga(const std::string& path)
 {
     // open the file in binary mode
@@ -87,6 +132,13 @@ bool Image::LoadTarga(const std::string& path)
         return false;
     }
 
+    // make sure the file is big enough to hold the header and the optional id field
+    if (len < sizeof(TargaHeader) || len < sizeof(TargaHeader) + (unsigned char)buf[0]) {
+        std::cerr << "*** File '" << path << "' is too small to be a TGA image" << std::endl;
+        delete [] buf;  // avoid a leak
+        return false;
+    }
+
     // the header is at the beginning of the file contents; use a cast to reinterpret that chunk of memory
     TargaHeader* hdr = reinterpret_cast<TargaHeader*>(buf);
 
@@ -134,7 +186,12 @@ bool Image::LoadTarga(const std::string& path)
     case TARGA_RLE_RGB:
     case TARGA_RLE_GRAYSCALE:
         // load RLE-compressed image
-        LoadTargaRLE(hdr, imgData);
+        if (!LoadTargaRLE(hdr, imgData, buf + len)) {
+            std::cerr << "*** Corrupt or unsupported RLE data in '" << path << "'" << std::endl;
+            delete [] buf;
+            Deallocate();
+            return false;
+        }
         break;
     default:
         // we should never get here
@@ -151,6 +208,50 @@ bool Image::LoadTarga(const std::string& path)
     return true;
 }
 
+bool Image::SaveTarga(const std::string& path) const
+{
+    if (!mData || (mBytesPerPixel != 1 && mBytesPerPixel != 3 && mBytesPerPixel != 4)) {
+        std::cerr << "*** Can't save this image as TGA: '" << path << "'" << std::endl;
+        return false;
+    }
+
+    TargaHeader hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    hdr.imageTypeCode = mBytesPerPixel == 1 ? TARGA_GRAYSCALE : TARGA_RGB;
+    hdr.width = (unsigned short)mWidth;
+    hdr.height = (unsigned short)mHeight;
+    hdr.bpp = (unsigned char)(8 * mBytesPerPixel);
+    hdr.imageDesc = mBytesPerPixel == 4 ? 8 : 0;    // alpha bits; bit 5 clear keeps the rows bottom-up, as in memory
+
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file.good()) {
+        std::cerr << "*** Failed to open file '" << path << "' for writing" << std::endl;
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+
+    // convert RGB(A) back to BGR(A) a row at a time
+    int rowlen = mBytesPerPixel * mWidth;
+    std::vector<char> row(rowlen);
+    for (int j = 0; j < mHeight; j++) {
+        const char* src = mData + j * rowlen;
+        std::memcpy(&row[0], src, rowlen);
+        if (mBytesPerPixel > 1) {
+            for (int i = 0; i < rowlen; i += mBytesPerPixel)
+                std::swap(row[i], row[i + 2]);
+        }
+        file.write(&row[0], rowlen);
+    }
+
+    if (!file.good()) {
+        std::cerr << "*** Failed to write file '" << path << "'" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
 void Image::LoadTargaUncompressed(const TargaHeader* hdr, const char* imgData)
 {
     int rowlen = (hdr->bpp / 8) * hdr->width;  // bytes per row
@@ -215,150 +316,147 @@ void Image::LoadTargaUncompressed(const TargaHeader* hdr, const char* imgData)
     }
 }
 
-void Image::LoadTargaRLE(const TargaHeader* hdr, const char* imgData)
+//
+// helpers for the RLE decoder
+//
+
+// copy one pixel, converting BGR(A) to RGB(A)
+template <int BPP>
+inline void CopyPixel(unsigned char* dst, const unsigned char* src)
 {
-    int rowlen = (hdr->bpp / 8) * hdr->width;  // bytes per row
-    int rowstep;
-    char* dstRow;
-    // check bit 5 of image descriptor to determine row ordering
-    if (hdr->imageDesc & 0x20) {
-        // bottom-to-top
-        rowstep = -rowlen;
-        dstRow = mData + rowlen * (hdr->height - 1);
+    if (BPP == 1) {
+        dst[0] = src[0];
     } else {
-        // top-to-bottom
-        rowstep = rowlen;
-        dstRow = mData;
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+        if (BPP == 4)
+            dst[3] = src[3];
     }
+}
 
-    const unsigned numPixels = hdr->width * hdr->height;
-    unsigned numPixelsRead = 0;
-    unsigned short numPixelsInRow = 0;
-    char* p = dstRow;
+// fill 'count' pixels with copies of a single (already converted) pixel
+template <int BPP>
+inline void FillPixels(unsigned char* dst, const unsigned char* pixel, size_t count)
+{
+    size_t n = count * BPP;
 
-    switch (hdr->bpp) {
-    case 24:
-        //std::cout << "~~ Loading 24 bpp, RLE" << std::endl;
-        while (numPixelsRead < numPixels) {
-            unsigned char count = (unsigned char)*imgData++;
-            if (count > 127) {
-                // RLE packet
-                count -= 127;
-                char b = *imgData++;
-                char g = *imgData++;
-                char r = *imgData++;
-                for (unsigned char i = 0; i < count; i++) {
-                    *p++ = r;
-                    *p++ = g;
-                    *p++ = b;
-                    if (++numPixelsInRow == hdr->width) {
-                        // advance to next row
-                        dstRow += rowstep;
-                        p = dstRow;
-                        numPixelsInRow = 0;
-                    }
-                }
+    // short runs are the common case; just store them pixel by pixel
+    if (n < 48) {
+        for (size_t i = 0; i < count; i++, dst += BPP)
+            std::memcpy(dst, pixel, BPP);
+        return;
+    }
+
+    // 48 bytes hold a whole number of 1, 3 and 4 byte pixels, so the pattern can be stored in blocks
+    unsigned char pattern[48];
+    for (int i = 0; i < 48; i += BPP)
+        std::memcpy(pattern + i, pixel, BPP);
+
+#ifdef TGA_USE_SSE2
+    __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern));
+    __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern + 16));
+    __m128i p2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern + 32));
+    for (; n >= 48; n -= 48, dst += 48) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), p0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), p1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 32), p2);
+    }
+#else
+    for (; n >= 48; n -= 48, dst += 48)
+        std::memcpy(dst, pattern, 48);
+#endif
+
+    std::memcpy(dst, pattern, n);
+}
+
+// decode RLE packets into dst as one long run of pixels (packets are allowed to span rows);
+// returns false if the source data runs out before the image is complete
+template <int BPP>
+static bool DecodeTargaRLE(unsigned char* dst, size_t numPixels, const unsigned char* src, const unsigned char* srcEnd)
+{
+    while (numPixels > 0) {
+        if (src >= srcEnd)
+            return false;
+
+        unsigned char packet = *src++;
+        size_t count = (packet & 0x7f) + 1;
+
+        // never write past the image, even if the last packet claims more pixels
+        if (count > numPixels)
+            count = numPixels;
+
+        if (packet & 0x80) {
+            // RLE packet: one pixel value repeated
+            if (srcEnd - src < BPP)
+                return false;
+            unsigned char pixel[BPP];
+            CopyPixel<BPP>(pixel, src);
+            FillPixels<BPP>(dst, pixel, count);
+            src += BPP;
+        } else {
+            // raw packet: 'count' literal pixels, bounds checked once for the whole packet
+            size_t n = count * BPP;
+            if ((size_t)(srcEnd - src) < n)
+                return false;
+            if (BPP == 1) {
+                std::memcpy(dst, src, n);
             } else {
-                // raw packet
-                ++count;
-                for (unsigned char i = 0; i < count; i++) {
-                    char b = *imgData++;
-                    char g = *imgData++;
-                    char r = *imgData++;
-                    *p++ = r;
-                    *p++ = g;
-                    *p++ = b;
-                    if (++numPixelsInRow == hdr->width) {
-                        // advance to next row
-                        dstRow += rowstep;
-                        p = dstRow;
-                        numPixelsInRow = 0;
-                    }
-                }
+                for (size_t i = 0; i < n; i += BPP)
+                    CopyPixel<BPP>(dst + i, src + i);
             }
-            numPixelsRead += count;
+            src += n;
         }
-        break;
 
+        dst += count * BPP;
+        numPixels -= count;
+    }
+
+    return true;
+}
+
+// reverse the order of rows in place
+static void FlipRows(unsigned char* data, size_t rowlen, int numRows)
+{
+    std::vector<unsigned char> tmp(rowlen);
+    unsigned char* top = data;
+    unsigned char* bottom = data + rowlen * (numRows - 1);
+    for (; top < bottom; top += rowlen, bottom -= rowlen) {
+        std::memcpy(&tmp[0], top, rowlen);
+        std::memcpy(top, bottom, rowlen);
+        std::memcpy(bottom, &tmp[0], rowlen);
+    }
+}
+
+bool Image::LoadTargaRLE(const TargaHeader* hdr, const char* imgData, const char* imgEnd)
+{
+    unsigned char* dst = reinterpret_cast<unsigned char*>(mData);
+    const unsigned char* src = reinterpret_cast<const unsigned char*>(imgData);
+    const unsigned char* srcEnd = reinterpret_cast<const unsigned char*>(imgEnd);
+    size_t numPixels = (size_t)hdr->width * hdr->height;
+
+    bool ok;
+    switch (hdr->bpp) {
+    case 24:
+        ok = DecodeTargaRLE<3>(dst, numPixels, src, srcEnd);
+        break;
     case 32:
-        //std::cout << "~~ Loading 24 bpp, RLE" << std::endl;
-        while (numPixelsRead < numPixels) {
-            unsigned char count = (unsigned char)*imgData++;
-            if (count > 127) {
-                // RLE packet
-                count -= 127;
-                char b = *imgData++;
-                char g = *imgData++;
-                char r = *imgData++;
-                char a = *imgData++;
-                for (unsigned char i = 0; i < count; i++) {
-                    *p++ = r;
-                    *p++ = g;
-                    *p++ = b;
-                    *p++ = a;
-                    if (++numPixelsInRow == hdr->width) {
-                        // advance to next row
-                        dstRow += rowstep;
-                        p = dstRow;
-                        numPixelsInRow = 0;
-                    }
-                }
-            } else {
-                // raw packet
-                ++count;
-                for (unsigned char i = 0; i < count; i++) {
-                    char b = *imgData++;
-                    char g = *imgData++;
-                    char r = *imgData++;
-                    char a = *imgData++;
-                    *p++ = r;
-                    *p++ = g;
-                    *p++ = b;
-                    *p++ = a;
-                    if (++numPixelsInRow == hdr->width) {
-                        // advance to next row
-                        dstRow += rowstep;
-                        p = dstRow;
-                        numPixelsInRow = 0;
-                    }
-                }
-            }
-            numPixelsRead += count;
-        }
+        ok = DecodeTargaRLE<4>(dst, numPixels, src, srcEnd);
         break;
-
     case 8:
-        //std::cout << "~~ Loading 8 bpp, RLE" << std::endl;
-        while (numPixelsRead < numPixels) {
-            unsigned char count = (unsigned char)*imgData++;
-            if (count > 127) {
-                // RLE packet
-                count -= 127;
-                char val = *imgData++;
-                for (unsigned char i = 0; i < count; i++) {
-                    *p++ = val;
-                    if (++numPixelsInRow == hdr->width) {
-                        // advance to next row
-                        dstRow += rowstep;
-                        p = dstRow;
-                        numPixelsInRow = 0;
-                    }
-                }
-            } else {
-                // raw packet
-                ++count;
-                for (unsigned char i = 0; i < count; i++) {
-                    *p++ = *imgData++;
-                    if (++numPixelsInRow == hdr->width) {
-                        // advance to next row
-                        dstRow += rowstep;
-                        p = dstRow;
-                        numPixelsInRow = 0;
-                    }
-                }
-            }
-            numPixelsRead += count;
-        }
+        ok = DecodeTargaRLE<1>(dst, numPixels, src, srcEnd);
+        break;
+    default:
+        ok = false;
         break;
     }
+
+    if (!ok)
+        return false;
+
+    // check bit 5 of image descriptor to determine row ordering
+    if (hdr->imageDesc & 0x20)
+        FlipRows(dst, (size_t)(hdr->bpp / 8) * hdr->width, hdr->height);
+
+    return true;
 }
@@ -31,12 +31,18 @@ public:
 
     bool            LoadTarga(const std::string& path);
 
+                    // write an uncompressed TGA with the rows in the same order LoadTarga gives them
+    bool            SaveTarga(const std::string& path) const;
+
+                    // halve the image size 'levels' times with a 2x2 box filter (stops at 1x1)
+    void            Downsample(int levels);
+
 private:
                     //
                     // helper methods for loading TGA images
                     //
     void            LoadTargaUncompressed(const TargaHeader* hdr, const char* imgData);
-    void            LoadTargaRLE(const TargaHeader* hdr, const char* imgData);
+    bool            LoadTargaRLE(const TargaHeader* hdr, const char* imgData, const char* imgEnd);
 };
 
 //
@@ -56,4 +62,22 @@ inline GLenum GetTextureType(const Image& img)
     }
 }
 
+//
+// return the sized internal format used to allocate immutable storage for a texture type
+// (single-channel images are stored as GL_R8 and swizzled back to luminance when sampled)
+//
+inline GLenum GetSizedTextureFormat(GLenum type)
+{
+    switch (type) {
+    case GL_RGB:
+        return GL_RGB8;
+    case GL_RGBA:
+        return GL_RGBA8;
+    case GL_LUMINANCE:
+        return GL_R8;
+    default:
+        return 0;
+    }
+}
+
 #endif
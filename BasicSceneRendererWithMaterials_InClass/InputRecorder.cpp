@@ -0,0 +1,255 @@
+#include "InputRecorder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+static const char       LOG_MAGIC[4] = { 'G', 'L', 'I', 'N' };
+static const unsigned   LOG_VERSION = 1;
+static const size_t     LOG_HEADER_SIZE = 7;    // magic, version, number of keys and buttons
+
+// write recorded frames out once this much has piled up
+static const size_t     FLUSH_SIZE = 64 * 1024;
+
+// the mouse values in the order of their bits in a frame's change mask
+static int* MouseFields(MouseState& state, int i)
+{
+    int* fields[] = { &state.x, &state.y, &state.prevX, &state.prevY, &state.deltaX, &state.deltaY, &state.wheelDelta };
+    return fields[i];
+}
+
+static const int NUM_MOUSE_FIELDS = 7;
+
+static void PutU8(std::vector<char>& buf, unsigned value)
+{
+    buf.push_back((char)(value & 0xff));
+}
+
+static void PutI16(std::vector<char>& buf, int value)
+{
+    // coordinates beyond +-32767 pixels don't happen on real screens
+    value = std::min(std::max(value, -32768), 32767);
+    PutU8(buf, (unsigned)value);
+    PutU8(buf, (unsigned)value >> 8);
+}
+
+static void PutF32(std::vector<char>& buf, float value)
+{
+    unsigned bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 4; i++)
+        PutU8(buf, bits >> (8 * i));
+}
+
+InputRecorder::InputRecorder()
+    : mReadPos(0)
+    , mReplaying(false)
+    , mNumFrames(0)
+{
+}
+
+InputRecorder::~InputRecorder()
+{
+    stop();
+}
+
+void InputRecorder::reset()
+{
+    mBuffer.clear();
+    mReadPos = 0;
+    mNumFrames = 0;
+
+    // before the first frame nothing is down, like a new Keyboard and Mouse
+    mKeyboard.keys.assign(KC_NUM_KEYS, false);
+    mKeyboard.prevKeys.assign(KC_NUM_KEYS, false);
+    std::memset(&mMouse, 0, sizeof(mMouse));
+}
+
+bool InputRecorder::startRecording(const std::string& path)
+{
+    stop();
+    reset();
+
+    mFile.open(path.c_str(), std::ios::binary);
+    if (!mFile.good()) {
+        std::cerr << "*** Failed to open file '" << path << "' for writing" << std::endl;
+        mFile.close();
+        return false;
+    }
+    mPath = path;
+
+    mBuffer.insert(mBuffer.end(), LOG_MAGIC, LOG_MAGIC + 4);
+    PutU8(mBuffer, LOG_VERSION);
+    PutU8(mBuffer, KC_NUM_KEYS);
+    PutU8(mBuffer, MOUSE_NUM_BUTTONS);
+
+    std::cout << "Recording input to " << path << std::endl;
+    return true;
+}
+
+bool InputRecorder::startReplay(const std::string& path)
+{
+    stop();
+    reset();
+
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file.good()) {
+        std::cerr << "*** Failed to open file '" << path << "'" << std::endl;
+        return false;
+    }
+
+    file.seekg(0, std::ios::end);
+    size_t len = (size_t)file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    mBuffer.resize(len);
+    if (len > 0)
+        file.read(&mBuffer[0], len);
+    if (!file.good()) {
+        std::cerr << "*** Failed to read file '" << path << "'" << std::endl;
+        mBuffer.clear();
+        return false;
+    }
+
+    // logs from a build with other keys or buttons would map to the wrong ones
+    if (len < LOG_HEADER_SIZE || std::memcmp(&mBuffer[0], LOG_MAGIC, 4) != 0
+        || (unsigned char)mBuffer[4] != LOG_VERSION
+        || (unsigned char)mBuffer[5] != KC_NUM_KEYS || (unsigned char)mBuffer[6] != MOUSE_NUM_BUTTONS) {
+        std::cerr << "*** File '" << path << "' is not an input log of this version" << std::endl;
+        mBuffer.clear();
+        return false;
+    }
+
+    mReadPos = LOG_HEADER_SIZE;
+    mReplaying = true;
+    mPath = path;
+
+    std::cout << "Replaying input from " << path << std::endl;
+    return true;
+}
+
+void InputRecorder::stop()
+{
+    if (isRecording()) {
+        flush();
+        mFile.close();
+        std::cout << "Recorded " << mNumFrames << " frames of input to " << mPath << std::endl;
+    } else if (mReplaying) {
+        std::cout << "Replayed " << mNumFrames << " frames of input from " << mPath << std::endl;
+    }
+
+    mBuffer.clear();
+    mReplaying = false;
+}
+
+void InputRecorder::flush()
+{
+    if (!mBuffer.empty()) {
+        mFile.write(&mBuffer[0], mBuffer.size());
+        mBuffer.clear();
+    }
+
+    if (!mFile.good())
+        std::cerr << "*** Failed to write file '" << mPath << "'" << std::endl;
+}
+
+void InputRecorder::recordFrame(const Keyboard& keyboard, const Mouse& mouse, float deltaT)
+{
+    KeyboardState keys;
+    MouseState state;
+    keyboard.getState(keys);
+    mouse.getState(state);
+
+    PutF32(mBuffer, deltaT);
+
+    // the keys that changed since the previous frame
+    size_t countPos = mBuffer.size();
+    PutU8(mBuffer, 0);
+    unsigned numChanged = 0;
+    for (unsigned k = 0; k < keys.keys.size(); k++) {
+        if (keys.keys[k] != mKeyboard.keys[k]) {
+            PutU8(mBuffer, k);
+            ++numChanged;
+        }
+    }
+    mBuffer[countPos] = (char)numChanged;
+
+    PutU8(mBuffer, state.buttons);
+
+    unsigned mask = 0;
+    for (int i = 0; i < NUM_MOUSE_FIELDS; i++) {
+        if (*MouseFields(state, i) != *MouseFields(mMouse, i))
+            mask |= 1 << i;
+    }
+    PutU8(mBuffer, mask);
+    for (int i = 0; i < NUM_MOUSE_FIELDS; i++) {
+        if (mask & (1 << i))
+            PutI16(mBuffer, *MouseFields(state, i));
+    }
+
+    mKeyboard = keys;
+    mMouse = state;
+    ++mNumFrames;
+
+    if (mBuffer.size() >= FLUSH_SIZE)
+        flush();
+}
+
+bool InputRecorder::replayFrame(Keyboard& keyboard, Mouse& mouse, float& deltaT)
+{
+    if (!mReplaying || mReadPos == mBuffer.size())
+        return false;
+
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(&mBuffer[0]);
+    size_t pos = mReadPos;
+    size_t end = mBuffer.size();
+
+    // time step, key count, buttons and mouse mask
+    if (end - pos < 7) {
+        std::cerr << "*** Input log '" << mPath << "' ends in the middle of a frame" << std::endl;
+        return false;
+    }
+
+    unsigned bits = data[pos] | data[pos + 1] << 8 | data[pos + 2] << 16 | (unsigned)data[pos + 3] << 24;
+    std::memcpy(&deltaT, &bits, sizeof(deltaT));
+    pos += 4;
+
+    unsigned numChanged = data[pos++];
+    if (end - pos < numChanged + 2) {
+        std::cerr << "*** Input log '" << mPath << "' ends in the middle of a frame" << std::endl;
+        return false;
+    }
+
+    // what was down in the frame before is what the app sees as the previous state
+    mKeyboard.prevKeys = mKeyboard.keys;
+    for (unsigned i = 0; i < numChanged; i++) {
+        unsigned k = data[pos++];
+        if (k >= mKeyboard.keys.size()) {
+            std::cerr << "*** Bad key code in input log '" << mPath << "'" << std::endl;
+            return false;
+        }
+        mKeyboard.keys[k] = !mKeyboard.keys[k];
+    }
+
+    mMouse.prevButtons = mMouse.buttons;
+    mMouse.buttons = data[pos++];
+
+    unsigned mask = data[pos++];
+    for (int i = 0; i < NUM_MOUSE_FIELDS; i++) {
+        if (mask & (1 << i)) {
+            if (end - pos < 2) {
+                std::cerr << "*** Input log '" << mPath << "' ends in the middle of a frame" << std::endl;
+                return false;
+            }
+            *MouseFields(mMouse, i) = (short)(data[pos] | data[pos + 1] << 8);
+            pos += 2;
+        }
+    }
+
+    mReadPos = pos;
+    ++mNumFrames;
+
+    keyboard.setState(mKeyboard);
+    mouse.setState(mMouse);
+    return true;
+}
@@ -0,0 +1,72 @@
+#ifndef INPUT_RECORDER_H_
+#define INPUT_RECORDER_H_
+
+#include "glshell.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+//
+// Records the keyboard, mouse and time step of every frame into a compact binary log, and
+// plays a log back so a recorded session can be rerun frame for frame, e.g. as a repeatable
+// performance trace (see GLShell::SetInputRecorder).
+//
+// The log is a header ("GLIN", version, number of keys and mouse buttons) followed by one
+// record per frame:
+//
+//   float32    time step
+//   uint8      number of keys that went down or up, then that many uint8 KeyCodes
+//   uint8      mouse buttons down, a bit per MouseButton
+//   uint8      which of the mouse x, y, prevX, prevY, deltaX, deltaY and wheelDelta changed,
+//              then an int16 for each of those
+//
+// all little-endian. A frame without input is 7 bytes. The previous key and button states
+// are not stored, they are the states of the frame before.
+//
+// A replay reads the whole log up front, and a recording is written in large chunks, so the
+// frames being measured don't wait on the disk.
+//
+class InputRecorder {
+public:
+                    InputRecorder();
+                    ~InputRecorder();
+
+    bool            startRecording(const std::string& path);
+    bool            startReplay(const std::string& path);
+
+    // write out what is left of a recording, or drop a replay
+    void            stop();
+
+    bool            isRecording() const             { return mFile.is_open(); }
+    bool            isReplaying() const             { return mReplaying; }
+
+    unsigned        getNumFrames() const            { return mNumFrames; }
+
+    // called by the shell before each app update
+    void            recordFrame(const Keyboard& keyboard, const Mouse& mouse, float deltaT);
+
+    // false once the log has run out (or is corrupt)
+    bool            replayFrame(Keyboard& keyboard, Mouse& mouse, float& deltaT);
+
+private:
+                    InputRecorder(const InputRecorder&);
+                    InputRecorder& operator= (const InputRecorder&);
+
+    void            reset();
+    void            flush();
+
+    std::ofstream       mFile;              // while recording
+    std::vector<char>   mBuffer;            // recorded frames not written yet, or the whole replay
+    size_t              mReadPos;
+
+    bool                mReplaying;
+    unsigned            mNumFrames;
+    std::string         mPath;
+
+    // the previous frame, that the next one is stored relative to
+    KeyboardState       mKeyboard;
+    MouseState          mMouse;
+};
+
+#endif
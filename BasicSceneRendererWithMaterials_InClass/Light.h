@@ -0,0 +1,79 @@
+#ifndef LIGHT_H_
+#define LIGHT_H_
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+//
+// A point light with distance attenuation 1 / (attQuad * d^2 + attLin * d + attConst)
+//
+struct PointLight {
+    glm::vec3       pos;
+    glm::vec3       color;
+    float           attQuad;
+    float           attLin;
+    float           attConst;
+
+    PointLight(const glm::vec3& pos = glm::vec3(0, 0, 0), const glm::vec3& color = glm::vec3(1, 1, 1),
+               float attQuad = 0.01f, float attLin = 0.1f, float attConst = 1.0f)
+        : pos(pos)
+        , color(color)
+        , attQuad(attQuad)
+        , attLin(attLin)
+        , attConst(attConst)
+    { }
+};
+
+//
+// return the distance at which the light's brightest channel falls below 'cutoff'
+// (lights whose attenuation never gets that low are given an infinite radius)
+//
+inline float LightRadius(const PointLight& light, float cutoff)
+{
+    float intensity = std::max(light.color.x, std::max(light.color.y, light.color.z));
+
+    // solve attQuad * d^2 + attLin * d + attConst = intensity / cutoff
+    float c = light.attConst - intensity / cutoff;
+    if (c >= 0)
+        return 0;   // never brighter than the cutoff
+
+    if (light.attQuad > 0)
+        return (-light.attLin + std::sqrt(light.attLin * light.attLin - 4 * light.attQuad * c)) / (2 * light.attQuad);
+    if (light.attLin > 0)
+        return -c / light.attLin;
+
+    return HUGE_VALF;
+}
+
+//
+// pack a light into the 3 RGBA texels read by shaders that take lights from a buffer texture:
+//   (pos.xyz, radius), (color.rgb, attConst), (attQuad, attLin, 0, 0)
+//
+inline void PackLight(const PointLight& light, float radius, float* texels)
+{
+    texels[0] = light.pos.x;
+    texels[1] = light.pos.y;
+    texels[2] = light.pos.z;
+    texels[3] = radius;
+    texels[4] = light.color.x;
+    texels[5] = light.color.y;
+    texels[6] = light.color.z;
+    texels[7] = light.attConst;
+    texels[8] = light.attQuad;
+    texels[9] = light.attLin;
+    texels[10] = 0;
+    texels[11] = 0;
+}
+
+//
+// return the attenuated intensity of the light's brightest channel at distance 'dist'
+//
+inline float LightIntensity(const PointLight& light, float dist)
+{
+    float intensity = std::max(light.color.x, std::max(light.color.y, light.color.z));
+    return intensity / (light.attQuad * dist * dist + light.attLin * dist + light.attConst);
+}
+
+#endif
@@ -0,0 +1,58 @@
+#include "LightBuffer.h"
+
+#include <algorithm>
+
+LightBuffer::LightBuffer()
+    : mBuffer(0)
+    , mTexture(0)
+{
+}
+
+LightBuffer::~LightBuffer()
+{
+    destroy();
+}
+
+void LightBuffer::upload(const std::vector<PointLight>& lights, float cutoff, float maxRadius)
+{
+    mData.resize(12 * lights.size());
+    for (unsigned i = 0; i < lights.size(); i++)
+        PackLight(lights[i], std::min(LightRadius(lights[i], cutoff), maxRadius), &mData[12 * i]);
+
+    if (!mBuffer) {
+        glGenBuffers(1, &mBuffer);
+        glGenTextures(1, &mTexture);
+
+        glBindBuffer(GL_TEXTURE_BUFFER, mBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, mTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // buffer textures need at least one texel
+    static const float empty[12] = { 0 };
+
+    glBindBuffer(GL_TEXTURE_BUFFER, mBuffer);
+    if (mData.empty())
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(empty), empty, GL_STREAM_DRAW);
+    else
+        glBufferData(GL_TEXTURE_BUFFER, mData.size() * sizeof(float), &mData[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightBuffer::bind(int unit) const
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_BUFFER, mTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void LightBuffer::destroy()
+{
+    if (mBuffer) {
+        glDeleteTextures(1, &mTexture);
+        glDeleteBuffers(1, &mBuffer);
+        mTexture = 0;
+        mBuffer = 0;
+    }
+}
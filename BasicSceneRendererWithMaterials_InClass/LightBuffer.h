@@ -0,0 +1,35 @@
+#ifndef LIGHT_BUFFER_H_
+#define LIGHT_BUFFER_H_
+
+#include "Light.h"
+#include "glshell.h"
+
+#include <vector>
+
+//
+// Point lights packed into an RGBA32F buffer texture (3 texels per light, see PackLight),
+// so a shader can read any number of lights indexed by instance or light id.
+//
+class LightBuffer {
+    GLuint              mBuffer;
+    GLuint              mTexture;
+    std::vector<float>  mData;
+
+                        LightBuffer(const LightBuffer&);
+    LightBuffer&        operator=(const LightBuffer&);
+
+public:
+    LightBuffer();
+    ~LightBuffer();
+
+    // pack and upload lights; each radius comes from LightRadius and is limited to maxRadius
+    void                upload(const std::vector<PointLight>& lights, float cutoff, float maxRadius);
+
+    void                bind(int unit) const;
+
+    void                destroy();
+
+    unsigned            getNumLights() const    { return mData.size() / 12; }
+};
+
+#endif
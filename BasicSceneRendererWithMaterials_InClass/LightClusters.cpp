@@ -0,0 +1,367 @@
+#include "LightClusters.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// range of tiles covered by view-space x in [center - radius, center + radius] at distances [d0, d1];
+// returns false if the range is off screen
+bool TileRange(float center, float radius, float d0, float d1, float tanHalf, int dim, int& t0, int& t1)
+{
+    // extreme slopes (x / distance) are reached at the nearest or farthest distance
+    float lo = std::min((center - radius) / d0, (center - radius) / d1);
+    float hi = std::max((center + radius) / d0, (center + radius) / d1);
+
+    // slope -> tile coordinate
+    float scale = 0.5f * dim / tanHalf;
+    float f0 = lo * scale + 0.5f * dim;
+    float f1 = hi * scale + 0.5f * dim;
+
+    if (f1 < 0 || f0 >= dim)
+        return false;
+
+    // clamp before converting, f0/f1 can be infinite for lights that never fade out
+    t0 = (int)std::max(f0, 0.0f);
+    t1 = (int)std::min(f1, dim - 1.0f);
+    return true;
+}
+
+bool SphereIntersectsBox(const glm::vec3& center, float radius, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+    float distSq = 0;
+    for (int i = 0; i < 3; i++) {
+        float d = std::max(boxMin[i] - center[i], 0.0f) + std::max(center[i] - boxMax[i], 0.0f);
+        distSq += d * d;
+    }
+    return distSq <= radius * radius;
+}
+
+template <typename T>
+void UploadBuffer(GLuint buffer, const std::vector<T>& data)
+{
+    static const T zero[4] = { 0 };     // buffer textures need at least one texel
+
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    if (data.empty())
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(zero), zero, GL_STREAM_DRAW);
+    else
+        glBufferData(GL_TEXTURE_BUFFER, data.size() * sizeof(T), &data[0], GL_STREAM_DRAW);
+}
+
+}
+
+
+LightClusters::LightClusters(int dimX, int dimY, int dimZ)
+    : mDimX(dimX)
+    , mDimY(dimY)
+    , mDimZ(dimZ)
+    , mNumThreads(1)
+    , mTanHalfX(1)
+    , mTanHalfY(1)
+    , mNear(1)
+    , mFar(2)
+    , mDepthScale(1)
+    , mViewportWidth(1)
+    , mViewportHeight(1)
+    , mLists(dimX * dimY * dimZ)
+    , mMaxLightsPerCluster(0)
+    , mNumActiveClusters(0)
+    , mWorkGeneration(0)
+    , mWorkThreads(1)
+    , mWorkPending(0)
+    , mWorkQuit(false)
+{
+    for (int i = 0; i < 3; i++) {
+        mBuffers[i] = 0;
+        mTextures[i] = 0;
+    }
+
+    setNumThreads(0);
+}
+
+LightClusters::~LightClusters()
+{
+    destroy();
+}
+
+void LightClusters::setProjection(float fovy, float aspect, float zNear, float zFar, int viewportWidth, int viewportHeight)
+{
+    mTanHalfY = std::tan(0.5f * fovy);
+    mTanHalfX = mTanHalfY * aspect;
+    mNear = zNear;
+    mFar = zFar;
+    mDepthScale = mDimZ / std::log(zFar / zNear);
+    mViewportWidth = viewportWidth;
+    mViewportHeight = viewportHeight;
+
+    // exponential depth slices keep clusters roughly cube-shaped
+    mSliceDepths.resize(mDimZ + 1);
+    for (int z = 0; z <= mDimZ; z++)
+        mSliceDepths[z] = zNear * std::pow(zFar / zNear, z / (float)mDimZ);
+
+    // view-space bounds of each cluster (the camera looks down -z)
+    mClusterBounds.resize(getNumClusters());
+    for (int z = 0; z < mDimZ; z++) {
+        float d0 = mSliceDepths[z];
+        float d1 = mSliceDepths[z + 1];
+
+        for (int y = 0; y < mDimY; y++) {
+            float sy0 = (2.0f * y / mDimY - 1) * mTanHalfY;
+            float sy1 = (2.0f * (y + 1) / mDimY - 1) * mTanHalfY;
+
+            for (int x = 0; x < mDimX; x++) {
+                float sx0 = (2.0f * x / mDimX - 1) * mTanHalfX;
+                float sx1 = (2.0f * (x + 1) / mDimX - 1) * mTanHalfX;
+
+                Bounds& b = mClusterBounds[clusterIndex(x, y, z)];
+                b.min = glm::vec3(std::min(sx0 * d0, sx0 * d1), std::min(sy0 * d0, sy0 * d1), -d1);
+                b.max = glm::vec3(std::max(sx1 * d0, sx1 * d1), std::max(sy1 * d0, sy1 * d1), -d0);
+            }
+        }
+    }
+}
+
+void LightClusters::setNumThreads(int numThreads)
+{
+    if (numThreads <= 0)
+        numThreads = std::thread::hardware_concurrency();
+    numThreads = std::max(numThreads, 1);
+
+    // slices are the unit of work, more threads than slices would have nothing to do
+    numThreads = std::min(numThreads, mDimZ);
+
+    if (numThreads != mNumThreads || mWorkers.empty()) {
+        stopWorkers();
+        mNumThreads = numThreads;
+        startWorkers();
+    }
+}
+
+void LightClusters::startWorkers()
+{
+    // workers start out waiting for the build after the current one
+    mWorkQuit = false;
+    for (int t = 1; t < mNumThreads; t++)
+        mWorkers.push_back(std::thread(&LightClusters::workerMain, this, t, mWorkGeneration));
+}
+
+void LightClusters::stopWorkers()
+{
+    if (mWorkers.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mWorkMutex);
+        mWorkQuit = true;
+    }
+    mWorkReady.notify_all();
+
+    for (unsigned t = 0; t < mWorkers.size(); t++)
+        mWorkers[t].join();
+    mWorkers.clear();
+}
+
+void LightClusters::workerMain(int index, unsigned generation)
+{
+    for (;;) {
+        int numThreads;
+        {
+            std::unique_lock<std::mutex> lock(mWorkMutex);
+            while (!mWorkQuit && mWorkGeneration == generation)
+                mWorkReady.wait(lock);
+            if (mWorkQuit)
+                return;
+            generation = mWorkGeneration;
+            numThreads = mWorkThreads;
+        }
+
+        // small builds use fewer threads than there are workers
+        if (index >= numThreads)
+            continue;
+
+        binSlices(index, numThreads);
+
+        bool last;
+        {
+            std::lock_guard<std::mutex> lock(mWorkMutex);
+            last = --mWorkPending == 0;
+        }
+        if (last)
+            mWorkDone.notify_one();
+    }
+}
+
+int LightClusters::sliceIndex(float depth) const
+{
+    if (depth <= mNear)
+        return 0;
+    if (depth >= mFar)
+        return mDimZ - 1;
+    return std::min((int)(std::log(depth / mNear) * mDepthScale), mDimZ - 1);
+}
+
+void LightClusters::build(const std::vector<PointLight>& lights, float cutoff)
+{
+    PROFILE_ZONE("LightClusters::build");
+
+    // light spheres and the data the shader needs
+    mSpheres.resize(lights.size());
+    mLightData.resize(12 * lights.size());
+
+    for (unsigned i = 0; i < lights.size(); i++) {
+        const PointLight& light = lights[i];
+
+        Sphere& s = mSpheres[i];
+        s.center = light.pos;
+        s.radius = LightRadius(light, cutoff);
+
+        PackLight(light, s.radius, &mLightData[12 * i]);
+    }
+
+    for (unsigned c = 0; c < mLists.size(); c++)
+        mLists[c].clear();
+
+    // bin lights, interleaving slices between threads so near and far slices are shared out evenly
+    if (!mClusterBounds.empty()) {
+        int numThreads = std::min(mNumThreads, std::max((int)lights.size() / MIN_LIGHTS_PER_THREAD, 1));
+
+        if (numThreads > 1) {
+            if (mWorkers.empty())
+                startWorkers();
+
+            {
+                std::lock_guard<std::mutex> lock(mWorkMutex);
+                mWorkThreads = numThreads;
+                mWorkPending = numThreads - 1;
+                ++mWorkGeneration;
+            }
+            mWorkReady.notify_all();
+
+            binSlices(0, numThreads);
+
+            std::unique_lock<std::mutex> lock(mWorkMutex);
+            while (mWorkPending > 0)
+                mWorkDone.wait(lock);
+        } else {
+            binSlices(0, 1);
+        }
+    }
+
+    // pack the per-cluster lists into a single index list
+    mClusterData.resize(2 * mLists.size());
+    mIndices.clear();
+    mMaxLightsPerCluster = 0;
+    mNumActiveClusters = 0;
+
+    for (unsigned c = 0; c < mLists.size(); c++) {
+        const std::vector<GLuint>& list = mLists[c];
+
+        mClusterData[2 * c] = mIndices.size();
+        mClusterData[2 * c + 1] = list.size();
+        mIndices.insert(mIndices.end(), list.begin(), list.end());
+
+        mMaxLightsPerCluster = std::max(mMaxLightsPerCluster, (unsigned)list.size());
+        if (!list.empty())
+            ++mNumActiveClusters;
+    }
+}
+
+void LightClusters::binSlices(int firstSlice, int sliceStep)
+{
+    PROFILE_ZONE("LightClusters::binSlices");
+
+    for (unsigned i = 0; i < mSpheres.size(); i++) {
+        const Sphere& s = mSpheres[i];
+
+        float depth = -s.center.z;
+        if (s.radius <= 0 || depth + s.radius < mNear || depth - s.radius > mFar)
+            continue;
+
+        int z0 = sliceIndex(depth - s.radius);
+        int z1 = sliceIndex(depth + s.radius);
+
+        // first slice in [z0, z1] that belongs to this thread
+        int z = z0 + ((firstSlice - z0) % sliceStep + sliceStep) % sliceStep;
+
+        for (; z <= z1; z += sliceStep) {
+
+            // part of the sphere's depth range inside this slice
+            float d0 = std::max(depth - s.radius, mSliceDepths[z]);
+            float d1 = std::min(depth + s.radius, mSliceDepths[z + 1]);
+
+            int x0, x1, y0, y1;
+            if (!TileRange(s.center.x, s.radius, d0, d1, mTanHalfX, mDimX, x0, x1) ||
+                !TileRange(s.center.y, s.radius, d0, d1, mTanHalfY, mDimY, y0, y1))
+                continue;
+
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    int c = clusterIndex(x, y, z);
+                    const Bounds& b = mClusterBounds[c];
+                    if (SphereIntersectsBox(s.center, s.radius, b.min, b.max))
+                        mLists[c].push_back(i);
+                }
+            }
+        }
+    }
+}
+
+void LightClusters::upload()
+{
+    static const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+
+    if (!mBuffers[0]) {
+        glGenBuffers(3, mBuffers);
+        glGenTextures(3, mTextures);
+
+        // the textures keep referring to the buffers when their contents are replaced
+        for (int i = 0; i < 3; i++) {
+            glBindBuffer(GL_TEXTURE_BUFFER, mBuffers[i]);
+            glBindTexture(GL_TEXTURE_BUFFER, mTextures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], mBuffers[i]);
+        }
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    UploadBuffer(mBuffers[0], mLightData);
+    UploadBuffer(mBuffers[1], mClusterData);
+    UploadBuffer(mBuffers[2], mIndices);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::bind(ShaderProgram* prog, int firstUnit)
+{
+    for (int i = 0; i < 3; i++) {
+        glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+        glBindTexture(GL_TEXTURE_BUFFER, mTextures[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    prog->sendUniformInt("u_LightData", firstUnit);
+    prog->sendUniformInt("u_ClusterData", firstUnit + 1);
+    prog->sendUniformInt("u_LightIndices", firstUnit + 2);
+
+    prog->sendUniformInt("u_ClustersX", mDimX);
+    prog->sendUniformInt("u_ClustersY", mDimY);
+    prog->sendUniformInt("u_ClustersZ", mDimZ);
+    prog->sendUniform("u_ClusterScale", glm::vec2(mDimX / (float)mViewportWidth, mDimY / (float)mViewportHeight));
+    prog->sendUniform("u_ClusterNear", mNear);
+    prog->sendUniform("u_ClusterDepthScale", mDepthScale);
+}
+
+void LightClusters::destroy()
+{
+    stopWorkers();
+
+    if (mBuffers[0]) {
+        glDeleteTextures(3, mTextures);
+        glDeleteBuffers(3, mBuffers);
+        for (int i = 0; i < 3; i++) {
+            mBuffers[i] = 0;
+            mTextures[i] = 0;
+        }
+    }
+}
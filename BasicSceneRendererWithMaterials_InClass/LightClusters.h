@@ -0,0 +1,137 @@
+#ifndef LIGHT_CLUSTERS_H_
+#define LIGHT_CLUSTERS_H_
+
+#include "Light.h"
+#include "Shaders.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//
+// Bins point lights into view-space clusters ("froxels") for clustered forward shading.
+//
+// The view frustum is split into a grid of screen tiles, and each column of tiles is split
+// into depth slices that grow exponentially with distance. Every frame, build() finds the
+// clusters touched by each light's sphere of influence (radius from LightRadius) and records
+// a list of light indices per cluster. The fragment shader looks up the cluster containing
+// the fragment and only shades the lights in its list.
+//
+// Binning is split across threads by depth slice; each cluster is written by exactly one
+// thread, so no synchronization is needed until the lists are packed. The worker threads are
+// started once (by setNumThreads) and wait between builds, so a frame doesn't pay for thread
+// creation and the profiler sees the same threads every frame.
+//
+// The results are uploaded to three buffer textures:
+//   light data:    3 RGBA32F texels per light (pos.xyz, radius), (color.rgb, attConst), (attQuad, attLin, 0, 0)
+//   cluster data:  1 RG32UI texel per cluster (offset into the index list, number of lights)
+//   light indices: 1 R32UI texel per light reference
+//
+class LightClusters {
+public:
+    // below this many lights per thread, handing work to the workers costs more than it saves
+    static const int    MIN_LIGHTS_PER_THREAD = 128;
+
+    LightClusters(int dimX = 16, int dimY = 9, int dimZ = 24);
+    ~LightClusters();
+
+    // must be called whenever the projection or viewport changes
+    void                setProjection(float fovy, float aspect, float zNear, float zFar, int viewportWidth, int viewportHeight);
+
+    // number of binning threads (0 = one per hardware thread); restarts the workers
+    void                setNumThreads(int numThreads);
+    int                 getNumThreads() const           { return mNumThreads; }
+
+    // bin lights whose positions are in view space (CPU only)
+    void                build(const std::vector<PointLight>& lights, float cutoff);
+
+    // copy the results of the last build() to the buffer textures
+    void                upload();
+
+    // bind the buffer textures to units [firstUnit, firstUnit + 2] and send the cluster uniforms
+    void                bind(ShaderProgram* prog, int firstUnit);
+
+    // delete the GL objects and stop the workers (the next build() starts them again)
+    void                destroy();
+
+    int                 getDimX() const                 { return mDimX; }
+    int                 getDimY() const                 { return mDimY; }
+    int                 getDimZ() const                 { return mDimZ; }
+    int                 getNumClusters() const          { return mDimX * mDimY * mDimZ; }
+
+    // cluster index for a tile and slice
+    int                 clusterIndex(int x, int y, int z) const     { return (z * mDimY + y) * mDimX + x; }
+
+    // depth slice containing a view-space distance (clamped to the grid)
+    int                 sliceIndex(float depth) const;
+
+    // results of the last build()
+    unsigned            getNumLights() const            { return mLightData.size() / 12; }
+    unsigned            getNumIndices() const           { return mIndices.size(); }
+    unsigned            getMaxLightsPerCluster() const  { return mMaxLightsPerCluster; }
+    unsigned            getNumActiveClusters() const    { return mNumActiveClusters; }
+
+    const std::vector<GLuint>&  getClusterData() const  { return mClusterData; }
+    const std::vector<GLuint>&  getIndices() const      { return mIndices; }
+
+private:
+    struct Bounds {
+        glm::vec3   min, max;
+    };
+
+    struct Sphere {
+        glm::vec3   center;
+        float       radius;
+    };
+
+    // not copyable (owns GL objects)
+                        LightClusters(const LightClusters&);
+    LightClusters&      operator=(const LightClusters&);
+
+    // bin all lights into slices firstSlice, firstSlice + sliceStep, ...
+    void                binSlices(int firstSlice, int sliceStep);
+
+    void                startWorkers();
+    void                stopWorkers();
+    void                workerMain(int index, unsigned generation);
+
+    int                 mDimX, mDimY, mDimZ;
+    int                 mNumThreads;
+
+    // projection parameters
+    float               mTanHalfX, mTanHalfY;
+    float               mNear, mFar;
+    float               mDepthScale;            // slices per unit of log(depth / near)
+    int                 mViewportWidth, mViewportHeight;
+
+    std::vector<float>  mSliceDepths;           // mDimZ + 1 slice boundaries (positive view-space distances)
+    std::vector<Bounds> mClusterBounds;         // view-space bounding box of each cluster
+
+    // per-build state
+    std::vector<Sphere>                 mSpheres;
+    std::vector<std::vector<GLuint> >   mLists;     // light indices per cluster
+
+    // packed results
+    std::vector<float>  mLightData;
+    std::vector<GLuint> mClusterData;
+    std::vector<GLuint> mIndices;
+    unsigned            mMaxLightsPerCluster;
+    unsigned            mNumActiveClusters;
+
+    // worker threads 1 .. mNumThreads - 1 (the calling thread is thread 0)
+    std::vector<std::thread>    mWorkers;
+    std::mutex                  mWorkMutex;
+    std::condition_variable     mWorkReady;     // a new build, or time to quit
+    std::condition_variable     mWorkDone;      // the last worker of a build finished
+    unsigned                    mWorkGeneration;    // incremented for every build handed out
+    int                         mWorkThreads;       // threads taking part in the current build
+    int                         mWorkPending;       // workers still binning the current build
+    bool                        mWorkQuit;
+
+    // GL objects (created on first upload)
+    GLuint              mBuffers[3];
+    GLuint              mTextures[3];
+};
+
+#endif
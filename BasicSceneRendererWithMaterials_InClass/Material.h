@@ -2,11 +2,15 @@
 #define MATERIAL_H_
 
 #include "Texture.h"
+#include "TextureArray.h"
 
 struct Material {
     const Texture*  tex;
     glm::vec4       tint;
 
+    const TextureArray* texArray;   // if set, texture comes from this array instead of tex
+    int                 texLayer;   // layer in texArray
+
     glm::vec3       emissive;    // color/intensity of emissive light
     glm::vec3       specular;    // color/intensity of specular highlights
     float           shininess;   // determines specular highlight "focus"
@@ -14,6 +18,8 @@ struct Material {
     Material(const Texture* tex, const glm::vec4& tint = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f))
         : tex(tex)
         , tint(tint)
+        , texArray(NULL)
+        , texLayer(-1)
         , emissive(0, 0, 0)  // does not emit light
         , specular(0, 0, 0)  // no specular hightligts
         , shininess(16)      // medium shininess (meaningless unless specular color is set to something other than black)
@@ -23,6 +29,12 @@ struct Material {
 	{
 		tex = texture;
 	}
+
+	void setTextureLayer(const TextureArray* array, int layer)
+	{
+		texArray = array;
+		texLayer = layer;
+	}
 };
 
 #endif
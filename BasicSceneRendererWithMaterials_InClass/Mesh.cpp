@@ -1,21 +1,41 @@
 #include "Mesh.h"
 #include "common.h"
+#include "Profiler.h"
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>      // file I/O
 #include <iostream>     // console I/O
 
+// use SSE to reduce vertex positions to their bounds where available
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#  define MESH_USE_SSE
+#  include <xmmintrin.h>
+#endif
+
+GeometryHeap& Mesh::GetGeometryHeap()
+{
+    static GeometryHeap heap;
+    return heap;
+}
+
 Mesh::Mesh()
-    : mVBO(0)
-    , mFormat(NULL)
+    : mFormat(NULL)
     , mMode(0)
     , mNumVertices(0)
+    , mVertexSize(0)
+    , mBoundsMin(0.0f, 0.0f, 0.0f)
+    , mBoundsMax(0.0f, 0.0f, 0.0f)
+    , mBoundsCenter(0.0f, 0.0f, 0.0f)
+    , mBoundsRadius(0)
+    , mVBO(0)
+    , mFirstVertex(0)
 {
 }
 
 Mesh::~Mesh()
 {
-    if (mVBO)
-        glDeleteBuffers(1, &mVBO);
+    GetGeometryHeap().free(mAllocation);
 }
 
 bool Mesh::loadFromData(const void* data,
@@ -24,24 +44,80 @@ bool Mesh::loadFromData(const void* data,
                         GLenum mode,
                         const VertexFormat* format)
 {
-    // if there is no buffer, generate one
-    if (!mVBO) {
-        glGenBuffers(1, &mVBO);
-    }
+    // replace any earlier data
+    GeometryHeap& heap = GetGeometryHeap();
+    heap.free(mAllocation);
 
-    // upload the data to device RAM
-    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
-    glBufferData(GL_ARRAY_BUFFER, numVertices * vertexSize, data, GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // upload the data to device RAM, at a whole number of vertices from the start of the buffer
+    mAllocation = heap.allocate(numVertices * vertexSize, vertexSize, data);
+    mVBO = mAllocation.buffer;
+    mFirstVertex = (GLint)(mAllocation.offset / vertexSize);
 
     mMode = mode;
     mNumVertices = numVertices;
+    mVertexSize = vertexSize;
 
     mFormat = format;
 
+    computeBounds(data, numVertices, vertexSize);
+
     return true;
 }
 
+void Mesh::computeBounds(const void* data, GLsizei numVertices, GLsizei vertexSize)
+{
+    mBoundsMin = mBoundsMax = mBoundsCenter = glm::vec3(0.0f);
+    mBoundsRadius = 0;
+
+    if (numVertices <= 0)
+        return;
+
+    // every vertex structure starts with x, y, z
+    const char* vertexData = (const char*)data;
+
+#ifdef MESH_USE_SSE
+    // min and max of x, y, z in lanes 0-2 (lane 3 picks up whatever follows z and is ignored).
+    // A 16 byte load of the last vertex could read past the end of the data, so it is loaded
+    // separately.
+    const GLfloat* last = (const GLfloat*)(vertexData + (numVertices - 1) * vertexSize);
+    __m128 minPos = _mm_setr_ps(last[0], last[1], last[2], 0.0f);
+    __m128 maxPos = minPos;
+
+    for (GLsizei i = 0; i < numVertices - 1; i++) {
+        __m128 p = _mm_loadu_ps((const GLfloat*)(vertexData + i * vertexSize));
+        minPos = _mm_min_ps(minPos, p);
+        maxPos = _mm_max_ps(maxPos, p);
+    }
+
+    float minOut[4], maxOut[4];
+    _mm_storeu_ps(minOut, minPos);
+    _mm_storeu_ps(maxOut, maxPos);
+    mBoundsMin = glm::vec3(minOut[0], minOut[1], minOut[2]);
+    mBoundsMax = glm::vec3(maxOut[0], maxOut[1], maxOut[2]);
+#else
+    const GLfloat* first = (const GLfloat*)vertexData;
+    mBoundsMin = mBoundsMax = glm::vec3(first[0], first[1], first[2]);
+
+    for (GLsizei i = 1; i < numVertices; i++) {
+        const GLfloat* pos = (const GLfloat*)(vertexData + i * vertexSize);
+        glm::vec3 p(pos[0], pos[1], pos[2]);
+        mBoundsMin = glm::min(mBoundsMin, p);
+        mBoundsMax = glm::max(mBoundsMax, p);
+    }
+#endif
+
+    // sphere around the center of the box, through the farthest vertex
+    mBoundsCenter = 0.5f * (mBoundsMin + mBoundsMax);
+
+    float maxDist2 = 0;
+    for (GLsizei i = 0; i < numVertices; i++) {
+        const GLfloat* pos = (const GLfloat*)(vertexData + i * vertexSize);
+        glm::vec3 d = glm::vec3(pos[0], pos[1], pos[2]) - mBoundsCenter;
+        maxDist2 = std::max(maxDist2, glm::dot(d, d));
+    }
+    mBoundsRadius = std::sqrt(maxDist2);
+}
+
 void Mesh::activate() const
 {
     // bind the buffer
@@ -62,7 +138,30 @@ void Mesh::deactivate() const
 
 void Mesh::draw() const
 {
-    glDrawArrays(mMode, 0, mNumVertices);
+    glDrawArrays(mMode, mFirstVertex, mNumVertices);
+}
+
+void Mesh::drawInstanced(GLsizei numInstances) const
+{
+    glDrawArraysInstanced(mMode, mFirstVertex, mNumVertices, numInstances);
+}
+
+unsigned Mesh::getNumTriangles() const
+{
+    return CountTriangles(mMode, mNumVertices);
+}
+
+unsigned CountTriangles(GLenum mode, GLsizei numVertices)
+{
+    switch (mode) {
+    case GL_TRIANGLES:
+        return numVertices / 3;
+    case GL_TRIANGLE_STRIP:
+    case GL_TRIANGLE_FAN:
+        return numVertices > 2 ? numVertices - 2 : 0;
+    default:
+        return 0;
+    }
 }
 
 
@@ -73,6 +172,8 @@ struct TriFace {
 
 Mesh* LoadMesh(const std::string& path)
 {
+    PROFILE_ZONE("LoadMesh");
+
     std::cout << "Loading mesh from '" << path << "'" << std::endl;
 
     std::ifstream file(path.c_str());
@@ -191,7 +292,6 @@ Mesh* LoadMesh(const std::string& path)
     }
 
     Mesh* mesh = new Mesh;
-	mesh->mVertices = vertices;
     mesh->loadFromData(&vertices[0],               // address of data in memory
                        vertices.size(),            // number of vertices
                        sizeof(vertices[0]),        // size of each vertex
@@ -3,8 +3,8 @@
 
 #include "glshell.h"
 #include "Vertex.h"
+#include "GeometryHeap.h"
 #include <vector>
-#include "Vertex.h"
 
 class Mesh {
     
@@ -13,13 +13,25 @@ public:
 
     GLenum              mMode;          // drawing mode
     GLsizei             mNumVertices;   // number of vertices
+    GLsizei             mVertexSize;    // size of each vertex in bytes
 
+    // bounding box and sphere of the vertex positions in model space (computed by loadFromData)
+    glm::vec3           mBoundsMin;
+    glm::vec3           mBoundsMax;
+    glm::vec3           mBoundsCenter;
+    float               mBoundsRadius;
 
 
     Mesh();
     ~Mesh();
 
-	GLuint              mVBO;           // id of vertex buffer containing vertex data
+    // vertex data lives in a buffer shared with other meshes (see GetGeometryHeap)
+    GLuint              mVBO;           // id of the heap buffer containing the vertex data
+    GLint               mFirstVertex;   // index of the mesh's first vertex in mVBO
+    GeometryHeap::Allocation mAllocation;
+
+    // the heap all meshes allocate their vertices from
+    static GeometryHeap& GetGeometryHeap();
 
     bool loadFromData(const void* data,
                       GLsizei numVertices,
@@ -31,10 +43,21 @@ public:
     void deactivate() const;
 
     void draw() const;
+    void drawInstanced(GLsizei numInstances) const;
+
+    // triangles drawn by each instance
+    unsigned getNumTriangles() const;
 
-	std::vector<VertexPositionNormal> mVertices;
+private:
+    // bound the positions at the start of each vertex
+    void computeBounds(const void* data, GLsizei numVertices, GLsizei vertexSize);
 };
 
+//
+// Triangles drawn from 'numVertices' vertices in a drawing mode (none for points and lines)
+//
+unsigned CountTriangles(GLenum mode, GLsizei numVertices);
+
 //
 // Load mesh from a Wavefront OBJ file
 //
@@ -0,0 +1,588 @@
+#include "MicroBench.h"
+#include "Arrow.h"
+#include "BasicSceneRenderer.h"
+#include "Entity.h"
+#include "Image.h"
+#include "Mesh.h"
+#include "common.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+// give up growing the iteration count here, however fast the code is
+const long long MAX_ITERATIONS = 1000000000;
+
+// results are folded into this so the compiler can't drop the work being timed
+static volatile double sSink;
+
+MicroBenchState::MicroBenchState(int size, long long iterations)
+    : mSize(size)
+    , mIterations(iterations)
+    , mRemaining(iterations)
+    , mStarted(false)
+    , mSeconds(0)
+    , mBytes(0)
+    , mItems(0)
+{
+}
+
+bool MicroBenchState::keepRunning()
+{
+    if (!mStarted) {
+        mStarted = true;
+        mStart = std::chrono::high_resolution_clock::now();
+    }
+
+    if (mRemaining > 0) {
+        --mRemaining;
+        return true;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - mStart;
+    mSeconds = elapsed.count();
+    return false;
+}
+
+//
+// Synthetic inputs
+//
+
+// an OBJ-style line of 'count' tokens: a keyword and then numbers
+static std::string MakeTokenLine(int count, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> value(-100.0f, 100.0f);
+    std::ostringstream line;
+    line << "v";
+    for (int i = 1; i < count; i++)
+        line << ' ' << value(rng);
+    return line.str();
+}
+
+// a grid of side x side quads in the xz plane, two triangles each
+static std::string MakeGridObj(int side)
+{
+    std::ostringstream obj;
+    obj << "# " << side << "x" << side << " grid\n";
+    for (int z = 0; z <= side; z++) {
+        for (int x = 0; x <= side; x++)
+            obj << "v " << x - 0.5f * side << " " << 0.01f * ((x * 7 + z * 3) % 11) << " " << z - 0.5f * side << "\n";
+    }
+    for (int z = 0; z < side; z++) {
+        for (int x = 0; x < side; x++) {
+            int a = z * (side + 1) + x + 1;     // OBJ indices start at 1
+            int b = a + side + 1;
+            obj << "f " << a << " " << b << " " << a + 1 << "\n";
+            obj << "f " << a + 1 << " " << b << " " << b + 1 << "\n";
+        }
+    }
+    return obj.str();
+}
+
+static bool WriteFile(const std::string& path, const std::string& contents)
+{
+    std::ofstream file(path.c_str(), std::ios::binary);
+    file.write(contents.data(), contents.size());
+    return file.good();
+}
+
+// 'side' x 'side' RGBA pixels in runs of 1 to 8 equal pixels, so RLE uses both packet types
+static void MakeRunPixels(int side, std::vector<unsigned>& pixels)
+{
+    std::mt19937 rng(1);
+    pixels.resize(side * side);
+    for (size_t i = 0; i < pixels.size(); ) {
+        size_t run = std::min<size_t>(1 + rng() % 8, pixels.size() - i);
+        unsigned color = rng() | 0xff000000;
+        std::fill(pixels.begin() + i, pixels.begin() + i + run, color);
+        i += run;
+    }
+}
+
+// a 32-bit TGA, uncompressed or run-length encoded (packets of at most 128 pixels)
+static std::string MakeTarga(int side, const std::vector<unsigned>& pixels, bool rle)
+{
+    unsigned char hdr[18] = { 0 };
+    hdr[2] = rle ? 10 : 2;
+    hdr[12] = (unsigned char)(side & 0xff);
+    hdr[13] = (unsigned char)(side >> 8);
+    hdr[14] = (unsigned char)(side & 0xff);
+    hdr[15] = (unsigned char)(side >> 8);
+    hdr[16] = 32;
+    hdr[17] = 8;    // alpha bits
+
+    std::string tga(reinterpret_cast<const char*>(hdr), sizeof(hdr));
+    const char* data = reinterpret_cast<const char*>(&pixels[0]);
+
+    if (!rle) {
+        tga.append(data, 4 * pixels.size());
+        return tga;
+    }
+
+    size_t n = pixels.size();
+    for (size_t i = 0; i < n; ) {
+        size_t run = 1;
+        while (i + run < n && run < 128 && pixels[i + run] == pixels[i])
+            ++run;
+
+        if (run > 1) {
+            tga += (char)(0x80 | (run - 1));
+            tga.append(data + 4 * i, 4);
+        } else {
+            // raw packet up to the next run
+            size_t count = 1;
+            while (i + count < n && count < 128 && (i + count + 1 >= n || pixels[i + count + 1] != pixels[i + count]))
+                ++count;
+            tga += (char)(count - 1);
+            tga.append(data + 4 * i, 4 * count);
+            run = count;
+        }
+        i += run;
+    }
+    return tga;
+}
+
+// boxes on a grid through the origin, with a bit of rotation so the world bounds differ from the local ones
+static void MakeBoxEntities(int count, std::vector<Entity>& entities)
+{
+    int side = (int)std::ceil(std::sqrt((float)count));
+    entities.clear();
+    for (int i = 0; i < count; i++) {
+        glm::vec3 pos(3.0f * (i % side - 0.5f * side), 0.5f * (i % 5), 3.0f * (i / side - 0.5f * side));
+        glm::quat rot = glm::angleAxis(0.1f * i, glm::vec3(0.0f, 1.0f, 0.0f));
+        entities.push_back(Entity(NULL, NULL, Transform(pos, rot), glm::vec3(-1, -1, -1), glm::vec3(1, 1, 1)));
+    }
+}
+
+// a ray along +z through the first row of boxes
+static void GetBenchRay(glm::vec3& org, glm::vec3& dir)
+{
+    org = glm::vec3(0.3f, 0.2f, -1000.0f);
+    dir = glm::vec3(0.001f, 0.0005f, 1.0f);
+}
+
+//
+// The benchmarks
+//
+
+static void BenchTokenize(MicroBenchState& state)
+{
+    std::mt19937 rng(1);
+    std::string line = MakeTokenLine(state.getSize(), rng);
+
+    size_t numTokens = 0;
+    while (state.keepRunning())
+        numTokens += Tokenize(line).size();
+    sSink = (double)numTokens;
+
+    state.setBytesProcessed((double)line.size());
+    state.setItemsProcessed(state.getSize());
+}
+
+static void BenchFromStringFloat(MicroBenchState& state)
+{
+    std::mt19937 rng(1);
+    std::vector<std::string> tokens = Tokenize(MakeTokenLine(state.getSize() + 1, rng));
+    tokens.erase(tokens.begin());
+
+    size_t bytes = 0;
+    for (unsigned i = 0; i < tokens.size(); i++)
+        bytes += tokens[i].size();
+
+    double sum = 0;
+    while (state.keepRunning()) {
+        for (unsigned i = 0; i < tokens.size(); i++)
+            sum += FromString<float>(tokens[i]);
+    }
+    sSink = sum;
+
+    state.setBytesProcessed((double)bytes);
+    state.setItemsProcessed((double)tokens.size());
+}
+
+static void BenchFromStringInt(MicroBenchState& state)
+{
+    std::vector<std::string> tokens;
+    size_t bytes = 0;
+    for (int i = 0; i < state.getSize(); i++) {
+        tokens.push_back(ToString(1 + i * 37 % 100000));
+        bytes += tokens.back().size();
+    }
+
+    long long sum = 0;
+    while (state.keepRunning()) {
+        for (unsigned i = 0; i < tokens.size(); i++)
+            sum += FromString<int>(tokens[i]);
+    }
+    sSink = (double)sum;
+
+    state.setBytesProcessed((double)bytes);
+    state.setItemsProcessed((double)tokens.size());
+}
+
+static void BenchReadTextFile(MicroBenchState& state)
+{
+    // size in KiB of OBJ text
+    std::string text = MakeGridObj(64);
+    std::string contents;
+    while (contents.size() < 1024u * state.getSize())
+        contents += text;
+    contents.resize(1024u * state.getSize());
+
+    const char* path = "microbench-text.tmp";
+    if (!WriteFile(path, contents)) {
+        state.skip("can't write the input file");
+        return;
+    }
+
+    size_t length = 0;
+    while (state.keepRunning())
+        length += ReadTextFile(path).size();
+    sSink = (double)length;
+
+    std::remove(path);
+    state.setBytesProcessed((double)contents.size());
+}
+
+static void BenchLoadMesh(MicroBenchState& state)
+{
+    // size in triangles
+    if (!glGetString(GL_VERSION)) {
+        state.skip("no GL context");
+        return;
+    }
+
+    int side = (int)std::sqrt(state.getSize() / 2.0f);
+    std::string obj = MakeGridObj(side);
+
+    const char* path = "microbench-mesh.tmp";
+    if (!WriteFile(path, obj)) {
+        state.skip("can't write the input file");
+        return;
+    }
+
+    // LoadMesh reports every load
+    std::streambuf* coutBuf = std::cout.rdbuf(NULL);
+
+    unsigned numVertices = 0;
+    while (state.keepRunning()) {
+        Mesh* mesh = LoadMesh(path);
+        if (mesh)
+            numVertices += mesh->mNumVertices;
+        delete mesh;
+    }
+    sSink = numVertices;
+
+    std::cout.rdbuf(coutBuf);
+    std::remove(path);
+
+    state.setBytesProcessed((double)obj.size());
+    state.setItemsProcessed(2.0 * side * side);
+}
+
+static void BenchLoadTarga(MicroBenchState& state, bool rle)
+{
+    // size is the width and height in pixels
+    int side = state.getSize();
+    std::vector<unsigned> pixels;
+    MakeRunPixels(side, pixels);
+
+    const char* path = rle ? "microbench-rle.tmp" : "microbench-raw.tmp";
+    if (!WriteFile(path, MakeTarga(side, pixels, rle))) {
+        state.skip("can't write the input file");
+        return;
+    }
+
+    int loaded = 0;
+    while (state.keepRunning()) {
+        Image img;
+        loaded += img.LoadTarga(path);
+    }
+    sSink = loaded;
+
+    std::remove(path);
+
+    // decoded bytes, so raw and RLE compare directly
+    state.setBytesProcessed(4.0 * pixels.size());
+}
+
+static void BenchLoadTargaRaw(MicroBenchState& state)
+{
+    BenchLoadTarga(state, false);
+}
+
+static void BenchLoadTargaRLE(MicroBenchState& state)
+{
+    BenchLoadTarga(state, true);
+}
+
+// the RLE textures the scene loads, by width
+static void BenchLoadTargaTextures(MicroBenchState& state)
+{
+    const char* path;
+    switch (state.getSize()) {
+    case 256:   path = "textures/rocky.tga";                    break;
+    case 512:   path = "textures/water_drops_on_metal.tga";     break;
+    default:    path = "textures/skin.tga";                     break;
+    }
+
+    Image img;
+    if (!img.LoadTarga(path)) {
+        state.skip(std::string("can't load ") + path + " (run from the project directory)");
+        return;
+    }
+
+    int loaded = 0;
+    while (state.keepRunning()) {
+        Image img;
+        loaded += img.LoadTarga(path);
+    }
+    sSink = loaded;
+
+    state.setBytesProcessed((double)img.getWidth() * img.getHeight() * img.getBytesPerPixel());
+}
+
+static void BenchToMatrix(MicroBenchState& state)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    std::vector<Transform> transforms;
+    for (int i = 0; i < state.getSize(); i++) {
+        glm::vec3 axis = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(0.0f, 2.0f, 0.0f));
+        glm::quat rot = glm::angleAxis(PI * unit(rng), axis);
+        transforms.push_back(Transform(glm::vec3(10 * unit(rng), 10 * unit(rng), 10 * unit(rng)), rot));
+    }
+
+    float sum = 0;
+    while (state.keepRunning()) {
+        for (unsigned i = 0; i < transforms.size(); i++) {
+            glm::mat4 m = transforms[i].toMatrix();
+            sum += m[0][0] + m[3][2];
+        }
+    }
+    sSink = sum;
+
+    state.setItemsProcessed(state.getSize());
+}
+
+static void BenchIntersectRayAABB(MicroBenchState& state)
+{
+    std::vector<Entity> entities;
+    MakeBoxEntities(state.getSize(), entities);
+
+    glm::vec3 org, dir;
+    GetBenchRay(org, dir);
+
+    int hits = 0;
+    while (state.keepRunning()) {
+        for (unsigned i = 0; i < entities.size(); i++) {
+            float tmin;
+            glm::vec3 q;
+            hits += BasicSceneRenderer::IntersectRayAABB(org, dir, &entities[i], tmin, q);
+        }
+    }
+    sSink = hits;
+
+    state.setItemsProcessed(state.getSize());
+}
+
+static void BenchIntersect(MicroBenchState& state)
+{
+    std::vector<Entity> entities;
+    MakeBoxEntities(state.getSize(), entities);
+
+    glm::vec3 org, dir;
+    GetBenchRay(org, dir);
+
+    int hits = 0;
+    while (state.keepRunning()) {
+        for (unsigned i = 0; i < entities.size(); i++)
+            hits += BasicSceneRenderer::intersect(&entities[i], org, dir);
+    }
+    sSink = hits;
+
+    state.setItemsProcessed(state.getSize());
+}
+
+static void BenchArrowIntersecting(MicroBenchState& state)
+{
+    std::vector<Entity> entities;
+    MakeBoxEntities(state.getSize(), entities);
+
+    std::vector<Bounds> boxes;
+    for (unsigned i = 0; i < entities.size(); i++)
+        boxes.push_back(entities[i].getWorldBounds());
+
+    // the arrow's box runs from its tail to its tip along the ray
+    glm::vec3 org, dir;
+    GetBenchRay(org, dir);
+    Arrow arrow(NULL, NULL, Transform(org), glm::vec3(0, 0, 0), dir);
+
+    int hits = 0;
+    while (state.keepRunning()) {
+        for (unsigned i = 0; i < boxes.size(); i++)
+            hits += arrow.isIntersecting(boxes[i]);
+    }
+    sSink = hits;
+
+    state.setItemsProcessed(state.getSize());
+}
+
+static void BenchComputeWorldBounds(MicroBenchState& state)
+{
+    std::vector<Entity> entities;
+    MakeBoxEntities(state.getSize(), entities);
+
+    std::vector<Entity*> pointers;
+    for (unsigned i = 0; i < entities.size(); i++)
+        pointers.push_back(&entities[i]);
+
+    std::vector<Bounds> bounds;
+    float sum = 0;
+    while (state.keepRunning()) {
+        ComputeWorldBounds(pointers, bounds);
+        sum += bounds.back().max.x;
+    }
+    sSink = sum;
+
+    state.setItemsProcessed(state.getSize());
+}
+
+static void BenchCreateBoundingBox(MicroBenchState& state)
+{
+    // a few meshes with different bounds, shared like the scene shares them
+    Mesh meshes[4];
+    for (int i = 0; i < 4; i++) {
+        meshes[i].mBoundsMin = glm::vec3(-1.0f - i, -0.5f, -1.0f);
+        meshes[i].mBoundsMax = glm::vec3(1.0f, 0.5f + i, 1.0f + 0.5f * i);
+    }
+
+    std::vector<Entity> entities;
+    for (int i = 0; i < state.getSize(); i++)
+        entities.push_back(Entity(&meshes[i % 4], NULL, Transform((float)i, 0.0f, 0.0f)));
+
+    float sum = 0;
+    while (state.keepRunning()) {
+        for (unsigned i = 0; i < entities.size(); i++) {
+            entities[i].createBoundingBox();
+            sum += entities[i].mMax.y;
+        }
+    }
+    sSink = sum;
+
+    state.setItemsProcessed(state.getSize());
+}
+
+//
+// Registry: the name, the function and the input sizes it runs with
+//
+struct MicroBenchmark {
+    const char*     name;
+    MicroBenchFunc  func;
+    int             sizes[3];
+};
+
+static const MicroBenchmark sBenchmarks[] = {
+    { "Tokenize",                   BenchTokenize,              { 4, 64, 1024 } },      // tokens per line
+    { "FromString<float>",          BenchFromStringFloat,       { 64, 1024, 16384 } },  // numbers
+    { "FromString<int>",            BenchFromStringInt,         { 64, 1024, 16384 } },  // numbers
+    { "ReadTextFile",               BenchReadTextFile,          { 4, 64, 1024 } },      // KiB
+    { "LoadMesh",                   BenchLoadMesh,              { 512, 8192, 131072 } },// triangles
+    { "Image::LoadTarga/raw",       BenchLoadTargaRaw,          { 64, 256, 1024 } },    // pixels across
+    { "Image::LoadTarga/rle",       BenchLoadTargaRLE,          { 64, 256, 1024 } },    // pixels across
+    { "Image::LoadTarga/textures",  BenchLoadTargaTextures,     { 256, 512, 1024 } },   // pixels across
+    { "Transform::toMatrix",        BenchToMatrix,              { 64, 1024, 16384 } },  // transforms
+    { "IntersectRayAABB",           BenchIntersectRayAABB,      { 64, 1024, 16384 } },  // boxes
+    { "intersect",                  BenchIntersect,             { 64, 1024, 16384 } },  // boxes
+    { "Arrow::isIntersecting",      BenchArrowIntersecting,     { 64, 1024, 16384 } },  // boxes
+    { "ComputeWorldBounds",         BenchComputeWorldBounds,    { 64, 1024, 16384 } },  // entities
+    { "Entity::createBoundingBox",  BenchCreateBoundingBox,     { 64, 1024, 16384 } },  // entities
+};
+
+MicroBenchmarks::MicroBenchmarks(const std::string& filter, double minSeconds)
+    : mFilter(filter)
+    , mMinSeconds(minSeconds)
+    , mNumRun(0)
+{
+}
+
+void MicroBenchmarks::initialize()
+{
+    std::cout << std::left << std::setw(40) << "Benchmark" << std::right << std::setw(16) << "Time"
+              << std::setw(14) << "Iterations" << "  Throughput" << std::endl;
+    std::cout << std::string(96, '-') << std::endl;
+
+    for (unsigned i = 0; i < sizeof(sBenchmarks) / sizeof(sBenchmarks[0]); i++) {
+        const MicroBenchmark& bench = sBenchmarks[i];
+        if (!mFilter.empty() && std::string(bench.name).find(mFilter) == std::string::npos)
+            continue;
+
+        for (int s = 0; s < 3; s++)
+            run(bench.name, bench.func, bench.sizes[s]);
+    }
+
+    if (mNumRun == 0)
+        std::cerr << "*** No benchmark matches '" << mFilter << "'" << std::endl;
+}
+
+static std::string FormatRate(double perSecond, const char* unit)
+{
+    static const char* prefixes[] = { "", "k", "M", "G" };
+    int p = 0;
+    while (perSecond >= 1000 && p < 3) {
+        perSecond /= 1000;
+        ++p;
+    }
+
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(perSecond < 10 ? 2 : 1) << perSecond << " " << prefixes[p] << unit;
+    return ss.str();
+}
+
+void MicroBenchmarks::run(const char* name, MicroBenchFunc func, int size)
+{
+    std::ostringstream label;
+    label << name << "/" << size;
+
+    // keep growing the iteration count until a run takes long enough to time reliably
+    long long iterations = 1;
+    for (;;) {
+        MicroBenchState state(size, iterations);
+        func(state);
+
+        if (state.isSkipped()) {
+            std::cout << std::left << std::setw(40) << label.str() << std::right << "  skipped: " << state.getSkipReason() << std::endl;
+            return;
+        }
+
+        double seconds = state.getSeconds();
+        if (seconds < mMinSeconds && iterations < MAX_ITERATIONS) {
+            // aim a bit past the minimum, growing by at most 10x per attempt
+            double scale = seconds > 0 ? 1.4 * mMinSeconds / seconds : 10;
+            scale = std::min(std::max(scale, 1.5), 10.0);
+            iterations = std::min(std::max((long long)(iterations * scale), iterations + 1), MAX_ITERATIONS);
+            continue;
+        }
+
+        double nanos = 1e9 * seconds / iterations;
+        std::ostringstream time;
+        time << std::fixed << std::setprecision(nanos < 100 ? 2 : 0) << nanos << " ns";
+
+        std::cout << std::left << std::setw(40) << label.str() << std::right << std::setw(16) << time.str()
+                  << std::setw(14) << iterations;
+        if (state.getBytesProcessed() > 0)
+            std::cout << "  " << FormatRate(state.getBytesProcessed() * iterations / seconds, "B/s");
+        if (state.getItemsProcessed() > 0)
+            std::cout << "  " << FormatRate(state.getItemsProcessed() * iterations / seconds, "items/s");
+        std::cout << std::endl;
+
+        ++mNumRun;
+        return;
+    }
+}
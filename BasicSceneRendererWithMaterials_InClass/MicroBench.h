@@ -0,0 +1,86 @@
+#ifndef MICROBENCH_H_
+#define MICROBENCH_H_
+
+#include "glshell.h"
+
+#include <chrono>
+#include <string>
+
+//
+// Handed to a micro-benchmark: the input size to build and how many iterations to time.
+//
+// A benchmark sets up its input first, then runs the code under test in a
+// `while (state.keepRunning())` loop; only that loop is timed. Giving the bytes or items
+// handled per iteration adds a throughput column to the report.
+//
+class MicroBenchState {
+public:
+                    MicroBenchState(int size, long long iterations);
+
+    int             getSize() const                 { return mSize; }
+    long long       getIterations() const           { return mIterations; }
+
+    // starts the clock on the first call, stops it when the iterations are used up
+    bool            keepRunning();
+
+    void            setBytesProcessed(double bytes) { mBytes = bytes; }    // per iteration
+    void            setItemsProcessed(double items) { mItems = items; }    // per iteration
+
+    // give up on this size (no GL context, setup failed); nothing is timed
+    void            skip(const std::string& reason) { mSkipReason = reason; }
+
+    const std::string&  getSkipReason() const       { return mSkipReason; }
+    bool            isSkipped() const               { return !mSkipReason.empty(); }
+
+    double          getSeconds() const              { return mSeconds; }
+    double          getBytesProcessed() const       { return mBytes; }
+    double          getItemsProcessed() const       { return mItems; }
+
+private:
+    int             mSize;
+    long long       mIterations;
+    long long       mRemaining;
+    bool            mStarted;
+
+    std::chrono::high_resolution_clock::time_point  mStart;
+    double          mSeconds;
+
+    double          mBytes;
+    double          mItems;
+    std::string     mSkipReason;
+};
+
+typedef void (*MicroBenchFunc)(MicroBenchState& state);
+
+//
+// Micro-benchmarks of the CPU hot paths: text and number parsing, mesh, image and text file
+// loading, transform matrices, the ray/box slab tests and entity bounding boxes.
+//
+// Works like Google Benchmark: every benchmark runs on synthetic inputs of a few sizes, each
+// size is repeated with more iterations until it has run for at least the minimum time, and
+// the time per iteration is reported along with the throughput in bytes or items per second.
+// Input files are written to the working directory and removed afterwards.
+//
+// Runs as an app so that LoadMesh has a GL context to upload into (see GLShell::RunHeadless).
+// Everything happens in initialize; no frames are drawn.
+//
+class MicroBenchmarks : public GLApp {
+public:
+    // run the benchmarks whose names contain 'filter' (all of them if it's empty)
+                    MicroBenchmarks(const std::string& filter, double minSeconds);
+
+    void            initialize();
+    bool            update(float)                   { return false; }
+
+    // number of benchmark sizes run so far
+    int             getNumRun() const               { return mNumRun; }
+
+private:
+    void            run(const char* name, MicroBenchFunc func, int size);
+
+    std::string     mFilter;
+    double          mMinSeconds;
+    int             mNumRun;
+};
+
+#endif
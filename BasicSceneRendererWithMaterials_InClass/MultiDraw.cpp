@@ -0,0 +1,143 @@
+#include "MultiDraw.h"
+#include "common.h"  // ToString(), GetEnv()
+
+#include <algorithm>
+
+bool MultiDraw::IsSupported()
+{
+    // SCENE_NO_MULTIDRAW=1 tests the fallback on drivers that have both extensions
+    static const bool disabled = !GetEnv("SCENE_NO_MULTIDRAW").empty();
+    return !disabled && GLEW_ARB_multi_draw_indirect && GLEW_ARB_shader_draw_parameters;
+}
+
+std::string MultiDraw::GetDefines()
+{
+    return "#define MULTI_DRAW " + ToString((int)MAX_DRAWS_PER_CALL) + "\n";
+}
+
+MultiDraw::MultiDraw()
+    : mRecordSize(0)
+    , mIndirectBuffer(0)
+    , mNumDraws(0)
+{
+}
+
+MultiDraw::~MultiDraw()
+{
+    destroy();
+}
+
+void MultiDraw::destroy()
+{
+    mBuckets.clear();
+    mCommands.clear();
+    mNumDraws = 0;
+
+    if (mIndirectBuffer) {
+        glDeleteBuffers(1, &mIndirectBuffer);
+        mIndirectBuffer = 0;
+    }
+}
+
+void MultiDraw::clear()
+{
+    mBuckets.clear();
+    mNumDraws = 0;
+}
+
+void MultiDraw::queue(const Mesh* mesh, const Material* mat, const void* record)
+{
+    const void* texture = mat->texArray ? (const void*)mat->texArray : (const void*)mat->tex;
+
+    // there are only a handful of buckets, a linear search is fine
+    unsigned b = 0;
+    while (b < mBuckets.size() &&
+           (mBuckets[b].mesh->mVBO != mesh->mVBO || mBuckets[b].mesh->mFormat != mesh->mFormat ||
+            mBuckets[b].mode != mesh->mMode || mBuckets[b].texture != texture))
+        ++b;
+
+    if (b == mBuckets.size()) {
+        Bucket bucket;
+        bucket.mesh = mesh;
+        bucket.mode = mesh->mMode;
+        bucket.texture = texture;
+        bucket.material = mat;
+        bucket.commandOffset = 0;
+        mBuckets.push_back(bucket);
+    }
+
+    Bucket& bucket = mBuckets[b];
+
+    Command cmd;
+    cmd.count = mesh->mNumVertices;
+    cmd.instanceCount = 1;
+    cmd.first = mesh->mFirstVertex;
+    cmd.baseInstance = 0;
+    bucket.commands.push_back(cmd);
+
+    const char* bytes = (const char*)record;
+    bucket.records.insert(bucket.records.end(), bytes, bytes + mRecordSize);
+
+    ++mNumDraws;
+}
+
+void MultiDraw::upload()
+{
+    mCommands.clear();
+
+    for (unsigned b = 0; b < mBuckets.size(); b++) {
+        Bucket& bucket = mBuckets[b];
+        bucket.commandOffset = mCommands.size() * sizeof(Command);
+        mCommands.insert(mCommands.end(), bucket.commands.begin(), bucket.commands.end());
+
+        // every chunk pushes a whole array of records to the ring
+        unsigned numChunks = (bucket.commands.size() + MAX_DRAWS_PER_CALL - 1) / MAX_DRAWS_PER_CALL;
+        bucket.records.resize(numChunks * MAX_DRAWS_PER_CALL * mRecordSize);
+    }
+
+    if (mCommands.empty())
+        return;
+
+    if (!mIndirectBuffer)
+        glGenBuffers(1, &mIndirectBuffer);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mIndirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, mCommands.size() * sizeof(Command), &mCommands[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void MultiDraw::drawBucket(unsigned b, UniformRing& records) const
+{
+    const Bucket& bucket = mBuckets[b];
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mIndirectBuffer);
+
+    for (unsigned start = 0; start < bucket.commands.size(); start += MAX_DRAWS_PER_CALL) {
+        GLsizei count = std::min<GLsizei>(bucket.commands.size() - start, MAX_DRAWS_PER_CALL);
+
+        if (!records.push(&bucket.records[start * mRecordSize]))
+            break;
+
+        glMultiDrawArraysIndirect(bucket.mode, (const GLvoid*)(bucket.commandOffset + start * sizeof(Command)), count, 0);
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+unsigned MultiDraw::getNumCalls() const
+{
+    unsigned numCalls = 0;
+    for (unsigned b = 0; b < mBuckets.size(); b++)
+        numCalls += (mBuckets[b].commands.size() + MAX_DRAWS_PER_CALL - 1) / MAX_DRAWS_PER_CALL;
+    return numCalls;
+}
+
+unsigned MultiDraw::getNumTriangles() const
+{
+    unsigned numTriangles = 0;
+    for (unsigned b = 0; b < mBuckets.size(); b++) {
+        for (unsigned i = 0; i < mBuckets[b].commands.size(); i++)
+            numTriangles += CountTriangles(mBuckets[b].mode, mBuckets[b].commands[i].count);
+    }
+    return numTriangles;
+}
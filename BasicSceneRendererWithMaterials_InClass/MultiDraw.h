@@ -0,0 +1,93 @@
+#ifndef MULTI_DRAW_H_
+#define MULTI_DRAW_H_
+
+#include "Mesh.h"
+#include "Material.h"
+#include "UniformRing.h"
+
+#include <string>
+#include <vector>
+
+//
+// Submits many meshes with one glMultiDrawArraysIndirect call per bucket of similar draws.
+//
+// Meshes keep their vertices in the few large buffers of the geometry heap, so most of them can
+// be drawn from the same buffer. Each frame, draws are queued together with the per-draw record
+// the shaders would otherwise read from the PerDraw block. Draws that share a vertex buffer,
+// vertex format, drawing mode and texture go into the same bucket, and each bucket is drawn with
+// indirect commands in chunks of
+// up to MAX_DRAWS_PER_CALL. The records of a chunk are pushed to a UniformRing as one array, and
+// the shaders pick their record with gl_DrawIDARB (compile them with GetDefines()).
+//
+class MultiDraw {
+public:
+    // draws per indirect call, limited by the size of the PerDraw array in the shaders
+    static const int    MAX_DRAWS_PER_CALL = 64;
+
+    // needs ARB_multi_draw_indirect and ARB_shader_draw_parameters; always false if the
+    // SCENE_NO_MULTIDRAW environment variable is set
+    static bool         IsSupported();
+
+    // defines that make the material shaders read the PerDraw block as an array
+    static std::string  GetDefines();
+
+    MultiDraw();
+    ~MultiDraw();
+
+    // size of each per-draw record (the ring passed to drawBucket holds MAX_DRAWS_PER_CALL of them)
+    void                setRecordSize(GLsizeiptr recordSize)  { mRecordSize = recordSize; }
+
+    void                destroy();
+
+    //
+    // per frame: clear, queue the draws, upload, then bind the mesh and material texture of
+    // each bucket and draw it
+    //
+    void                clear();
+
+    void                queue(const Mesh* mesh, const Material* mat, const void* record);
+
+    // upload the commands of all buckets
+    void                upload();
+
+    unsigned            getNumBuckets() const                   { return mBuckets.size(); }
+    const Mesh*         getBucketMesh(unsigned b) const         { return mBuckets[b].mesh; }
+    const Material*     getBucketMaterial(unsigned b) const     { return mBuckets[b].material; }
+
+    void                drawBucket(unsigned b, UniformRing& records) const;
+
+    unsigned            getNumDraws() const                     { return mNumDraws; }
+    unsigned            getNumCalls() const;
+    unsigned            getNumTriangles() const;
+
+private:
+                        MultiDraw(const MultiDraw&);
+    MultiDraw&          operator=(const MultiDraw&);
+
+    // layout of the commands read by glMultiDrawArraysIndirect
+    struct Command {
+        GLuint          count;
+        GLuint          instanceCount;
+        GLuint          first;
+        GLuint          baseInstance;
+    };
+
+    struct Bucket {
+        const Mesh*             mesh;           // first mesh queued, used to bind the vertex buffer
+        GLenum                  mode;
+        const void*             texture;        // texture array or texture of the materials
+        const Material*         material;       // first material queued, used to bind the texture
+        std::vector<Command>    commands;
+        std::vector<char>       records;
+        GLintptr                commandOffset;  // in the indirect buffer
+    };
+
+    GLsizeiptr                          mRecordSize;
+
+    std::vector<Bucket>                 mBuckets;
+    std::vector<Command>                mCommands;      // all buckets, as uploaded
+    GLuint                              mIndirectBuffer;
+    unsigned                            mNumDraws;
+};
+
+#endif
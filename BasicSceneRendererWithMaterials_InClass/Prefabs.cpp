@@ -193,54 +193,6 @@ Mesh* CreateWireframeBox(float width, float height, float depth)
     return mesh;
 }
 
-Mesh* CreateWireframeBox2(float width, float height, float depth)
-{
-	std::vector<VertexPC> vertices;
-
-	float w = 0.5f * width;
-	float h = 0.5f * height;
-	float d = 0.5f * depth;
-
-	// sides
-	vertices.push_back(VertexPC(-w, -h, -d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(-w, h, -d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(-w, -h, d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(-w, h, d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(w, -h, -d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(w, h, -d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(w, -h, d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(w, h, d, 1.0, 0, 0, 1.0f));
-
-	// top
-	vertices.push_back(VertexPC(-w, h, -d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(w, h, -d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(-w, h, d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(w, h, d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(-w, h, -d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(-w, h, d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(w, h, -d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(w, h, d, 1.0, 0, 0, 1.0f));
-
-	// bottom
-	vertices.push_back(VertexPC(-w, -h, -d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(w, -h, -d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(-w, -h, d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(w, -h, d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(-w, -h, -d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(-w, -h, d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(w, -h, -d, 1.0, 0, 0, 1.0f));
-	vertices.push_back(VertexPC(w, -h, d, 1.0, 0, 0, 1.0f));
-
-	Mesh* mesh = new Mesh;
-	mesh->loadFromData(&vertices[0],               // address of data in memory
-		vertices.size(),            // number of vertices
-		sizeof(vertices[0]),        // size of each vertex
-		GL_LINES,                   // drawing mode
-		vertices[0].getFormat());   // vertex format
-
-	return mesh;
-}
-
 Mesh* CreateSolidCube_Nolight(float width)
 {
     return CreateSolidBox_Nolight(width, width, width);
@@ -257,6 +209,51 @@ Mesh* CreateWireframeCube(float width)
 }
 
 
+Mesh* CreateSolidSphere_Nolight(float radius, int numSlices, int numStacks)
+{
+    std::vector<VertexPosition> vertices;
+
+    float sliceStep = 2 * 3.14159f / numSlices;
+    float stackStep = 3.14159f / numStacks;
+
+    for (int i = 0; i < numStacks; i++) {
+        // height and ring radius at the top and bottom of this stack
+        float y1 = radius * std::cos(i * stackStep);
+        float r1 = radius * std::sin(i * stackStep);
+        float y2 = radius * std::cos((i + 1) * stackStep);
+        float r2 = radius * std::sin((i + 1) * stackStep);
+
+        for (int j = 0; j < numSlices; j++) {
+            float angle1 = j * sliceStep;
+            float angle2 = (j + 1) * sliceStep;
+
+            VertexPosition a(r1 * std::cos(angle1), y1, r1 * std::sin(angle1));
+            VertexPosition b(r1 * std::cos(angle2), y1, r1 * std::sin(angle2));
+            VertexPosition c(r2 * std::cos(angle1), y2, r2 * std::sin(angle1));
+            VertexPosition d(r2 * std::cos(angle2), y2, r2 * std::sin(angle2));
+
+            // counter-clockwise when seen from outside
+            vertices.push_back(a);
+            vertices.push_back(b);
+            vertices.push_back(d);
+
+            vertices.push_back(a);
+            vertices.push_back(d);
+            vertices.push_back(c);
+        }
+    }
+
+    Mesh* mesh = new Mesh;
+    mesh->loadFromData(&vertices[0],               // address of data in memory
+                       vertices.size(),            // number of vertices
+                       sizeof(vertices[0]),        // size of each vertex
+                       GL_TRIANGLES,               // drawing mode
+                       vertices[0].getFormat());   // vertex format
+
+    return mesh;
+}
+
+
 Mesh* CreateSmoothCylinder(float radius, float height, int numSegments)
 {
     std::vector<VertexPositionNormal> vertices;
@@ -727,4 +724,4 @@ Mesh* CreateLine(glm::vec3 start, glm::vec3 end)
 		vertices[0].getFormat());   // vertex format
 
 	return mesh;
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -6,12 +6,13 @@
 Mesh*   CreateSolidBox_Nolight      (float width, float height, float depth);  // positions only
 Mesh*   CreateSolidBox              (float width, float height, float depth);  // positions and normals
 Mesh*   CreateWireframeBox          (float width, float height, float depth);  // positions only
-Mesh*   CreateWireframeBox2			(float width, float height, float depth);  // positions only
 
 Mesh*   CreateSolidCube_Nolight     (float width);  // positions only
 Mesh*   CreateSolidCube             (float width);  // positions and normals
 Mesh*   CreateWireframeCube         (float width);  // positions only
 
+Mesh*   CreateSolidSphere_Nolight   (float radius, int numSlices, int numStacks);  // positions only
+
 Mesh*   CreateChunkyCylinder        (float radius, float height, int numSegments);  // positions and per-face normals
 Mesh*   CreateSmoothCylinder        (float radius, float height, int numSegments);  // positions and per-vertex normals
 
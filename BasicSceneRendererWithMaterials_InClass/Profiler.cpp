@@ -0,0 +1,250 @@
+#include "Profiler.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+struct Profiler::ThreadBuffer {
+    Event                   events[EVENTS_PER_THREAD];
+    std::atomic<unsigned>   count;      // events recorded in this capture; only the owner adds to it
+    unsigned                thread;     // id of the thread using it (1 for the first one)
+};
+
+// hands the thread's buffer back when it exits
+struct Profiler::ThreadSlot {
+    ThreadBuffer*           buffer;
+
+    ThreadSlot()
+        : buffer(NULL)
+    { }
+
+    ~ThreadSlot()
+    {
+        if (buffer)
+            ReleaseBuffer(buffer);
+    }
+};
+
+struct Profiler::Registry {
+    std::mutex                  mutex;
+    std::vector<ThreadBuffer*>  buffers;        // kept until exit, events outlive their threads
+    std::vector<ThreadBuffer*>  freeBuffers;
+    unsigned                    numThreads;
+
+    // ticks and time at the start and end of the capture, to convert ticks to microseconds
+    unsigned long long                      startTicks;
+    unsigned long long                      endTicks;
+    std::chrono::steady_clock::time_point   startTime;
+    std::chrono::steady_clock::time_point   endTime;
+
+    Registry()
+        : numThreads(0), startTicks(0), endTicks(0)
+    { }
+
+    // at exit, after the thread_local slots have handed their buffers back
+    ~Registry()
+    {
+        for (unsigned i = 0; i < buffers.size(); i++)
+            delete buffers[i];
+    }
+};
+
+std::atomic<bool> Profiler::smCapturing(false);
+
+Profiler::Registry& Profiler::GetRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+Profiler::ThreadBuffer* Profiler::AcquireBuffer()
+{
+    Registry& reg = GetRegistry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    // a recycled buffer keeps the events of its last thread, which are tagged with their own id
+    ThreadBuffer* buffer;
+    if (!reg.freeBuffers.empty()) {
+        buffer = reg.freeBuffers.back();
+        reg.freeBuffers.pop_back();
+    } else {
+        buffer = new ThreadBuffer;
+        buffer->count.store(0);
+        reg.buffers.push_back(buffer);
+    }
+
+    buffer->thread = ++reg.numThreads;
+    return buffer;
+}
+
+void Profiler::ReleaseBuffer(ThreadBuffer* buffer)
+{
+    Registry& reg = GetRegistry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.freeBuffers.push_back(buffer);
+}
+
+void Profiler::ClearBuffers()
+{
+    Registry& reg = GetRegistry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (unsigned i = 0; i < reg.buffers.size(); i++)
+        reg.buffers[i]->count.store(0);
+}
+
+void Profiler::Record(const char* name, unsigned long long start, unsigned long long end)
+{
+    // the capture may have ended inside the zone
+    if (IsCapturing())
+        Append(name, start, end, false);
+}
+
+void Profiler::RecordGpu(const char* name, long long startNanos, long long endNanos)
+{
+    if (IsCapturing())
+        Append(name, startNanos, endNanos, true);
+}
+
+void Profiler::Append(const char* name, unsigned long long start, unsigned long long end, bool gpu)
+{
+    // a plain pointer is cheaper to reach than the slot, which is only there to clean up
+    static thread_local ThreadBuffer* buffer = NULL;
+    if (!buffer) {
+        static thread_local ThreadSlot slot;
+        slot.buffer = buffer = AcquireBuffer();
+    }
+
+    unsigned n = buffer->count.load(std::memory_order_relaxed);
+
+    Event& e = buffer->events[n % EVENTS_PER_THREAD];
+    e.name = name;
+    e.start = start;
+    e.end = end;
+    e.thread = gpu ? GPU_TRACK : buffer->thread;
+
+    // publish the event to WriteChromeTrace
+    buffer->count.store(n + 1, std::memory_order_release);
+}
+
+void Profiler::BeginCapture()
+{
+    ClearBuffers();
+
+    Registry& reg = GetRegistry();
+    reg.startTime = std::chrono::steady_clock::now();
+    reg.startTicks = Now();
+    reg.endTicks = 0;
+
+    smCapturing.store(true);
+}
+
+void Profiler::EndCapture()
+{
+    if (!IsCapturing())
+        return;
+
+    smCapturing.store(false);
+
+    Registry& reg = GetRegistry();
+    reg.endTicks = Now();
+    reg.endTime = std::chrono::steady_clock::now();
+}
+
+unsigned Profiler::GetNumEvents()
+{
+    Registry& reg = GetRegistry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    unsigned numEvents = 0;
+    for (unsigned i = 0; i < reg.buffers.size(); i++)
+        numEvents += reg.buffers[i]->count.load(std::memory_order_acquire);
+    return numEvents;
+}
+
+bool Profiler::WriteChromeTrace(const std::string& path)
+{
+    std::ofstream file(path.c_str());
+    if (!file) {
+        std::cerr << "*** Failed to open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    Registry& reg = GetRegistry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    // ticks per microsecond over the capture (or up to now, if it is still running)
+    unsigned long long endTicks = reg.endTicks;
+    std::chrono::steady_clock::time_point endTime = reg.endTime;
+    if (IsCapturing()) {
+        endTicks = Now();
+        endTime = std::chrono::steady_clock::now();
+    }
+    std::chrono::duration<double, std::micro> captureTime = endTime - reg.startTime;
+    double ticksPerMicro = captureTime.count() > 0 ? (endTicks - reg.startTicks) / captureTime.count() : 1.0;
+
+    long long startNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(reg.startTime.time_since_epoch()).count();
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"traceEvents\":[";
+    file << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << GPU_TRACK << ",\"args\":{\"name\":\"GPU\"}}";
+
+    unsigned numWritten = 0;
+    unsigned numOverwritten = 0;
+
+    for (unsigned b = 0; b < reg.buffers.size(); b++) {
+        const ThreadBuffer* buffer = reg.buffers[b];
+        unsigned count = buffer->count.load(std::memory_order_acquire);
+        unsigned first = count > EVENTS_PER_THREAD ? count - EVENTS_PER_THREAD : 0;
+        numOverwritten += first;
+
+        for (unsigned i = first; i < count; i++) {
+            const Event& e = buffer->events[i % EVENTS_PER_THREAD];
+
+            // microseconds since the start of the capture
+            double ts, dur;
+            if (e.thread == GPU_TRACK) {
+                ts = ((long long)e.start - startNanos) / 1000.0;
+                dur = (e.end - e.start) / 1000.0;
+            } else {
+                ts = ((long long)e.start - (long long)reg.startTicks) / ticksPerMicro;
+                dur = (e.end - e.start) / ticksPerMicro;
+            }
+            if (ts < 0)
+                continue;
+
+            ++numWritten;
+            file << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"" << (e.thread == GPU_TRACK ? "gpu" : "cpu")
+                 << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread << ",\"ts\":" << ts << ",\"dur\":" << dur << "}";
+        }
+    }
+
+    file << "\n],\"displayTimeUnit\":\"ms\"}" << std::endl;
+
+    std::cout << "Wrote " << numWritten << " zones to " << path;
+    if (numOverwritten)
+        std::cout << " (" << numOverwritten << " older ones were overwritten)";
+    std::cout << std::endl;
+
+    return file.good();
+}
+
+double Profiler::MeasureZoneOverhead(bool capturing)
+{
+    const int numZones = 1000000;
+
+    bool wasCapturing = IsCapturing();
+    smCapturing.store(capturing);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < numZones; i++) {
+        PROFILE_ZONE("overhead");
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+    smCapturing.store(wasCapturing);
+    ClearBuffers();
+
+    return elapsed.count() / numZones;
+}
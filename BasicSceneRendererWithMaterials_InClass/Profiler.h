@@ -0,0 +1,128 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+// read the time stamp counter where there is one (it is invariant on the CPUs we run on)
+#if defined(_M_IX86) || defined(_M_X64)
+#  define PROFILER_USE_RDTSC
+#  include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#  define PROFILER_USE_RDTSC
+#  include <x86intrin.h>
+#endif
+
+//
+// Low-overhead CPU profiler.
+//
+// PROFILE_ZONE("name") at the top of a scope records the time spent in it while a capture is
+// running, and costs one relaxed atomic load when none is. Zone names must be string literals,
+// only the pointer is stored.
+//
+// Each thread writes its zones to a ring buffer of its own (only the owner writes, so no locks
+// are taken while recording), keeping the last EVENTS_PER_THREAD of them. Buffers are handed out
+// on a thread's first zone and recycled when it exits, so threads that come and go don't use up
+// memory. The events of a capture are written out as Chrome trace_event JSON, for
+// chrome://tracing or Perfetto.
+//
+// GPU passes measured by GpuProfiler are added with RecordGpu and show up on a track of their
+// own, on the same timeline.
+//
+// Captures are started, ended and written between frames, while no other threads record.
+//
+class Profiler {
+public:
+    static const unsigned   EVENTS_PER_THREAD = 1 << 14;
+
+    // discard earlier events and start recording
+    static void         BeginCapture();
+    static void         EndCapture();
+
+    static bool         IsCapturing()       { return smCapturing.load(std::memory_order_relaxed); }
+
+    // write the captured zones as Chrome trace_event JSON; returns false if the file can't be written
+    static bool         WriteChromeTrace(const std::string& path);
+
+    // zones in the capture (including any that were overwritten)
+    static unsigned     GetNumEvents();
+
+    // average cost of an empty zone in nanoseconds, recording or not (discards captured events)
+    static double       MeasureZoneOverhead(bool capturing);
+
+    static unsigned long long Now()
+    {
+#ifdef PROFILER_USE_RDTSC
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    // called by ProfileZone
+    static void         Record(const char* name, unsigned long long start, unsigned long long end);
+
+    // add a zone to the GPU track, with start and end in steady_clock nanoseconds since its epoch
+    static void         RecordGpu(const char* name, long long startNanos, long long endNanos);
+
+private:
+    // thread id of the GPU track, whose events are timed in steady_clock nanoseconds
+    static const unsigned   GPU_TRACK = 0;
+
+    struct Event {
+        const char*             name;
+        unsigned long long      start;
+        unsigned long long      end;
+        unsigned                thread;
+    };
+
+    static void             Append(const char* name, unsigned long long start, unsigned long long end, bool gpu);
+
+    struct ThreadBuffer;
+    struct ThreadSlot;
+    struct Registry;
+
+    // all buffers, the free ones and the capture's start and end (only touched between frames
+    // and when a thread records its first zone or exits)
+    static Registry&        GetRegistry();
+
+    static ThreadBuffer*    AcquireBuffer();
+    static void             ReleaseBuffer(ThreadBuffer* buffer);
+    static void             ClearBuffers();
+
+    static std::atomic<bool>    smCapturing;
+};
+
+
+//
+// Records the time from its construction to the end of its scope (see PROFILE_ZONE)
+//
+class ProfileZone {
+public:
+    template <size_t N>
+    explicit ProfileZone(const char (&name)[N])
+        : mName(name)
+        , mStart(Profiler::IsCapturing() ? Profiler::Now() : 0)
+    { }
+
+    ~ProfileZone()
+    {
+        if (mStart)
+            Profiler::Record(mName, mStart, Profiler::Now());
+    }
+
+private:
+                        ProfileZone(const ProfileZone&);
+    ProfileZone&        operator=(const ProfileZone&);
+
+    const char*         mName;
+    unsigned long long  mStart;     // 0 if the zone started outside a capture
+};
+
+#define PROFILE_ZONE_CONCAT2(a, b)  a ## b
+#define PROFILE_ZONE_CONCAT(a, b)   PROFILE_ZONE_CONCAT2(a, b)
+#define PROFILE_ZONE(name)          ProfileZone PROFILE_ZONE_CONCAT(profileZone_, __LINE__)(name)
+
+#endif
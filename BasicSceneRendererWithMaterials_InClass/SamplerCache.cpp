@@ -0,0 +1,60 @@
+#include "SamplerCache.h"
+
+#include <algorithm>
+
+SamplerCache::SamplerCache()
+    : mMaxAnisotropy(0)
+{
+}
+
+SamplerCache::~SamplerCache()
+{
+    clear();
+}
+
+GLuint SamplerCache::get(GLint wrapMode, GLint filteringMode, float anisotropy)
+{
+    Key key;
+    key.wrapMode = wrapMode;
+    key.filteringMode = filteringMode;
+    key.anisotropy = anisotropy > 1.0f ? std::min(anisotropy, getMaxAnisotropy()) : 1.0f;
+
+    std::map<Key, GLuint>::const_iterator it = mSamplers.find(key);
+    if (it != mSamplers.end())
+        return it->second;
+
+    GLuint sampler = 0;
+    glGenSamplers(1, &sampler);
+
+    // configure wrap mode
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, wrapMode);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, wrapMode);
+
+    // configure filtering (magnification never uses mipmaps)
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, filteringMode);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, filteringMode == GL_NEAREST ? GL_NEAREST : GL_LINEAR);
+
+    if (key.anisotropy > 1.0f)
+        glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY_EXT, key.anisotropy);
+
+    mSamplers[key] = sampler;
+    return sampler;
+}
+
+void SamplerCache::clear()
+{
+    std::map<Key, GLuint>::const_iterator it;
+    for (it = mSamplers.begin(); it != mSamplers.end(); ++it)
+        glDeleteSamplers(1, &it->second);
+    mSamplers.clear();
+}
+
+float SamplerCache::getMaxAnisotropy()
+{
+    if (mMaxAnisotropy == 0) {
+        mMaxAnisotropy = 1.0f;
+        if (GLEW_EXT_texture_filter_anisotropic)
+            glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &mMaxAnisotropy);
+    }
+    return mMaxAnisotropy;
+}
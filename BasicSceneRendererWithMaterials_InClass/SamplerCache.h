@@ -0,0 +1,49 @@
+#ifndef SAMPLER_CACHE_H_
+#define SAMPLER_CACHE_H_
+
+#include "glshell.h"
+#include <map>
+
+//
+// Shares GL sampler objects between textures.
+//
+// Textures only hold image data; wrap mode, filtering and anisotropy live in sampler objects
+// that are bound to a texture unit alongside the texture. Filtering can therefore be changed
+// globally or for a single pass just by asking for a different sampler.
+//
+class SamplerCache {
+
+    struct Key {
+        GLint   wrapMode;
+        GLint   filteringMode;
+        float   anisotropy;
+
+        bool operator<(const Key& k) const
+        {
+            if (wrapMode != k.wrapMode)             return wrapMode < k.wrapMode;
+            if (filteringMode != k.filteringMode)   return filteringMode < k.filteringMode;
+            return anisotropy < k.anisotropy;
+        }
+    };
+
+    std::map<Key, GLuint>   mSamplers;
+    float                   mMaxAnisotropy;     // queried on first use
+
+public:
+    SamplerCache();
+    ~SamplerCache();
+
+    // get (creating it on first use) the sampler with the given state;
+    // anisotropy is clamped to what the driver supports and ignored without EXT_texture_filter_anisotropic
+    GLuint          get(GLint wrapMode, GLint filteringMode, float anisotropy = 1.0f);
+
+    // delete all sampler objects
+    void            clear();
+
+    unsigned        size() const        { return mSamplers.size(); }
+
+    // largest anisotropy the driver supports (1 if anisotropic filtering is unavailable)
+    float           getMaxAnisotropy();
+};
+
+#endif
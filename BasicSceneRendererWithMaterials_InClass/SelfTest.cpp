@@ -0,0 +1,704 @@
+#include "SelfTest.h"
+#include "Bounds.h"
+#include "Entity.h"
+#include "Image.h"
+#include "LightClusters.h"
+#include "Profiler.h"
+#include "TextureManager.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// scratch file for the loaders, which only read from files
+static const char* const TEMP_PATH = "selftest.tmp";
+
+// failed checks of the test that is running
+static int sNumFailures;
+
+static void ReportFailure(const char* file, int line, const std::string& what)
+{
+    std::cout << "    " << file << "(" << line << "): " << what << std::endl;
+    ++sNumFailures;
+}
+
+#define SELFTEST_CHECK(cond) \
+    do { if (!(cond)) ReportFailure(__FILE__, __LINE__, #cond); } while (0)
+
+static bool Near(const glm::vec3& a, const glm::vec3& b, float eps)
+{
+    return std::abs(a.x - b.x) <= eps && std::abs(a.y - b.y) <= eps && std::abs(a.z - b.z) <= eps;
+}
+
+//
+// The tests
+//
+
+// box around all 8 corners of min..max, transformed one by one
+static Bounds CornerBounds(const glm::mat4& m, const glm::vec3& min, const glm::vec3& max)
+{
+    Bounds b(glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX));
+    for (int c = 0; c < 8; c++) {
+        glm::vec3 local(c & 1 ? max.x : min.x, c & 2 ? max.y : min.y, c & 4 ? max.z : min.z);
+        glm::vec3 p = glm::vec3(m * glm::vec4(local, 1.0f));
+        b.min = glm::min(b.min, p);
+        b.max = glm::max(b.max, p);
+    }
+    return b;
+}
+
+static void TestComputeWorldBounds()
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    for (int count = 0; count <= 11; count++) {
+        std::vector<Entity> entities;
+        for (int i = 0; i < count; i++) {
+            glm::vec3 axis = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(0.0f, 2.0f, 0.0f));
+            Transform transform(glm::vec3(10 * unit(rng), 10 * unit(rng), 10 * unit(rng)), glm::angleAxis(3.0f * unit(rng), axis));
+            glm::vec3 min(unit(rng), unit(rng), unit(rng));
+            glm::vec3 max = min + glm::vec3(1.0f + unit(rng), 1.5f + unit(rng), 2.0f + unit(rng));
+
+            // every third one without bounds, like the scene's walls
+            if (i % 3 == 2)
+                entities.push_back(Entity(NULL, NULL, transform));
+            else
+                entities.push_back(Entity(NULL, NULL, transform, min, max));
+        }
+
+        std::vector<Entity*> pointers;
+        for (int i = 0; i < count; i++)
+            pointers.push_back(&entities[i]);
+
+        std::vector<Bounds> bounds;
+        ComputeWorldBounds(pointers, bounds);
+
+        SELFTEST_CHECK((int)bounds.size() == count);
+        for (int i = 0; i < count && i < (int)bounds.size(); i++) {
+            Bounds expected = CornerBounds(entities[i].getWorldMatrix(), entities[i].mMin, entities[i].mMax);
+            SELFTEST_CHECK(Near(bounds[i].min, expected.min, 1e-4f));
+            SELFTEST_CHECK(Near(bounds[i].max, expected.max, 1e-4f));
+        }
+    }
+
+    // an entity without bounds is a point at its position
+    Entity point(NULL, NULL, Transform(glm::vec3(1, 2, 3)));
+    Bounds b = point.getWorldBounds();
+    SELFTEST_CHECK(Near(b.min, glm::vec3(1, 2, 3), 0.0f) && Near(b.max, glm::vec3(1, 2, 3), 0.0f));
+}
+
+static bool WriteFile(const std::string& path, const std::string& contents)
+{
+    std::ofstream file(path.c_str(), std::ios::binary);
+    file.write(contents.data(), contents.size());
+    return file.good();
+}
+
+static bool ReadFile(const std::string& path, std::string& contents)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    std::ostringstream buf;
+    buf << file.rdbuf();
+    contents = buf.str();
+    return file.good() && !contents.empty();
+}
+
+// the RLE images in textures/, so the decoder is checked on the files it is really used on
+static const char* const RLE_TEXTURES[] = {
+    "textures/art.tga",
+    "textures/art2.tga",
+    "textures/CarvedSandstone.tga",
+    "textures/grass.tga",
+    "textures/robot.idle.00001.tga",
+    "textures/rocky.tga",
+    "textures/skin.tga",
+    "textures/water_drops_on_metal.tga",
+    "textures/white.tga",
+    "textures/yo.tga",
+};
+
+//
+// The RLE decoder that Image::LoadTargaRLE replaced, kept as the reference for the new one:
+// pixel by pixel, stepping to the next row (up or down) whenever one is full. The three
+// copies for 8, 24 and 32 bpp are folded into one, and running out of data is an error
+// instead of a read past the end.
+//
+static bool ReferenceLoadTargaRLE(const std::string& tga, int& width, int& height, int& bytesPerPixel,
+                                  std::vector<char>& pixels)
+{
+    if (tga.size() < 18)
+        return false;
+
+    const unsigned char* hdr = reinterpret_cast<const unsigned char*>(tga.data());
+    width = hdr[12] | hdr[13] << 8;
+    height = hdr[14] | hdr[15] << 8;
+    bytesPerPixel = hdr[16] / 8;
+    pixels.assign((size_t)width * height * bytesPerPixel, 0);
+
+    const char* imgData = tga.data() + 18 + hdr[0];
+    const char* imgEnd = tga.data() + tga.size();
+
+    int rowlen = bytesPerPixel * width;
+    int rowstep;
+    char* dstRow;
+    if (hdr[17] & 0x20) {
+        // bottom-to-top
+        rowstep = -rowlen;
+        dstRow = &pixels[0] + rowlen * (height - 1);
+    } else {
+        rowstep = rowlen;
+        dstRow = &pixels[0];
+    }
+
+    const unsigned numPixels = width * height;
+    unsigned numPixelsRead = 0;
+    int numPixelsInRow = 0;
+    char* p = dstRow;
+
+    while (numPixelsRead < numPixels) {
+        if (imgData >= imgEnd)
+            return false;
+        unsigned char count = (unsigned char)*imgData++;
+        bool run = count > 127;
+        count = run ? count - 127 : count + 1;
+        for (unsigned char i = 0; i < count && numPixelsRead + i < numPixels; i++) {
+            if (imgEnd - imgData < bytesPerPixel)
+                return false;
+            // BGR(A) to RGB(A)
+            if (bytesPerPixel == 1) {
+                *p++ = imgData[0];
+            } else {
+                *p++ = imgData[2];
+                *p++ = imgData[1];
+                *p++ = imgData[0];
+                if (bytesPerPixel == 4)
+                    *p++ = imgData[3];
+            }
+            if (!run)
+                imgData += bytesPerPixel;
+            if (++numPixelsInRow == width) {
+                dstRow += rowstep;
+                p = dstRow;
+                numPixelsInRow = 0;
+            }
+        }
+        if (run)
+            imgData += bytesPerPixel;
+        numPixelsRead += count;
+    }
+    return true;
+}
+
+// pixels (in file order, BGR(A) or gray) in runs of 1 to 300 equal ones, from a few colors,
+// so there are runs longer than a packet and runs crossing rows
+static std::string MakeRunPixels(int numPixels, int bytesPerPixel, std::mt19937& rng)
+{
+    std::string pixels;
+    while ((int)pixels.size() < numPixels * bytesPerPixel) {
+        int run = 1 + rng() % (rng() % 4 == 0 ? 300 : 4);
+        char color[4] = { (char)(rng() % 3 * 100), (char)(rng() % 3 * 100), (char)(rng() % 3 * 100), (char)(rng() % 2 * 255) };
+        for (int i = 0; i < run; i++)
+            pixels.append(color, bytesPerPixel);
+    }
+    pixels.resize(numPixels * bytesPerPixel);
+    return pixels;
+}
+
+// run-length encode pixels into a TGA file, with packets of random lengths up to the maximum
+static std::string MakeRLETarga(int width, int height, int bytesPerPixel, bool bottomToTop,
+                                const std::string& pixels, std::mt19937& rng)
+{
+    unsigned char hdr[18] = { 0 };
+    hdr[2] = bytesPerPixel == 1 ? 11 : 10;
+    hdr[12] = (unsigned char)(width & 0xff);
+    hdr[13] = (unsigned char)(width >> 8);
+    hdr[14] = (unsigned char)(height & 0xff);
+    hdr[15] = (unsigned char)(height >> 8);
+    hdr[16] = (unsigned char)(8 * bytesPerPixel);
+    hdr[17] = (unsigned char)((bytesPerPixel == 4 ? 8 : 0) | (bottomToTop ? 0x20 : 0));
+
+    std::string tga(reinterpret_cast<const char*>(hdr), sizeof(hdr));
+
+    int n = width * height;
+    const char* data = pixels.data();
+    for (int i = 0; i < n; ) {
+        int maxCount = std::min(1 + (int)(rng() % 128), n - i);
+        int run = 1;
+        while (run < maxCount && !std::memcmp(data + (i + run) * bytesPerPixel, data + i * bytesPerPixel, bytesPerPixel))
+            ++run;
+
+        if (run > 1) {
+            tga += (char)(0x80 | (run - 1));
+            tga.append(data + i * bytesPerPixel, bytesPerPixel);
+        } else {
+            run = maxCount;
+            tga += (char)(run - 1);
+            tga.append(data + i * bytesPerPixel, run * bytesPerPixel);
+        }
+        i += run;
+    }
+    return tga;
+}
+
+// load a TGA held in memory with Image::LoadTarga (which prints why it fails)
+static bool LoadTarga(const std::string& tga, Image& img, bool quiet)
+{
+    if (!WriteFile(TEMP_PATH, tga)) {
+        ReportFailure(__FILE__, __LINE__, std::string("can't write ") + TEMP_PATH);
+        return false;
+    }
+
+    std::streambuf* cerrBuf = quiet ? std::cerr.rdbuf(NULL) : NULL;
+    bool ok = img.LoadTarga(TEMP_PATH);
+    if (quiet)
+        std::cerr.rdbuf(cerrBuf);
+
+    std::remove(TEMP_PATH);
+    return ok;
+}
+
+// Image holds the same pixels as the reference decoder's output
+static bool SameImage(const Image& img, int width, int height, int bytesPerPixel, const std::vector<char>& pixels)
+{
+    return img.getWidth() == width && img.getHeight() == height && img.getBytesPerPixel() == bytesPerPixel
+        && !std::memcmp(img.getData(), &pixels[0], pixels.size());
+}
+
+static void TestLoadTargaRLE()
+{
+    std::mt19937 rng(1);
+    const int sizes[][2] = { { 1, 1 }, { 7, 3 }, { 37, 19 }, { 128, 64 }, { 300, 2 }, { 2, 300 } };
+
+    // random images of all pixel sizes and both row orders
+    for (int bpp = 1; bpp <= 4; bpp++) {
+        if (bpp == 2)
+            continue;
+        for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            for (int order = 0; order < 2; order++) {
+                for (int seed = 0; seed < 4; seed++) {
+                    int w = sizes[s][0], h = sizes[s][1];
+                    std::string tga = MakeRLETarga(w, h, bpp, order == 1, MakeRunPixels(w * h, bpp, rng), rng);
+
+                    int rw, rh, rbpp;
+                    std::vector<char> expected;
+                    SELFTEST_CHECK(ReferenceLoadTargaRLE(tga, rw, rh, rbpp, expected));
+
+                    Image img;
+                    SELFTEST_CHECK(LoadTarga(tga, img, false));
+                    SELFTEST_CHECK(SameImage(img, rw, rh, rbpp, expected));
+                }
+            }
+        }
+    }
+
+    // the scene's own textures
+    for (unsigned i = 0; i < sizeof(RLE_TEXTURES) / sizeof(RLE_TEXTURES[0]); i++) {
+        std::string tga;
+        if (!ReadFile(RLE_TEXTURES[i], tga)) {
+            ReportFailure(__FILE__, __LINE__, std::string("can't read ") + RLE_TEXTURES[i] + " (run from the project directory)");
+            continue;
+        }
+
+        int rw, rh, rbpp;
+        std::vector<char> expected;
+        SELFTEST_CHECK(ReferenceLoadTargaRLE(tga, rw, rh, rbpp, expected));
+
+        Image img;
+        SELFTEST_CHECK(img.LoadTarga(RLE_TEXTURES[i]));
+        if (!SameImage(img, rw, rh, rbpp, expected))
+            ReportFailure(__FILE__, __LINE__, std::string("decoded differently: ") + RLE_TEXTURES[i]);
+    }
+}
+
+static void TestLoadTargaTruncated()
+{
+    std::mt19937 rng(2);
+
+    // every cut of a complete file fails cleanly, wherever it falls in a packet
+    for (int bpp = 1; bpp <= 4; bpp++) {
+        if (bpp == 2)
+            continue;
+        for (int order = 0; order < 2; order++) {
+            std::string tga = MakeRLETarga(9, 5, bpp, order == 1, MakeRunPixels(9 * 5, bpp, rng), rng);
+
+            Image img;
+            SELFTEST_CHECK(LoadTarga(tga, img, false));
+
+            int numLoaded = 0;
+            for (size_t len = 0; len < tga.size(); len++) {
+                Image cut;
+                numLoaded += LoadTarga(tga.substr(0, len), cut, true);
+            }
+            SELFTEST_CHECK(numLoaded == 0);
+        }
+    }
+
+    // a last packet that claims more pixels than are left stops at the end of the image
+    const char* const overlong[] = {
+        "\xff" "abc",                                          // a run of 128 for 10 pixels
+        "\x84" "abc" "\x09" "zzzzzzzzzzzzzzzzzzzzzzzzzzzzzz",   // 5 in a run, then 10 raw for 5
+    };
+    for (int i = 0; i < 2; i++) {
+        std::string tga = MakeRLETarga(5, 2, 3, false, std::string(30, 'x'), rng).substr(0, 18) + overlong[i];
+
+        int rw, rh, rbpp;
+        std::vector<char> expected;
+        SELFTEST_CHECK(ReferenceLoadTargaRLE(tga, rw, rh, rbpp, expected));
+
+        Image img;
+        SELFTEST_CHECK(LoadTarga(tga, img, false));
+        SELFTEST_CHECK(SameImage(img, rw, rh, rbpp, expected));
+    }
+}
+
+// random small lights in the view frustum, in view space, and a few large ones
+static std::vector<PointLight> MakeViewLights(int count, float tanHalfX, float tanHalfY, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    std::vector<PointLight> lights(count);
+    for (int i = 0; i < count; i++) {
+        float depth = 1 + 99 * unit(rng);
+        glm::vec3 pos((2 * unit(rng) - 1) * tanHalfX * depth, (2 * unit(rng) - 1) * tanHalfY * depth, -depth);
+        float attQuad = i % 50 == 0 ? 0.01f : 2.0f;
+        lights[i] = PointLight(pos, glm::vec3(0.5f, 0.5f, 0.5f), attQuad, 1.0f, 1.0f);
+    }
+    return lights;
+}
+
+static void TestLightClusters()
+{
+    const float fovy = glm::radians(50.0f), aspect = 16 / 9.0f, cutoff = 0.01f;
+    const float tanHalfY = std::tan(0.5f * fovy), tanHalfX = tanHalfY * aspect;
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    LightClusters clusters;
+    clusters.setProjection(fovy, aspect, 0.1f, 1000.0f, 1280, 720);
+
+    const int lightCounts[] = { 0, 100, 2000 };
+    for (unsigned n = 0; n < sizeof(lightCounts) / sizeof(lightCounts[0]); n++) {
+        std::vector<PointLight> lights = MakeViewLights(lightCounts[n], tanHalfX, tanHalfY, rng);
+
+        clusters.setNumThreads(1);
+        clusters.build(lights, cutoff);
+        std::vector<GLuint> clusterData = clusters.getClusterData();
+        std::vector<GLuint> indices = clusters.getIndices();
+
+        // every light that reaches a point is in the list of the point's cluster
+        for (int k = 0; k < 2000; k++) {
+            float depth = 0.1f + 110 * unit(rng);
+            float sx = 2 * unit(rng) - 1, sy = 2 * unit(rng) - 1;
+            glm::vec3 p(sx * tanHalfX * depth, sy * tanHalfY * depth, -depth);
+
+            int x = std::min((int)((0.5f * sx + 0.5f) * clusters.getDimX()), clusters.getDimX() - 1);
+            int y = std::min((int)((0.5f * sy + 0.5f) * clusters.getDimY()), clusters.getDimY() - 1);
+            int c = clusters.clusterIndex(x, y, clusters.sliceIndex(depth));
+            const GLuint* first = indices.data() + clusterData[2 * c];
+            const GLuint* last = first + clusterData[2 * c + 1];
+
+            for (unsigned i = 0; i < lights.size(); i++) {
+                if (glm::length(lights[i].pos - p) < 0.999f * LightRadius(lights[i], cutoff))
+                    SELFTEST_CHECK(std::find(first, last, i) != last);
+            }
+        }
+
+        // the workers produce the same lists, also when they are restarted and reused
+        const int threadCounts[] = { 4, 4, 3 };
+        for (int t = 0; t < 3; t++) {
+            clusters.setNumThreads(threadCounts[t]);
+            clusters.build(lights, cutoff);
+            SELFTEST_CHECK(clusters.getClusterData() == clusterData);
+            SELFTEST_CHECK(clusters.getIndices() == indices);
+        }
+    }
+}
+
+// the eviction and restore policy, on accounting-only entries
+static void TestTextureManager()
+{
+    // four mipmapped 256x256 RGBA textures, 349524 bytes each, and an array of 4 64x64 layers
+    const size_t texBytes = TextureManager::ResidentBytes(256, 256, 4, 9, 0);
+    const size_t arrayBytes = 4 * 64 * 64 * 4;
+    SELFTEST_CHECK(texBytes == 349524);
+
+    TextureManager tm(3 * texBytes + arrayBytes + TextureManager::ResidentBytes(256, 256, 4, 9, 1));
+    int ids[4];
+    for (int i = 0; i < 4; i++)
+        ids[i] = tm.add(256, 256, 4, 9);
+    int arrayId = tm.add(64, 64, 4, 1, 4);
+    SELFTEST_CHECK(tm.getResidentBytes(arrayId) == arrayBytes);
+
+    // over budget: the least recently used texture gives up just enough levels
+    tm.beginFrame();
+    tm.touch(ids[0]);
+    tm.touch(ids[1]);
+    tm.touch(ids[2]);
+    tm.endFrame();
+
+    const TextureResidencyStats& stats = tm.getStats();
+    SELFTEST_CHECK(stats.residentBytes <= tm.getBudget());
+    SELFTEST_CHECK(stats.residentBytes == tm.getResidentBytes(ids[3]) + 3 * texBytes + arrayBytes);
+    SELFTEST_CHECK(tm.getBaseLevel(ids[3]) == 1);
+    SELFTEST_CHECK(stats.numDemotions == 1);
+    for (int i = 0; i < 3; i++)
+        SELFTEST_CHECK(tm.getBaseLevel(ids[i]) == 0);
+
+    // a budget nothing fits in: everything stops at the fallback, the array is left alone
+    tm.setBudget(1);
+    tm.beginFrame();
+    tm.endFrame();
+
+    int fallback = TextureManager::FallbackLevel(256, 256);
+    SELFTEST_CHECK(fallback == 4);
+    for (int i = 0; i < 4; i++)
+        SELFTEST_CHECK(tm.getBaseLevel(ids[i]) == fallback);
+    SELFTEST_CHECK(tm.getBaseLevel(arrayId) == 0);
+    SELFTEST_CHECK(stats.numFallback == 4);
+    SELFTEST_CHECK(stats.numArrays == 1);
+    SELFTEST_CHECK(stats.residentBytes == 4 * TextureManager::ResidentBytes(256, 256, 4, 9, fallback) + arrayBytes);
+
+    // room again: only the textures in use come back, a few levels per frame
+    tm.setBudget(64 * texBytes);
+    int numFrames = 0;
+    while (tm.getBaseLevel(ids[2]) + tm.getBaseLevel(ids[3]) > 0 && numFrames < 100) {
+        tm.beginFrame();
+        tm.touch(ids[2]);
+        tm.touch(ids[3]);
+        tm.endFrame();
+        SELFTEST_CHECK((int)stats.numPromotions <= TextureManager::MAX_PROMOTIONS_PER_FRAME);
+        ++numFrames;
+    }
+    SELFTEST_CHECK(numFrames == 2 * fallback / TextureManager::MAX_PROMOTIONS_PER_FRAME);
+    SELFTEST_CHECK(tm.getBaseLevel(ids[0]) == fallback && tm.getBaseLevel(ids[1]) == fallback);
+    SELFTEST_CHECK(stats.numFullRes == 3);
+
+    // a promotion that would break the budget waits
+    tm.setBudget(stats.residentBytes + 1);
+    tm.beginFrame();
+    tm.touch(ids[0]);
+    tm.endFrame();
+    SELFTEST_CHECK(stats.numPromotions == 0 && tm.getBaseLevel(ids[0]) == fallback);
+    SELFTEST_CHECK(tm.getTargetLevel(ids[0]) == tm.getBaseLevel(ids[0]));
+}
+
+// JSON syntax check, enough to tell whether a trace viewer will load a file
+static bool ParseJsonValue(const std::string& s, size_t& pos);
+
+static void SkipJsonSpace(const std::string& s, size_t& pos)
+{
+    while (pos < s.size() && s[pos] && std::strchr(" \t\r\n", s[pos]))
+        ++pos;
+}
+
+static bool ParseJsonString(const std::string& s, size_t& pos)
+{
+    if (pos >= s.size() || s[pos] != '"')
+        return false;
+    for (++pos; pos < s.size(); ++pos) {
+        if (s[pos] == '"') {
+            ++pos;
+            return true;
+        }
+        if ((unsigned char)s[pos] < 0x20)
+            return false;
+        if (s[pos] == '\\' && (++pos == s.size() || !s[pos] || !std::strchr("\"\\/bfnrtu", s[pos])))
+            return false;
+    }
+    return false;
+}
+
+static bool ParseJsonList(const std::string& s, size_t& pos, char close, bool object)
+{
+    ++pos;
+    SkipJsonSpace(s, pos);
+    if (pos < s.size() && s[pos] == close) {
+        ++pos;
+        return true;
+    }
+    for (;;) {
+        if (object) {
+            SkipJsonSpace(s, pos);
+            if (!ParseJsonString(s, pos))
+                return false;
+            SkipJsonSpace(s, pos);
+            if (pos >= s.size() || s[pos++] != ':')
+                return false;
+        }
+        if (!ParseJsonValue(s, pos))
+            return false;
+        SkipJsonSpace(s, pos);
+        if (pos >= s.size())
+            return false;
+        if (s[pos] == close) {
+            ++pos;
+            return true;
+        }
+        if (s[pos++] != ',')
+            return false;
+    }
+}
+
+static bool ParseJsonValue(const std::string& s, size_t& pos)
+{
+    SkipJsonSpace(s, pos);
+    if (pos >= s.size())
+        return false;
+
+    char c = s[pos];
+    if (c == '{')
+        return ParseJsonList(s, pos, '}', true);
+    if (c == '[')
+        return ParseJsonList(s, pos, ']', false);
+    if (c == '"')
+        return ParseJsonString(s, pos);
+
+    const char* const words[] = { "true", "false", "null" };
+    for (int i = 0; i < 3; i++) {
+        if (!s.compare(pos, std::strlen(words[i]), words[i])) {
+            pos += std::strlen(words[i]);
+            return true;
+        }
+    }
+
+    // numbers, as strtod reads them (a little more lenient than JSON)
+    if (c != '-' && !(c >= '0' && c <= '9'))
+        return false;
+    const char* start = s.c_str() + pos;
+    char* end;
+    std::strtod(start, &end);
+    pos += end - start;
+    return end != start;
+}
+
+static bool IsValidJson(const std::string& s)
+{
+    size_t pos = 0;
+    if (!ParseJsonValue(s, pos))
+        return false;
+    SkipJsonSpace(s, pos);
+    return pos == s.size();
+}
+
+static int CountOccurrences(const std::string& s, const std::string& what)
+{
+    int count = 0;
+    for (size_t pos = s.find(what); pos != std::string::npos; pos = s.find(what, pos + what.size()))
+        ++count;
+    return count;
+}
+
+static void RecordWorkerZones(int count)
+{
+    for (int i = 0; i < count; i++) {
+        PROFILE_ZONE("selftest worker");
+    }
+}
+
+// zones from the main thread, from threads that come and go, and from the GPU track
+static void TestProfilerTrace()
+{
+    SELFTEST_CHECK(IsValidJson("{\"a\":[1,-2.5e3,\"x\\\"y\",true,null,{}],\"b\":{\"c\":[]}}"));
+    SELFTEST_CHECK(!IsValidJson("{\"a\":[1,2,]}"));
+    SELFTEST_CHECK(!IsValidJson("{\"a\":1}}"));
+    SELFTEST_CHECK(!IsValidJson("{\"a\":\"x\ny\"}"));
+
+    const int numThreads = 3, zonesPerThread = 100;
+
+    Profiler::BeginCapture();
+    {
+        PROFILE_ZONE("selftest outer");
+        {
+            PROFILE_ZONE("selftest inner");
+        }
+    }
+
+    // two rounds, the second one gets the buffers the first one handed back
+    for (int round = 0; round < 2; round++) {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < numThreads; t++)
+            threads.push_back(std::thread(RecordWorkerZones, zonesPerThread));
+        for (int t = 0; t < numThreads; t++)
+            threads[t].join();
+    }
+
+    long long now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    Profiler::RecordGpu("selftest gpu", now, now + 1000);
+    Profiler::EndCapture();
+
+    {
+        PROFILE_ZONE("selftest after");
+    }
+
+    int numZones = 2 + 2 * numThreads * zonesPerThread + 1;
+    SELFTEST_CHECK((int)Profiler::GetNumEvents() == numZones);
+
+    std::string trace;
+    SELFTEST_CHECK(Profiler::WriteChromeTrace(TEMP_PATH));
+    SELFTEST_CHECK(ReadFile(TEMP_PATH, trace));
+    std::remove(TEMP_PATH);
+
+    SELFTEST_CHECK(IsValidJson(trace));
+    SELFTEST_CHECK(CountOccurrences(trace, "\"ph\":\"X\"") == numZones);
+    SELFTEST_CHECK(CountOccurrences(trace, "\"name\":\"selftest worker\"") == 2 * numThreads * zonesPerThread);
+    SELFTEST_CHECK(CountOccurrences(trace, "\"name\":\"selftest outer\"") == 1);
+    SELFTEST_CHECK(CountOccurrences(trace, "\"name\":\"selftest gpu\",\"cat\":\"gpu\"") == 1);
+    SELFTEST_CHECK(CountOccurrences(trace, "selftest after") == 0);
+}
+
+//
+// Registry
+//
+struct SelfTest {
+    const char*     name;
+    void            (*func)();
+};
+
+static const SelfTest sTests[] = {
+    { "ComputeWorldBounds",         TestComputeWorldBounds },
+    { "Image::LoadTarga/rle",       TestLoadTargaRLE },
+    { "Image::LoadTarga/truncated", TestLoadTargaTruncated },
+    { "LightClusters::build",       TestLightClusters },
+    { "Profiler::WriteChromeTrace", TestProfilerTrace },
+    { "TextureManager",             TestTextureManager },
+};
+
+int RunSelfTests(const std::string& filter)
+{
+    int numRun = 0, numFailed = 0;
+
+    for (unsigned i = 0; i < sizeof(sTests) / sizeof(sTests[0]); i++) {
+        const SelfTest& test = sTests[i];
+        if (!filter.empty() && std::string(test.name).find(filter) == std::string::npos)
+            continue;
+
+        std::cout << test.name << std::endl;
+        sNumFailures = 0;
+        test.func();
+        ++numRun;
+
+        if (sNumFailures > 0) {
+            std::cout << "  FAILED (" << sNumFailures << " checks)" << std::endl;
+            ++numFailed;
+        }
+    }
+
+    if (numRun == 0) {
+        std::cerr << "*** No self-test matches '" << filter << "'" << std::endl;
+        return 1;
+    }
+
+    std::cout << numRun - numFailed << " of " << numRun << " self-tests passed" << std::endl;
+    return numFailed == 0 ? 0 : 1;
+}
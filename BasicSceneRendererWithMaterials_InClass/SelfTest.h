@@ -0,0 +1,17 @@
+#ifndef SELFTEST_H_
+#define SELFTEST_H_
+
+#include <string>
+
+//
+// Checks of code whose mistakes would not show on screen (optimized paths against the plain
+// ones they replace, corner cases of the loaders and policies), run with
+//
+//     BasicScene --selftest [--filter TEXT]
+//
+// The tests need no GL context and no window, so they run on any build machine. Each one
+// reports its failed checks; the return value is a process exit code, 0 if all passed.
+//
+int RunSelfTests(const std::string& filter);
+
+#endif
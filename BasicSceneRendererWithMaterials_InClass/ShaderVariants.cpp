@@ -0,0 +1,66 @@
+#include "ShaderVariants.h"
+#include "common.h"  // ToString()
+
+ShaderVariants::ShaderVariants()
+{
+}
+
+ShaderVariants::~ShaderVariants()
+{
+    clear();
+}
+
+std::string ShaderVariants::GetDefines(unsigned key)
+{
+    int textureMode = 0;
+    if (key & TEXTURE_ARRAY)
+        textureMode = 2;
+    else if (key & TEXTURE_2D)
+        textureMode = 1;
+
+    std::string defines;
+    defines += "#define TEXTURE_MODE " + ToString(textureMode) + "\n";
+    defines += "#define SPECULAR " + ToString((key & SPECULAR) ? 1 : 0) + "\n";
+    defines += "#define EMISSIVE " + ToString((key & EMISSIVE) ? 1 : 0) + "\n";
+    defines += "#define NUM_DIR_LIGHTS " + ToString((key >> DIR_LIGHT_SHIFT) & 0xff) + "\n";
+    defines += "#define NUM_POINT_LIGHTS " + ToString((key >> POINT_LIGHT_SHIFT) & 0xff) + "\n";
+    return defines;
+}
+
+void ShaderVariants::setSources(const std::string& vsPath, const std::string& fsPath)
+{
+    clear();
+    mVsPath = vsPath;
+    mFsPath = fsPath;
+}
+
+ShaderProgram* ShaderVariants::get(unsigned key)
+{
+    std::map<unsigned, ShaderProgram*>::iterator it = mPrograms.find(key);
+    if (it != mPrograms.end())
+        return it->second;
+
+    ShaderProgram* prog = new ShaderProgram(mVsPath, mFsPath, GetDefines(key));
+    mPrograms[key] = prog;
+    return prog;
+}
+
+void ShaderVariants::compile(const std::vector<unsigned>& keys)
+{
+    ShaderBatch batch;
+
+    for (unsigned i = 0; i < keys.size(); i++) {
+        if (mPrograms.find(keys[i]) == mPrograms.end())
+            mPrograms[keys[i]] = batch.add(mVsPath, mFsPath, GetDefines(keys[i]));
+    }
+
+    batch.finish();
+}
+
+void ShaderVariants::clear()
+{
+    std::map<unsigned, ShaderProgram*>::iterator it;
+    for (it = mPrograms.begin(); it != mPrograms.end(); ++it)
+        delete it->second;
+    mPrograms.clear();
+}
@@ -0,0 +1,70 @@
+#ifndef SHADER_VARIANTS_H_
+#define SHADER_VARIANTS_H_
+
+#include "Shaders.h"
+#include <map>
+#include <vector>
+
+//
+// Compile-time specializations of a material shader.
+//
+// Each variant is the same pair of source files compiled with #defines that fix the texture
+// mode, the specular and emissive terms and the number of lights, so the compiler can drop
+// unused code and unroll the light loops. Variants are compiled the first time they are asked
+// for and cached by their key (see MakeKey).
+//
+// Defines understood by the shaders (see BlinnPhongPerFragmentMultiLight-fs.glsl):
+//   TEXTURE_MODE       0 = untextured, 1 = u_TexSampler, 2 = u_TexArraySampler layer u_TexLayer
+//   SPECULAR           0 or 1
+//   EMISSIVE           0 or 1
+//   NUM_DIR_LIGHTS     replaces u_NumDirLights
+//   NUM_POINT_LIGHTS   replaces u_NumPointLights
+//
+class ShaderVariants {
+public:
+    enum Feature {
+        TEXTURE_2D      = 1 << 0,
+        TEXTURE_ARRAY   = 1 << 1,
+        SPECULAR        = 1 << 2,
+        EMISSIVE        = 1 << 3,
+    };
+
+    // light counts are stored above the feature bits
+    static const int    DIR_LIGHT_SHIFT = 8;
+    static const int    POINT_LIGHT_SHIFT = 16;
+
+    static unsigned     MakeKey(unsigned features, int numDirLights, int numPointLights)
+    {
+        return features | (numDirLights << DIR_LIGHT_SHIFT) | (numPointLights << POINT_LIGHT_SHIFT);
+    }
+
+    // the #define block for a key
+    static std::string  GetDefines(unsigned key);
+
+    ShaderVariants();
+    ~ShaderVariants();
+
+    void                setSources(const std::string& vsPath, const std::string& fsPath);
+
+    // get the variant for a key, compiling it on first use
+    ShaderProgram*      get(unsigned key);
+
+    // compile the variants that don't exist yet in one batch (see ShaderBatch),
+    // so they don't have to be compiled one at a time during drawing
+    void                compile(const std::vector<unsigned>& keys);
+
+    // delete all variants
+    void                clear();
+
+    unsigned            size() const        { return mPrograms.size(); }
+
+private:
+                        ShaderVariants(const ShaderVariants&);
+    ShaderVariants&     operator=(const ShaderVariants&);
+
+    std::string                         mVsPath;
+    std::string                         mFsPath;
+    std::map<unsigned, ShaderProgram*>  mPrograms;
+};
+
+#endif
@@ -1,16 +1,147 @@
 #include "Shaders.h"
 #include "common.h"  // ReadTextFile()
+#include "Profiler.h"
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+
+#if _WIN32
+#  include <direct.h>       // _mkdir
+#else
+#  include <sys/stat.h>     // mkdir
+#endif
+
+std::string ShaderProgram::smBinaryCacheDir;
+ShaderLoadStats ShaderProgram::smLoadStats = { 0, 0, 0, 0, 0.0 };
+std::map<std::string, GLuint> ShaderProgram::smBlockBindings;
+
+namespace {
+
+// header of a cached program binary file
+struct BinaryHeader {
+    char        magic[4];
+    GLenum      format;
+    GLint       length;
+};
+
+const char BINARY_MAGIC[4] = { 'G', 'L', 'P', 'B' };
+
+// 64-bit FNV-1a
+unsigned long long HashString(const std::string& str, unsigned long long hash = 14695981039346656037ULL)
+{
+    for (size_t i = 0; i < str.size(); i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// identifies the driver that produced a binary (binaries are only valid for the same driver)
+std::string DriverString()
+{
+    const char* vendor = (const char*)glGetString(GL_VENDOR);
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    const char* version = (const char*)glGetString(GL_VERSION);
+
+    std::string str;
+    str += vendor ? vendor : "";
+    str += '\n';
+    str += renderer ? renderer : "";
+    str += '\n';
+    str += version ? version : "";
+    return str;
+}
+
+// from KHR_parallel_shader_compile (not in older GLEW headers)
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (GLAPIENTRY *MaxShaderCompilerThreadsProc)(GLuint count);
+
+// whether the driver compiles and links in the background and can be polled for completion;
+// the first call also lets the driver use as many compiler threads as it likes
+bool HasParallelShaderCompile()
+{
+    static int supported = -1;
+
+    if (supported < 0) {
+        supported = 0;
+
+        GLint numExtensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+        for (GLint i = 0; i < numExtensions; i++) {
+            const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (ext && (std::strcmp(ext, "GL_KHR_parallel_shader_compile") == 0 ||
+                        std::strcmp(ext, "GL_ARB_parallel_shader_compile") == 0)) {
+                supported = 1;
+                break;
+            }
+        }
+
+        if (supported) {
+            MaxShaderCompilerThreadsProc maxThreads = (MaxShaderCompilerThreadsProc)GLShell::GetProcAddress("glMaxShaderCompilerThreadsKHR");
+            if (!maxThreads)
+                maxThreads = (MaxShaderCompilerThreadsProc)GLShell::GetProcAddress("glMaxShaderCompilerThreadsARB");
+            if (maxThreads)
+                maxThreads(0xFFFFFFFF);     // no limit
+        }
+    }
+
+    return supported == 1;
+}
+
+// file name of the cached binary for a pair of (preprocessed) sources
+std::string BinaryFileName(const std::string& vsSource, const std::string& fsSource)
+{
+    unsigned long long hash = HashString(DriverString());
+    hash = HashString(vsSource + '\0', hash);
+    hash = HashString(fsSource, hash);
+
+    std::ostringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+    return ss.str();
+}
+
+// insert lines after the #version directive (which must stay first), or at the start if there is none
+std::string InjectDefines(const std::string& source, const std::string& defines)
+{
+    if (defines.empty())
+        return source;
+
+    size_t pos = source.find("#version");
+    if (pos == std::string::npos)
+        return defines + source;
+
+    pos = source.find('\n', pos);
+    if (pos == std::string::npos)
+        return source + "\n" + defines;
+
+    // #line keeps compiler messages pointing at the lines in the file
+    int nextLine = std::count(source.begin(), source.begin() + pos, '\n') + 2;
+
+    return source.substr(0, pos + 1) + defines + "#line " + ToString(nextLine) + "\n" + source.substr(pos + 1);
+}
+
+}
 
 ShaderProgram::ShaderProgram()
     : mProgId(0)
+    , mVsId(0)
+    , mFsId(0)
 {
 }
 
-ShaderProgram::ShaderProgram(const std::string& vsPath, const std::string& fsPath)
+ShaderProgram::ShaderProgram(const std::string& vsPath, const std::string& fsPath, const std::string& defines)
     : mProgId(0)
+    , mVsId(0)
+    , mFsId(0)
 {
-    load(vsPath, fsPath);
+    load(vsPath, fsPath, defines);
 }
 
 ShaderProgram::~ShaderProgram()
@@ -23,55 +154,245 @@ bool ShaderProgram::isValid() const
     return mProgId != 0;
 }
 
-void ShaderProgram::load(const std::string& vsPath, const std::string& fsPath)
+void ShaderProgram::load(const std::string& vsPath, const std::string& fsPath, const std::string& defines)
+{
+    beginLoad(vsPath, fsPath, defines);
+    finishLoad();
+}
+
+void ShaderProgram::beginLoad(const std::string& vsPath, const std::string& fsPath, const std::string& defines)
 {
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    ++smLoadStats.numPrograms;
+
     // load shader source code
-    std::string vsString = ReadTextFile(vsPath);
-    std::string fsString = ReadTextFile(fsPath);
+    std::string vsString = InjectDefines(ReadTextFile(vsPath), defines);
+    std::string fsString = InjectDefines(ReadTextFile(fsPath), defines);
+
+    // try a binary linked by an earlier run
+    mBinaryPath.clear();
+    if (!smBinaryCacheDir.empty() && GLEW_ARB_get_program_binary) {
+        std::string binaryPath = smBinaryCacheDir + "/" + BinaryFileName(vsString, fsString);
+
+        if (loadBinary(binaryPath)) {
+            applyBlockBindings();
+            ++smLoadStats.cacheHits;
+            smLoadStats.loadSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            return;
+        }
+
+        mBinaryPath = binaryPath;
+    }
+
+    // enable background compilation, if the driver can do it
+    HasParallelShaderCompile();
 
     // create vertex shader object
-    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+    mVsId = glCreateShader(GL_VERTEX_SHADER);
 
     // attach vertex shader source code
     const char* vsCString = vsString.c_str();
-    glShaderSource(vs, 1, &vsCString, NULL);
+    glShaderSource(mVsId, 1, &vsCString, NULL);
 
     // compile vertex shader
-    glCompileShader(vs);
-
-    CHECK_GL_SHADER(vs, "vertex shader");
+    glCompileShader(mVsId);
 
     // create fragment shader object
-    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+    mFsId = glCreateShader(GL_FRAGMENT_SHADER);
 
     // attach fragment shader source code
     const char* fsCString = fsString.c_str();
-    glShaderSource(fs, 1, &fsCString, NULL);
+    glShaderSource(mFsId, 1, &fsCString, NULL);
 
     // compile fragment shader
-    glCompileShader(fs);
-
-    CHECK_GL_SHADER(fs, "fragment shader");
+    glCompileShader(mFsId);
 
     // create GPU program
     mProgId = glCreateProgram();
 
     // attach vertex and fragment shaders to program
-    glAttachShader(mProgId, vs);
-    glAttachShader(mProgId, fs);
+    glAttachShader(mProgId, mVsId);
+    glAttachShader(mProgId, mFsId);
 
-    // link program
+    // ask the driver to keep the binary around, if we are going to cache it
+    if (!mBinaryPath.empty())
+        glProgramParameteri(mProgId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    // link program (compile errors show up when the shaders are checked in finishLoad)
     glLinkProgram(mProgId);
 
+    smLoadStats.loadSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool ShaderProgram::isLoadComplete() const
+{
+    if (!mVsId || !HasParallelShaderCompile())
+        return true;
+
+    GLint complete = GL_TRUE;
+    glGetProgramiv(mProgId, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete == GL_TRUE;
+}
+
+void ShaderProgram::finishLoad()
+{
+    if (!mVsId)
+        return;     // loaded from a binary, or already finished
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    // these block until the driver is done with the program
+    CHECK_GL_SHADER(mVsId, "vertex shader");
+    CHECK_GL_SHADER(mFsId, "fragment shader");
     CHECK_GL_PROGRAM(mProgId, "GPU program");
 
+    applyBlockBindings();
+
     // shader objects are no longer needed, so release them
-    glDeleteShader(vs);
-    glDeleteShader(fs);
+    glDeleteShader(mVsId);
+    glDeleteShader(mFsId);
+    mVsId = 0;
+    mFsId = 0;
+
+    if (!mBinaryPath.empty()) {
+        ++smLoadStats.cacheMisses;
+        saveBinary(mBinaryPath);
+    }
+
+    smLoadStats.loadSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool ShaderProgram::loadBinary(const std::string& path)
+{
+    std::ifstream f(path.c_str(), std::ios::binary);
+    if (!f.good())
+        return false;
+
+    BinaryHeader header;
+    if (!f.read((char*)&header, sizeof(header)) || !std::equal(header.magic, header.magic + 4, BINARY_MAGIC) || header.length <= 0)
+        return false;
+
+    std::vector<char> binary(header.length);
+    if (!f.read(&binary[0], header.length))
+        return false;
+
+    mProgId = glCreateProgram();
+    glProgramBinary(mProgId, header.format, &binary[0], header.length);
+
+    // drivers refuse binaries after an update, even if the version string did not change
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(mProgId, GL_LINK_STATUS, &linkStatus);
+    if (linkStatus != GL_TRUE) {
+        std::cerr << "*** Cached program binary " << path << " was rejected, recompiling" << std::endl;
+        ++smLoadStats.cacheRejected;
+        glDeleteProgram(mProgId);
+        mProgId = 0;
+        return false;
+    }
+
+    return true;
+}
+
+void ShaderProgram::saveBinary(const std::string& path) const
+{
+    GLint length = 0;
+    glGetProgramiv(mProgId, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;     // some drivers support no binary formats at all
+
+    std::vector<char> binary(length);
+    BinaryHeader header;
+    std::copy(BINARY_MAGIC, BINARY_MAGIC + 4, header.magic);
+    glGetProgramBinary(mProgId, length, &header.length, &header.format, &binary[0]);
+
+    std::ofstream f(path.c_str(), std::ios::binary);
+    if (!f.write((const char*)&header, sizeof(header)) || !f.write(&binary[0], header.length))
+        std::cerr << "*** Failed to write program binary " << path << std::endl;
+}
+
+ShaderBatch::ShaderBatch()
+{
+}
+
+ShaderProgram* ShaderBatch::add(const std::string& vsPath, const std::string& fsPath, const std::string& defines)
+{
+    ShaderProgram* prog = new ShaderProgram;
+    prog->beginLoad(vsPath, fsPath, defines);
+    mPending.push_back(prog);
+    return prog;
+}
+
+void ShaderBatch::finish()
+{
+    PROFILE_ZONE("ShaderBatch::finish");
+
+    // finish programs as the driver completes them, so status queries never wait on
+    // one program while others are already done
+    while (!mPending.empty()) {
+        bool progress = false;
+
+        for (unsigned i = 0; i < mPending.size(); ) {
+            if (mPending[i]->isLoadComplete()) {
+                ShaderProgram* prog = mPending[i];
+                mPending.erase(mPending.begin() + i);
+                prog->finishLoad();     // may throw, the remaining programs stay pending
+                progress = true;
+            } else {
+                ++i;
+            }
+        }
+
+        if (!progress) {
+            std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+            std::this_thread::yield();
+            ShaderProgram::smLoadStats.loadSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+    }
+}
+
+void ShaderProgram::applyBlockBindings() const
+{
+    std::map<std::string, GLuint>::const_iterator it;
+    for (it = smBlockBindings.begin(); it != smBlockBindings.end(); ++it) {
+        GLuint index = glGetUniformBlockIndex(mProgId, it->first.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(mProgId, index, it->second);
+    }
+}
+
+void ShaderProgram::SetBlockBinding(const std::string& blockName, GLuint binding)
+{
+    smBlockBindings[blockName] = binding;
+}
+
+void ShaderProgram::EnableBinaryCache(const std::string& dir)
+{
+    // fails harmlessly if the directory already exists
+#if _WIN32
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), 0755);
+#endif
+
+    smBinaryCacheDir = dir;
+}
+
+void ShaderProgram::DisableBinaryCache()
+{
+    smBinaryCacheDir.clear();
 }
 
 void ShaderProgram::unload()
 {
+    // shaders are left over if a batch was abandoned before finishing
+    if (mVsId)
+        glDeleteShader(mVsId);
+    if (mFsId)
+        glDeleteShader(mFsId);
+    mVsId = 0;
+    mFsId = 0;
+
     if (mProgId)
         glDeleteProgram(mProgId);
     mProgId = 0;
@@ -3,22 +3,71 @@
 
 #include "glshell.h"  // includes all necessary GL headers
 
+#include <map>
 #include <string>
+#include <vector>
+
+// counters for all programs loaded so far
+struct ShaderLoadStats {
+    unsigned    numPrograms;
+    unsigned    cacheHits;          // linked from a cached binary
+    unsigned    cacheMisses;        // compiled from source (and stored, if the cache is enabled)
+    unsigned    cacheRejected;      // cached binaries the driver refused (recompiled from source)
+    double      loadSeconds;        // total time spent in load()
+};
 
 class ShaderProgram {
 
     GLuint mProgId;
 
+    // shaders of a program whose load has begun but not finished (see beginLoad)
+    GLuint mVsId;
+    GLuint mFsId;
+    std::string mBinaryPath;    // where to store the binary once linked (empty = don't)
+
+    // on-disk cache of linked programs (empty = disabled)
+    static std::string      smBinaryCacheDir;
+    static ShaderLoadStats  smLoadStats;
+
+    // uniform block name -> binding point, applied to every program when it is linked
+    static std::map<std::string, GLuint>    smBlockBindings;
+
+    bool loadBinary(const std::string& path);
+    void saveBinary(const std::string& path) const;
+    void applyBlockBindings() const;
+
 public:
     ShaderProgram();
-    ShaderProgram(const std::string& vsPath, const std::string& fsPath);
+    ShaderProgram(const std::string& vsPath, const std::string& fsPath, const std::string& defines = "");
     ~ShaderProgram();
 
     bool isValid() const;
 
-    void load(const std::string& vsPath, const std::string& fsPath);
+    // 'defines' (e.g. "#define FOO 1\n") is inserted into both shaders right after their #version line
+    void load(const std::string& vsPath, const std::string& fsPath, const std::string& defines = "");
+
+    // load() in two steps: beginLoad submits the compile and link without waiting for them,
+    // finishLoad checks the results (throwing on errors like load() does)
+    void beginLoad(const std::string& vsPath, const std::string& fsPath, const std::string& defines = "");
+    void finishLoad();
+
+    // whether finishLoad would return without waiting (always true without KHR_parallel_shader_compile)
+    bool isLoadComplete() const;
     void unload();
 
+    // Cache linked programs in 'dir' (created if necessary), so later runs can skip compiling.
+    // Binaries are keyed by a hash of the sources and the driver's vendor, renderer and version
+    // strings; a binary the driver rejects anyway is recompiled from source and replaced.
+    // Needs ARB_get_program_binary, otherwise programs are always compiled.
+    static void EnableBinaryCache(const std::string& dir);
+    static void DisableBinaryCache();
+
+    static const ShaderLoadStats& GetLoadStats()     { return smLoadStats; }
+
+    // Connect the uniform block with this name to a binding point in all programs loaded from
+    // now on (GLSL 3.30 has no layout(binding = N) for blocks).
+    static void SetBlockBinding(const std::string& blockName, GLuint binding);
+
     void activate() const;
     void deactivate() const;
 
@@ -42,6 +91,33 @@ public:
     void sendUniform(GLint location, const glm::vec4& vec);
     void sendUniform(GLint location, const glm::mat3& mat);
     void sendUniform(GLint location, const glm::mat4& mat);
+
+    friend class ShaderBatch;
+};
+
+//
+// Loads several programs at once.
+//
+// Every program's compile and link is submitted before any status is queried, so the driver
+// can work on all of them in parallel (KHR_parallel_shader_compile is used to poll for
+// completion where available). Programs must not be used before finish() returns.
+//
+class ShaderBatch {
+    std::vector<ShaderProgram*>     mPending;
+
+                    ShaderBatch(const ShaderBatch&);
+    ShaderBatch&    operator=(const ShaderBatch&);
+
+public:
+    ShaderBatch();
+
+    // create a program and start loading it (the caller owns the program)
+    ShaderProgram*  add(const std::string& vsPath, const std::string& fsPath, const std::string& defines = "");
+
+    // wait for all programs and check them, throwing on the first compile or link error
+    void            finish();
+
+    unsigned        getNumPending() const       { return mPending.size(); }
 };
 
 #endif
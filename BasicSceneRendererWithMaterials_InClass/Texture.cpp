@@ -1,36 +1,59 @@
 #include "Texture.h"
 #include "Image.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+namespace {
+
+// number of levels in a full mip chain
+int MipLevels(int width, int height)
+{
+    int levels = 1;
+    for (int size = std::max(width, height); size > 1; size /= 2)
+        ++levels;
+    return levels;
+}
+
+}
 
 Texture::Texture()
     : mTexId(0)
+    , mWrapMode(GL_REPEAT)
+    , mFilteringMode(GL_LINEAR)
+    , mWidth(0)
+    , mHeight(0)
+    , mBytesPerPixel(0)
+    , mNumLevels(0)
+    , mBaseLevel(0)
 {
 }
 
 Texture::Texture(const std::string& fname, GLint wrapMode, GLint filteringMode)
     : mTexId(0)
+    , mPath(fname)
+    , mWrapMode(wrapMode)
+    , mFilteringMode(filteringMode)
+    , mWidth(0)
+    , mHeight(0)
+    , mBytesPerPixel(0)
+    , mNumLevels(0)
+    , mBaseLevel(0)
 {
+    PROFILE_ZONE("Texture::load");
+
     Image img;
     if (img.LoadTarga(fname)) {
-        // create texture object
-        glGenTextures(1, &mTexId);
+        mWidth = img.getWidth();
+        mHeight = img.getHeight();
+        mBytesPerPixel = img.getBytesPerPixel();
+        mNumLevels = 1;
 
-        // activate this texture
-        glBindTexture(GL_TEXTURE_2D, mTexId);
+        // count the full mip chain if a mipmapped filter was requested
+        if (filteringMode != GL_NEAREST && filteringMode != GL_LINEAR)
+            mNumLevels = MipLevels(mWidth, mHeight);
 
-        // the Image class does not pad rows, so set most flexible alignment
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-        // upload texture data
-        glTexImage2D(GL_TEXTURE_2D, 0, GetTextureType(img), img.getWidth(), img.getHeight(),
-                                    0, GetTextureType(img), GL_UNSIGNED_BYTE, img.getData());
-
-        // configure wrap mode
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
-
-        // configure filtering
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filteringMode);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filteringMode);
+        upload(img);
     }
 }
 
@@ -39,3 +62,51 @@ Texture::~Texture()
     if (mTexId)
         glDeleteTextures(1, &mTexId);
 }
+
+void Texture::upload(const Image& img) const
+{
+    // immutable storage can't be resized, so every upload gets a new texture object
+    if (mTexId)
+        glDeleteTextures(1, &mTexId);
+    glGenTextures(1, &mTexId);
+
+    // activate this texture
+    glBindTexture(GL_TEXTURE_2D, mTexId);
+
+    // the Image class does not pad rows, so set most flexible alignment
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    GLenum type = GetTextureType(img);
+    int numLevels = mNumLevels > 1 ? MipLevels(img.getWidth(), img.getHeight()) : 1;
+
+    if (GLEW_ARB_texture_storage) {
+        // allocate all levels up front, then upload the base level
+        glTexStorage2D(GL_TEXTURE_2D, numLevels, GetSizedTextureFormat(type), img.getWidth(), img.getHeight());
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, img.getWidth(), img.getHeight(),
+                                      type, GL_UNSIGNED_BYTE, img.getData());
+
+        if (type == GL_LUMINANCE) {
+            GLint swizzle[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+            glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        }
+    } else {
+        // upload texture data
+        glTexImage2D(GL_TEXTURE_2D, 0, type, img.getWidth(), img.getHeight(),
+                                    0, type, GL_UNSIGNED_BYTE, img.getData());
+
+        // tell the driver up front how many levels to expect
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+    }
+
+    if (numLevels > 1)
+        glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+void Texture::setBaseLevel(int level, const Image& img) const
+{
+    if (!mTexId)
+        return;
+
+    upload(img);
+    mBaseLevel = level;
+}
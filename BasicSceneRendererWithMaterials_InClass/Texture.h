@@ -4,8 +4,29 @@
 #include "glshell.h"
 #include <string>
 
+class Image;
+
+//
+// Texture storage is immutable when ARB_texture_storage is available; wrap and filtering modes
+// are only recorded here and applied through sampler objects (see SamplerCache) at bind time.
+//
 class Texture {
-    GLuint mTexId;
+    mutable GLuint mTexId;      // replaced whenever the texture is re-uploaded at a different size
+
+    // source file and sampling state, kept so the texture can be re-uploaded at a different resolution
+    std::string mPath;
+    GLint mWrapMode;
+    GLint mFilteringMode;
+
+    int mWidth, mHeight;        // full resolution size
+    int mBytesPerPixel;
+    int mNumLevels;             // mip levels at full resolution (1 if not mipmapped)
+
+    // number of top mip levels currently dropped (0 = full resolution).
+    // Residency changes are allowed through const pointers held by materials, which read id() when binding.
+    mutable int mBaseLevel;
+
+    void upload(const Image& img) const;
 
 public:
     Texture();
@@ -16,6 +37,19 @@ public:
     GLuint id() const           { return mTexId; }
 
     bool isValid() const        { return mTexId > 0; }
+
+    const std::string& getPath() const  { return mPath; }
+    GLint getWrapMode() const           { return mWrapMode; }
+    GLint getFilteringMode() const      { return mFilteringMode; }
+    int getWidth() const                { return mWidth; }
+    int getHeight() const               { return mHeight; }
+    int getBytesPerPixel() const        { return mBytesPerPixel; }
+    int getNumLevels() const            { return mNumLevels; }
+    int getBaseLevel() const            { return mBaseLevel; }
+
+    // replace the texture with 'img', the image from its file downsampled 'level' times
+    // (0 restores full resolution); the file is read by the caller, see TextureManager
+    void setBaseLevel(int level, const Image& img) const;
 };
 
 #endif
@@ -0,0 +1,190 @@
+#include "TextureArray.h"
+#include "Image.h"
+
+#include <cstring>
+#include <iostream>
+#include <map>
+
+TextureArray::TextureArray(int width, int height, GLenum format, int numLayers, GLint wrapMode, GLint filteringMode)
+    : mTexId(0)
+    , mWidth(width)
+    , mHeight(height)
+    , mFormat(format)
+    , mNumLayers(numLayers)
+    , mWrapMode(wrapMode)
+    , mFilteringMode(filteringMode)
+{
+    // create texture object
+    glGenTextures(1, &mTexId);
+
+    // activate this texture
+    glBindTexture(GL_TEXTURE_2D_ARRAY, mTexId);
+
+    // allocate storage for all layers (contents are uploaded later with setLayer)
+    if (GLEW_ARB_texture_storage) {
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GetSizedTextureFormat(format), width, height, numLayers);
+
+        if (format == GL_LUMINANCE) {
+            GLint swizzle[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+            glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        }
+    } else {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, format, width, height, numLayers,
+                                          0, format, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+    }
+}
+
+TextureArray::~TextureArray()
+{
+    if (mTexId)
+        glDeleteTextures(1, &mTexId);
+}
+
+void TextureArray::setLayer(int layer, const Image& img)
+{
+    glBindTexture(GL_TEXTURE_2D_ARRAY, mTexId);
+
+    // the Image class does not pad rows, so set most flexible alignment
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, mWidth, mHeight, 1,
+                                         mFormat, GL_UNSIGNED_BYTE, img.getData());
+}
+
+
+//
+// helpers for grouping images
+//
+
+namespace {
+
+struct ArrayKey {
+    int     width, height;
+    GLenum  format;
+    GLint   wrapMode;
+    GLint   filteringMode;
+
+    bool operator<(const ArrayKey& k) const
+    {
+        if (width != k.width)           return width < k.width;
+        if (height != k.height)         return height < k.height;
+        if (format != k.format)         return format < k.format;
+        if (wrapMode != k.wrapMode)     return wrapMode < k.wrapMode;
+        return filteringMode < k.filteringMode;
+    }
+};
+
+// a solid color image samples the same at any size, so shrink it to a single texel
+// (this lets all the solid color swatches share one tiny 1x1 array)
+void CollapseSolidColor(Image& img)
+{
+    int bpp = img.getBytesPerPixel();
+    int numPixels = img.getWidth() * img.getHeight();
+    const char* data = img.getData();
+
+    if (numPixels <= 1)
+        return;
+
+    for (int i = 1; i < numPixels; i++) {
+        if (std::memcmp(data, data + i * bpp, bpp) != 0)
+            return;
+    }
+
+    char texel[4];
+    std::memcpy(texel, data, bpp);
+    img.Allocate(1, 1, bpp);
+    std::memcpy(img.getData(), texel, bpp);
+}
+
+}
+
+
+TextureArrayPacker::TextureArrayPacker()
+{
+}
+
+TextureArrayPacker::~TextureArrayPacker()
+{
+    clear();
+}
+
+int TextureArrayPacker::add(const std::string& fname, GLint wrapMode, GLint filteringMode)
+{
+    Slot slot;
+    slot.fname = fname;
+    slot.wrapMode = wrapMode;
+    slot.filteringMode = filteringMode;
+    slot.array = NULL;
+    slot.layer = -1;
+
+    mSlots.push_back(slot);
+    return (int)mSlots.size() - 1;
+}
+
+void TextureArrayPacker::build()
+{
+    std::vector<Image*> images(mSlots.size(), (Image*)NULL);
+    std::map<ArrayKey, std::vector<int> > groups;
+
+    // load everything that hasn't been packed yet and sort it into groups
+    for (unsigned i = 0; i < mSlots.size(); i++) {
+        if (mSlots[i].array)
+            continue;
+
+        Image* img = new Image;
+        if (!img->LoadTarga(mSlots[i].fname)) {
+            delete img;
+            continue;
+        }
+
+        CollapseSolidColor(*img);
+
+        ArrayKey key;
+        key.width = img->getWidth();
+        key.height = img->getHeight();
+        key.format = GetTextureType(*img);
+        key.wrapMode = mSlots[i].wrapMode;
+        key.filteringMode = mSlots[i].filteringMode;
+
+        // sampling state makes no difference to a single texel, so let all of those share an array
+        if (key.width == 1 && key.height == 1) {
+            key.wrapMode = GL_REPEAT;
+            key.filteringMode = GL_NEAREST;
+        }
+
+        images[i] = img;
+        groups[key].push_back(i);
+    }
+
+    // upload one array per group
+    std::map<ArrayKey, std::vector<int> >::const_iterator it;
+    for (it = groups.begin(); it != groups.end(); ++it) {
+        const ArrayKey& key = it->first;
+        const std::vector<int>& members = it->second;
+
+        TextureArray* array = new TextureArray(key.width, key.height, key.format, (int)members.size(),
+                                               key.wrapMode, key.filteringMode);
+        mArrays.push_back(array);
+
+        for (unsigned layer = 0; layer < members.size(); layer++) {
+            Slot& slot = mSlots[members[layer]];
+            array->setLayer(layer, *images[members[layer]]);
+            slot.array = array;
+            slot.layer = layer;
+        }
+    }
+
+    for (unsigned i = 0; i < images.size(); i++)
+        delete images[i];
+
+    std::cout << "Packed " << mSlots.size() << " textures into " << mArrays.size() << " texture arrays" << std::endl;
+}
+
+void TextureArrayPacker::clear()
+{
+    for (unsigned i = 0; i < mArrays.size(); i++)
+        delete mArrays[i];
+    mArrays.clear();
+    mSlots.clear();
+}
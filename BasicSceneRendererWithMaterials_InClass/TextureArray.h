@@ -0,0 +1,81 @@
+#ifndef TEXTURE_ARRAY_H_
+#define TEXTURE_ARRAY_H_
+
+#include "glshell.h"
+#include <string>
+#include <vector>
+
+class Image;
+
+//
+// A GL_TEXTURE_2D_ARRAY whose layers all share the same size, format and sampling state.
+// The sampling state is only recorded; it is applied through a sampler object at bind time.
+// Materials reference a (TextureArray, layer) pair instead of owning a texture,
+// so any number of materials can be drawn with a single texture binding.
+//
+class TextureArray {
+    GLuint  mTexId;
+    int     mWidth, mHeight;
+    GLenum  mFormat;
+    int     mNumLayers;
+    GLint   mWrapMode;
+    GLint   mFilteringMode;
+
+public:
+    TextureArray(int width, int height, GLenum format, int numLayers, GLint wrapMode, GLint filteringMode);
+    ~TextureArray();
+
+    // copy an image into the given layer (image must match the array's size and format)
+    void setLayer(int layer, const Image& img);
+
+    GLuint id() const           { return mTexId; }
+    int getWidth() const        { return mWidth; }
+    int getHeight() const       { return mHeight; }
+    GLenum getFormat() const    { return mFormat; }
+    int getNumLayers() const    { return mNumLayers; }
+    GLint getWrapMode() const       { return mWrapMode; }
+    GLint getFilteringMode() const  { return mFilteringMode; }
+};
+
+
+//
+// Groups textures that have the same dimensions, format and sampling state into texture arrays.
+//
+// Usage:
+//   int slot = packer.add("textures/white.tga");   // queue any number of files
+//   packer.build();                                 // load, group and upload
+//   material->setTextureLayer(packer.getArray(slot), packer.getLayer(slot));
+//
+class TextureArrayPacker {
+
+    struct Slot {
+        std::string     fname;
+        GLint           wrapMode;
+        GLint           filteringMode;
+        TextureArray*   array;
+        int             layer;
+    };
+
+    std::vector<Slot>           mSlots;
+    std::vector<TextureArray*>  mArrays;    // owned
+
+public:
+    TextureArrayPacker();
+    ~TextureArrayPacker();
+
+    // queue a texture file for packing; returns a slot index valid after build()
+    int add(const std::string& fname, GLint wrapMode = GL_REPEAT, GLint filteringMode = GL_LINEAR);
+
+    // load all queued images and upload them into as few texture arrays as possible
+    void build();
+
+    // release all texture arrays and queued slots
+    void clear();
+
+    const TextureArray* getArray(int slot) const    { return mSlots[slot].array; }
+    int getLayer(int slot) const                    { return mSlots[slot].layer; }
+
+    unsigned getNumArrays() const                   { return mArrays.size(); }
+};
+
+#endif
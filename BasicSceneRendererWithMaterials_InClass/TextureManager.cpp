@@ -0,0 +1,368 @@
+#include "TextureManager.h"
+#include "Image.h"
+#include "Profiler.h"
+#include "TextureArray.h"
+
+#include <algorithm>
+
+namespace {
+
+// orders entry ids from least to most recently used
+struct LeastRecentlyUsed {
+    const std::vector<unsigned>& lastUsed;
+
+    LeastRecentlyUsed(const std::vector<unsigned>& lastUsed) : lastUsed(lastUsed) { }
+
+    bool operator()(int a, int b) const
+    {
+        return lastUsed[a] < lastUsed[b];
+    }
+};
+
+int FormatBytesPerPixel(GLenum format)
+{
+    switch (format) {
+    case GL_LUMINANCE:
+        return 1;
+    case GL_RGB:
+        return 3;
+    default:
+        return 4;
+    }
+}
+
+}
+
+
+TextureManager::TextureManager(size_t budgetBytes)
+    : mBudget(budgetBytes)
+    , mResidentBytes(0)
+    , mTargetBytes(0)
+    , mFrame(0)
+    , mLoaderQuit(false)
+{
+}
+
+TextureManager::~TextureManager()
+{
+    stopLoader();
+}
+
+int TextureManager::add(const Texture* tex)
+{
+    if (!tex || !tex->isValid())
+        return -1;
+
+    // already registered?
+    std::map<const Texture*, int>::const_iterator it = mIds.find(tex);
+    if (it != mIds.end())
+        return it->second;
+
+    int id = add(tex->getWidth(), tex->getHeight(), tex->getBytesPerPixel(), tex->getNumLevels());
+
+    Entry& e = mEntries[id];
+    e.tex = tex;
+    mResidentBytes -= entryBytes(e);
+    mTargetBytes -= entryBytes(e);
+    e.baseLevel = e.targetLevel = tex->getBaseLevel();
+    mResidentBytes += entryBytes(e);
+    mTargetBytes += entryBytes(e);
+
+    mIds[tex] = id;
+    return id;
+}
+
+int TextureManager::add(const TextureArray* array)
+{
+    if (!array || !array->id())
+        return -1;
+
+    std::map<const TextureArray*, int>::const_iterator it = mArrayIds.find(array);
+    if (it != mArrayIds.end())
+        return it->second;
+
+    int id = add(array->getWidth(), array->getHeight(), FormatBytesPerPixel(array->getFormat()), 1, array->getNumLayers());
+
+    // also pin arrays of a single layer
+    Entry& e = mEntries[id];
+    e.array = array;
+    e.fallbackLevel = 0;
+
+    mArrayIds[array] = id;
+    return id;
+}
+
+int TextureManager::add(int width, int height, int bytesPerPixel, int numLevels, int numLayers)
+{
+    Entry e;
+    e.tex = NULL;
+    e.array = NULL;
+    e.width = width;
+    e.height = height;
+    e.bytesPerPixel = bytesPerPixel;
+    e.numLevels = numLevels;
+    e.numLayers = numLayers;
+    e.baseLevel = 0;
+    e.targetLevel = 0;
+    e.lastUsedFrame = mFrame;
+
+    // the policy never reduces an entry that is already at its fallback, which pins layered ones
+    e.fallbackLevel = numLayers > 1 ? 0 : FallbackLevel(width, height);
+
+    mEntries.push_back(e);
+    mResidentBytes += entryBytes(e);
+    mTargetBytes += entryBytes(e);
+
+    return (int)mEntries.size() - 1;
+}
+
+void TextureManager::clear()
+{
+    stopLoader();
+
+    mEntries.clear();
+    mIds.clear();
+    mArrayIds.clear();
+    mResidentBytes = 0;
+    mTargetBytes = 0;
+    mStats = TextureResidencyStats();
+}
+
+void TextureManager::beginFrame()
+{
+    ++mFrame;
+    mStats.numDemotions = 0;
+    mStats.numPromotions = 0;
+}
+
+void TextureManager::touch(const Texture* tex)
+{
+    std::map<const Texture*, int>::const_iterator it = mIds.find(tex);
+    if (it != mIds.end())
+        mEntries[it->second].lastUsedFrame = mFrame;
+}
+
+void TextureManager::touch(int id)
+{
+    if (id >= 0 && id < (int)mEntries.size())
+        mEntries[id].lastUsedFrame = mFrame;
+}
+
+void TextureManager::endFrame()
+{
+    PROFILE_ZONE("TextureManager::endFrame");
+
+    applyLoads();
+
+    std::vector<unsigned> lastUsed(mEntries.size());
+    for (unsigned i = 0; i < mEntries.size(); i++)
+        lastUsed[i] = mEntries[i].lastUsedFrame;
+
+    // entries with a reload in flight are left alone until it lands
+    if (mTargetBytes > mBudget) {
+
+        // over budget: shrink the least recently used textures first
+        std::vector<int> order;
+        for (unsigned i = 0; i < mEntries.size(); i++) {
+            const Entry& e = mEntries[i];
+            if (e.targetLevel == e.baseLevel && e.baseLevel < e.fallbackLevel)
+                order.push_back(i);
+        }
+        std::stable_sort(order.begin(), order.end(), LeastRecentlyUsed(lastUsed));
+
+        for (unsigned k = 0; k < order.size() && mTargetBytes > mBudget; k++) {
+            const Entry& e = mEntries[order[k]];
+
+            // find the smallest reduction that fits, so the file is only reloaded once
+            size_t others = mTargetBytes - levelBytes(e, e.targetLevel);
+            int level = e.targetLevel;
+            while (level < e.fallbackLevel && others + levelBytes(e, level) > mBudget)
+                ++level;
+
+            mStats.numDemotions += level - e.targetLevel;
+            setTargetLevel(order[k], level);
+        }
+
+    } else {
+
+        // under budget: give textures used this frame their levels back, one at a time
+        std::vector<int> order;
+        for (unsigned i = 0; i < mEntries.size(); i++) {
+            const Entry& e = mEntries[i];
+            if (e.targetLevel == e.baseLevel && e.baseLevel > 0 && e.lastUsedFrame == mFrame)
+                order.push_back(i);
+        }
+
+        for (unsigned k = 0; k < order.size() && (int)mStats.numPromotions < MAX_PROMOTIONS_PER_FRAME; k++) {
+            const Entry& e = mEntries[order[k]];
+
+            size_t others = mTargetBytes - levelBytes(e, e.targetLevel);
+            if (others + levelBytes(e, e.targetLevel - 1) <= mBudget) {
+                setTargetLevel(order[k], e.targetLevel - 1);
+                ++mStats.numPromotions;
+            }
+        }
+    }
+
+    // refresh statistics
+    mStats.budgetBytes = mBudget;
+    mStats.residentBytes = mResidentBytes;
+    mStats.fullResBytes = 0;
+    mStats.numTextures = mEntries.size();
+    mStats.numArrays = 0;
+    mStats.numFullRes = 0;
+    mStats.numReduced = 0;
+    mStats.numFallback = 0;
+    mStats.numLoading = 0;
+
+    for (unsigned i = 0; i < mEntries.size(); i++) {
+        const Entry& e = mEntries[i];
+        mStats.fullResBytes += levelBytes(e, 0);
+        if (e.array || e.numLayers > 1)
+            ++mStats.numArrays;
+        if (e.targetLevel != e.baseLevel)
+            ++mStats.numLoading;
+        if (e.baseLevel == 0)
+            ++mStats.numFullRes;
+        else if (e.baseLevel >= e.fallbackLevel)
+            ++mStats.numFallback;
+        else
+            ++mStats.numReduced;
+    }
+}
+
+size_t TextureManager::getResidentBytes(int id) const
+{
+    return entryBytes(mEntries[id]);
+}
+
+size_t TextureManager::levelBytes(const Entry& e, int baseLevel) const
+{
+    return ResidentBytes(e.width, e.height, e.bytesPerPixel, e.numLevels, baseLevel) * e.numLayers;
+}
+
+void TextureManager::setTargetLevel(int id, int level)
+{
+    Entry& e = mEntries[id];
+
+    mTargetBytes -= levelBytes(e, e.targetLevel);
+    e.targetLevel = level;
+    mTargetBytes += levelBytes(e, e.targetLevel);
+
+    // accounting-only entries change at once
+    if (!e.tex) {
+        mResidentBytes -= entryBytes(e);
+        e.baseLevel = level;
+        mResidentBytes += entryBytes(e);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mLoadMutex);
+    if (!mLoader.joinable()) {
+        mLoaderQuit = false;
+        mLoader = std::thread(&TextureManager::loaderMain, this);
+    }
+
+    LoadRequest request = { id, e.tex->getPath(), level };
+    mLoadRequests.push_back(request);
+    mLoadReady.notify_one();
+}
+
+void TextureManager::applyLoads()
+{
+    std::vector<LoadResult> results;
+    {
+        std::lock_guard<std::mutex> lock(mLoadMutex);
+        results.swap(mLoadResults);
+    }
+
+    for (unsigned i = 0; i < results.size(); i++) {
+        const LoadResult& r = results[i];
+        Entry& e = mEntries[r.id];
+
+        if (r.img) {
+            e.tex->setBaseLevel(r.level, *r.img);
+            mResidentBytes -= entryBytes(e);
+            e.baseLevel = r.level;
+            mResidentBytes += entryBytes(e);
+            delete r.img;
+        } else {
+            // the file can't be reloaded, leave the texture as it is
+            mTargetBytes -= levelBytes(e, e.targetLevel);
+            e.targetLevel = e.baseLevel;
+            mTargetBytes += levelBytes(e, e.targetLevel);
+        }
+    }
+}
+
+void TextureManager::stopLoader()
+{
+    if (mLoader.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mLoadMutex);
+            mLoaderQuit = true;
+        }
+        mLoadReady.notify_one();
+        mLoader.join();
+    }
+
+    // whatever is still queued or loaded belongs to the entries being dropped
+    for (unsigned i = 0; i < mLoadResults.size(); i++)
+        delete mLoadResults[i].img;
+    mLoadResults.clear();
+    mLoadRequests.clear();
+}
+
+void TextureManager::loaderMain()
+{
+    for (;;) {
+        LoadRequest request;
+        {
+            std::unique_lock<std::mutex> lock(mLoadMutex);
+            while (!mLoaderQuit && mLoadRequests.empty())
+                mLoadReady.wait(lock);
+            if (mLoaderQuit)
+                return;
+            request = mLoadRequests.front();
+            mLoadRequests.pop_front();
+        }
+
+        // not profiled: captures are written between frames, while this thread may be loading
+        LoadResult result = { request.id, request.level, new Image };
+        if (result.img->LoadTarga(request.path)) {
+            result.img->Downsample(request.level);
+        } else {
+            delete result.img;
+            result.img = NULL;
+        }
+
+        std::lock_guard<std::mutex> lock(mLoadMutex);
+        mLoadResults.push_back(result);
+    }
+}
+
+size_t TextureManager::LevelBytes(int width, int height, int bytesPerPixel, int level)
+{
+    size_t w = std::max(width >> level, 1);
+    size_t h = std::max(height >> level, 1);
+    return w * h * bytesPerPixel;
+}
+
+size_t TextureManager::ResidentBytes(int width, int height, int bytesPerPixel, int numLevels, int baseLevel)
+{
+    if (numLevels <= 1)
+        return LevelBytes(width, height, bytesPerPixel, baseLevel);
+
+    size_t total = 0;
+    for (int level = baseLevel; level < numLevels; level++)
+        total += LevelBytes(width, height, bytesPerPixel, level);
+    return total;
+}
+
+int TextureManager::FallbackLevel(int width, int height)
+{
+    int level = 0;
+    while (std::max(width >> (level + 1), height >> (level + 1)) >= FALLBACK_SIZE)
+        ++level;
+    return level;
+}
@@ -0,0 +1,172 @@
+#ifndef TEXTURE_MANAGER_H_
+#define TEXTURE_MANAGER_H_
+
+#include "Texture.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Image;
+class TextureArray;
+
+//
+// Residency statistics, updated by TextureManager::endFrame()
+//
+struct TextureResidencyStats {
+    size_t      budgetBytes;
+    size_t      residentBytes;      // bytes currently uploaded
+    size_t      fullResBytes;       // bytes if every texture were at full resolution
+
+    unsigned    numTextures;
+    unsigned    numArrays;          // texture arrays, counted in full and never reduced
+    unsigned    numFullRes;         // textures with all mip levels resident
+    unsigned    numReduced;         // textures with some top mip levels dropped
+    unsigned    numFallback;        // textures reduced all the way to the low-res fallback
+    unsigned    numLoading;         // textures waiting for a reload
+
+    unsigned    numDemotions;       // levels dropped during the last frame
+    unsigned    numPromotions;      // levels restored during the last frame
+
+    TextureResidencyStats()
+        : budgetBytes(0), residentBytes(0), fullResBytes(0)
+        , numTextures(0), numArrays(0), numFullRes(0), numReduced(0), numFallback(0), numLoading(0)
+        , numDemotions(0), numPromotions(0)
+    { }
+};
+
+
+//
+// Keeps the memory used by textures under a budget.
+//
+// The draw loop calls touch() for every texture it binds, between beginFrame() and endFrame().
+// When the resident total exceeds the budget, endFrame() drops top mip levels from the least
+// recently used textures, down to a small fallback that is never evicted. Textures that are in
+// use get their levels back, a few per frame, once there is room in the budget again.
+//
+// A texture changes size by reloading its file at the new level. The file is read and
+// downsampled on a loader thread, and a later endFrame() uploads the result, so the render
+// thread never waits on the disk. The budget is checked against the levels asked for, so
+// loads in flight are not asked for twice.
+//
+// Texture arrays are counted at their full size (every layer) but never reduced, their
+// layers can't be resized one by one.
+//
+// The bookkeeping does not touch GL. Entries registered without a Texture are tracked for
+// accounting only and change level at once, which also makes it possible to exercise the
+// policy without a GL context (see SelfTest.cpp).
+//
+class TextureManager {
+public:
+    // textures are never reduced below this size (in texels along the largest dimension)
+    static const int    FALLBACK_SIZE = 16;
+
+    // maximum number of levels restored per frame (each one reloads a file)
+    static const int    MAX_PROMOTIONS_PER_FRAME = 2;
+
+    explicit TextureManager(size_t budgetBytes);
+    ~TextureManager();
+
+    // register a texture; returns its entry id
+    int                 add(const Texture* tex);
+
+    // register a texture array (counted, never reduced); returns its entry id
+    int                 add(const TextureArray* array);
+
+    // register an accounting-only entry (pinned like an array if it has layers); returns its entry id
+    int                 add(int width, int height, int bytesPerPixel, int numLevels, int numLayers = 1);
+
+    // stop tracking everything (reloads in flight are dropped)
+    void                clear();
+
+    void                setBudget(size_t budgetBytes)       { mBudget = budgetBytes; }
+    size_t              getBudget() const                   { return mBudget; }
+
+    void                beginFrame();
+    void                touch(const Texture* tex);
+    void                touch(int id);
+    void                endFrame();
+
+    const TextureResidencyStats& getStats() const           { return mStats; }
+
+    // resident level, and the level asked for (they differ while a reload is in flight)
+    int                 getBaseLevel(int id) const          { return mEntries[id].baseLevel; }
+    int                 getTargetLevel(int id) const        { return mEntries[id].targetLevel; }
+    size_t              getResidentBytes(int id) const;
+    unsigned            getLastUsedFrame(int id) const      { return mEntries[id].lastUsedFrame; }
+
+    // size of a single mip level
+    static size_t       LevelBytes(int width, int height, int bytesPerPixel, int level);
+
+    // size of levels [baseLevel, numLevels) if mipmapped, or of the single reduced image otherwise
+    static size_t       ResidentBytes(int width, int height, int bytesPerPixel, int numLevels, int baseLevel);
+
+    // lowest level that is still at least FALLBACK_SIZE texels (or the 1x1 level)
+    static int          FallbackLevel(int width, int height);
+
+private:
+    struct Entry {
+        const Texture*      tex;        // NULL for arrays and accounting-only entries
+        const TextureArray* array;
+        int                 width, height;
+        int                 bytesPerPixel;
+        int                 numLevels;
+        int                 numLayers;
+        int                 baseLevel;
+        int                 targetLevel;    // differs from baseLevel while a reload is in flight
+        int                 fallbackLevel;
+        unsigned            lastUsedFrame;
+    };
+
+    // a level to load on the loader thread, and what came of it (img is NULL if the load failed)
+    struct LoadRequest {
+        int                 id;
+        std::string         path;
+        int                 level;
+    };
+
+    struct LoadResult {
+        int                 id;
+        int                 level;
+        Image*              img;
+    };
+
+    size_t              levelBytes(const Entry& e, int baseLevel) const;
+    size_t              entryBytes(const Entry& e) const        { return levelBytes(e, e.baseLevel); }
+    void                setTargetLevel(int id, int level);
+
+    // upload the reloads that are done
+    void                applyLoads();
+
+    void                stopLoader();
+    void                loaderMain();
+
+    std::vector<Entry>                      mEntries;
+    std::map<const Texture*, int>           mIds;
+    std::map<const TextureArray*, int>      mArrayIds;
+
+    size_t                          mBudget;
+    size_t                          mResidentBytes;
+    size_t                          mTargetBytes;       // at the levels asked for
+    unsigned                        mFrame;
+
+    std::thread                     mLoader;            // started by the first reload
+    std::mutex                      mLoadMutex;
+    std::condition_variable         mLoadReady;         // a request, or time to quit
+    std::deque<LoadRequest>         mLoadRequests;
+    std::vector<LoadResult>         mLoadResults;
+    bool                            mLoaderQuit;
+
+    TextureResidencyStats           mStats;
+
+    // not copyable (owns the loader thread)
+                        TextureManager(const TextureManager&);
+    TextureManager&     operator=(const TextureManager&);
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include "UniformRing.h"
+
+#include <cstring>
+#include <iostream>
+
+UniformRing::UniformRing()
+    : mBuffer(0)
+    , mBinding(0)
+    , mRecordSize(0)
+    , mStride(0)
+    , mRecordsPerFrame(0)
+    , mNumFrames(0)
+    , mMapped(NULL)
+    , mFences(NULL)
+    , mFrame(0)
+    , mNumRecords(0)
+    , mNumStalls(0)
+    , mOverflowReported(false)
+{
+}
+
+UniformRing::~UniformRing()
+{
+    destroy();
+}
+
+bool UniformRing::create(GLuint binding, GLsizeiptr recordSize, unsigned recordsPerFrame, unsigned numFrames)
+{
+    destroy();
+
+    // each record starts at a multiple of the uniform buffer offset alignment
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    mStride = (recordSize + alignment - 1) / alignment * alignment;
+
+    mBinding = binding;
+    mRecordSize = recordSize;
+    mRecordsPerFrame = recordsPerFrame;
+    mNumFrames = numFrames;
+
+    GLsizeiptr size = mStride * recordsPerFrame * numFrames;
+
+    glGenBuffers(1, &mBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+
+    if (GLEW_ARB_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, size, NULL, flags);
+        mMapped = (char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags);
+    } else {
+        glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_STREAM_DRAW);
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    mFences = new GLsync[numFrames];
+    for (unsigned i = 0; i < numFrames; i++)
+        mFences[i] = 0;
+
+    // the first beginFrame moves to region 0
+    mFrame = numFrames - 1;
+    mNumRecords = 0;
+
+    return mBuffer != 0;
+}
+
+void UniformRing::destroy()
+{
+    if (mFences) {
+        for (unsigned i = 0; i < mNumFrames; i++) {
+            if (mFences[i])
+                glDeleteSync(mFences[i]);
+        }
+        delete [] mFences;
+        mFences = NULL;
+    }
+
+    if (mBuffer) {
+        if (mMapped) {
+            glBindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            mMapped = NULL;
+        }
+        glDeleteBuffers(1, &mBuffer);
+        mBuffer = 0;
+    }
+}
+
+void UniformRing::beginFrame()
+{
+    if (!mFences)
+        return;
+
+    mFrame = (mFrame + 1) % mNumFrames;
+    mNumRecords = 0;
+
+    GLsync& fence = mFences[mFrame];
+    if (!fence)
+        return;
+
+    // usually signaled long ago; otherwise the GPU is more than numFrames - 1 frames behind
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+        ++mNumStalls;
+        do {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);     // 1 ms
+        } while (result == GL_TIMEOUT_EXPIRED);
+    }
+
+    glDeleteSync(fence);
+    fence = 0;
+}
+
+void UniformRing::endFrame()
+{
+    if (!mFences)
+        return;
+
+    mFences[mFrame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool UniformRing::push(const void* data)
+{
+    if (!mFences)
+        return false;
+
+    if (mNumRecords >= mRecordsPerFrame) {
+        if (!mOverflowReported) {
+            std::cerr << "*** Uniform ring is full (" << mRecordsPerFrame << " records per frame)" << std::endl;
+            mOverflowReported = true;
+        }
+        return false;
+    }
+
+    GLintptr offset = (mFrame * mRecordsPerFrame + mNumRecords) * mStride;
+    ++mNumRecords;
+
+    if (mMapped) {
+        std::memcpy(mMapped + offset, data, mRecordSize);
+    } else {
+        // the fences guarantee the GPU is not reading this range, so don't let the driver wait
+        glBindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+        void* ptr = glMapBufferRange(GL_UNIFORM_BUFFER, offset, mRecordSize,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (ptr) {
+            std::memcpy(ptr, data, mRecordSize);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, mBinding, mBuffer, offset, mRecordSize);
+    return true;
+}
@@ -0,0 +1,65 @@
+#ifndef UNIFORM_RING_H_
+#define UNIFORM_RING_H_
+
+#include "glshell.h"
+
+//
+// A ring of uniform buffer regions for data that changes with every draw.
+//
+// Each frame writes its records one after another into its own region and binds each one to a
+// uniform block binding point just before the draw that reads it. There are several regions
+// (3 by default), so the CPU fills one while the GPU still reads the others; a fence per region
+// makes sure a region is not overwritten before the GPU is done with it.
+//
+// With ARB_buffer_storage the buffer stays mapped (persistent and coherent), so writing a record
+// is a plain memcpy. Otherwise each record is written with an unsynchronized glMapBufferRange.
+//
+// A ring that was never created (or was destroyed) ignores beginFrame and endFrame, and push
+// fails, so callers can run the same frame loop whether or not they set it up.
+//
+class UniformRing {
+    GLuint          mBuffer;
+    GLuint          mBinding;           // uniform block binding point
+    GLsizeiptr      mRecordSize;
+    GLsizeiptr      mStride;            // record size rounded up to the offset alignment
+    unsigned        mRecordsPerFrame;
+    unsigned        mNumFrames;
+
+    char*           mMapped;            // persistent mapping, or NULL
+    GLsync*         mFences;            // one per region
+
+    unsigned        mFrame;             // region being written
+    unsigned        mNumRecords;        // records written to it so far
+
+    unsigned        mNumStalls;         // times beginFrame had to wait for the GPU
+    bool            mOverflowReported;
+
+                    UniformRing(const UniformRing&);
+    UniformRing&    operator=(const UniformRing&);
+
+public:
+    UniformRing();
+    ~UniformRing();
+
+    // allocate the regions; records are bound to the given uniform block binding point
+    bool            create(GLuint binding, GLsizeiptr recordSize, unsigned recordsPerFrame, unsigned numFrames = 3);
+
+    void            destroy();
+
+    // move to the next region, waiting until the GPU has finished reading it
+    void            beginFrame();
+
+    // fence the region written this frame
+    void            endFrame();
+
+    // write a record and bind it for the next draw; returns false if the frame's region is full
+    bool            push(const void* data);
+
+    bool            isPersistent() const        { return mMapped != NULL; }
+    GLsizeiptr      getFrameBytes() const       { return mStride * mRecordsPerFrame; }
+    unsigned        getNumFrames() const        { return mNumFrames; }
+    unsigned        getNumRecords() const       { return mNumRecords; }
+    unsigned        getNumStalls() const        { return mNumStalls; }
+};
+
+#endif
@@ -12,6 +12,9 @@ enum VertexAttribIndex {
     VA_NORMAL    = 1,
     VA_COLOR     = 2,
     VA_TEXCOORD  = 3,
+
+    // per-instance mat4, one column in each of locations 4 to 7
+    VA_TRANSFORM = 4,
 };
 
 
@@ -1,5 +1,6 @@
 #include "common.h"
 
+#include <cstdlib>
 #include <fstream>
 #include <sstream>
 
@@ -27,6 +28,57 @@ std::string ReadTextFile(const std::string& fname)
     return ss.str();
 }
 
+std::string CanonicalPath(const std::string& path)
+{
+    std::vector<std::string> segments;
+    std::string segment;
+
+    bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\');
+
+    for (size_t i = 0; i <= path.size(); i++) {
+        if (i == path.size() || path[i] == '/' || path[i] == '\\') {
+            if (segment == "..") {
+                if (!segments.empty() && segments.back() != "..")
+                    segments.pop_back();
+                else if (!absolute)
+                    segments.push_back(segment);
+            } else if (!segment.empty() && segment != ".") {
+                segments.push_back(segment);
+            }
+            segment.clear();
+        } else {
+            segment += path[i];
+        }
+    }
+
+    std::string result = absolute ? "/" : "";
+    for (unsigned i = 0; i < segments.size(); i++) {
+        if (i > 0)
+            result += '/';
+        result += segments[i];
+    }
+    return result;
+}
+
+std::string GetEnv(const std::string& name)
+{
+    std::string value;
+#ifdef _MSC_VER
+    // getenv is deprecated there
+    char* buf = NULL;
+    size_t len = 0;
+    if (_dupenv_s(&buf, &len, name.c_str()) == 0 && buf) {
+        value = buf;
+        free(buf);
+    }
+#else
+    const char* buf = std::getenv(name.c_str());
+    if (buf)
+        value = buf;
+#endif
+    return value;
+}
+
 
 std::vector<std::string> Tokenize(const std::string& str)
 {
@@ -20,6 +20,17 @@ const float PI = 3.14159265f;
 
 std::string ReadTextFile(const std::string& fname);
 
+// normalize a relative or absolute path: forward slashes, no "." or empty segments, ".." resolved where possible
+std::string CanonicalPath(const std::string& path);
+
+
+//
+// Environment
+//
+
+// value of an environment variable, empty if it is not set
+std::string GetEnv(const std::string& name);
+
 
 //
 // string handling stuff
@@ -1,9 +1,19 @@
 #include "glshell.h"
+#include "Image.h"
+#include "InputRecorder.h"
+#include "Profiler.h"
 
 #include <memory>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
+
+// the headless shell needs EGL, which is not part of the Windows build
+#ifdef GLSHELL_USE_EGL
+#  include <EGL/egl.h>
+#  include <EGL/eglext.h>
+#endif
 
 std::vector<GLShell*>       GLShell::smShells;
 
@@ -21,6 +31,10 @@ std::vector<KeyCode>        GLShell::smSpecialKeys(256, KC_UNKNOWN);
 
 std::vector<MouseButton>    GLShell::smMouseButtons(8, MOUSE_BUTTON_UNKNOWN);
 
+InputRecorder*              GLShell::smInputRecorder = NULL;
+
+bool                        GLShell::smHeadless = false;
+
 
 Keyboard::Keyboard()
     : mCurrKeyState(KC_NUM_KEYS, false)
@@ -93,6 +107,18 @@ void Keyboard::clear()
     std::fill(mCurrKeyState.begin(), mCurrKeyState.end(), false);
 }
 
+void Keyboard::getState(KeyboardState& state) const
+{
+    state.keys = mCurrKeyState;
+    state.prevKeys = mPrevKeyState;
+}
+
+void Keyboard::setState(const KeyboardState& state)
+{
+    mCurrKeyState = state.keys;
+    mPrevKeyState = state.prevKeys;
+}
+
 
 Mouse::Mouse()
     : mCurrButtonState(MOUSE_NUM_BUTTONS, false)
@@ -206,6 +232,40 @@ void Mouse::clear()
     std::fill(mCurrButtonState.begin(), mCurrButtonState.end(), false);
 }
 
+void Mouse::getState(MouseState& state) const
+{
+    state.buttons = 0;
+    state.prevButtons = 0;
+    for (unsigned i = 0; i < mCurrButtonState.size(); i++) {
+        state.buttons |= (unsigned)mCurrButtonState[i] << i;
+        state.prevButtons |= (unsigned)mPrevButtonState[i] << i;
+    }
+
+    state.x = mCurrX;
+    state.y = mCurrY;
+    state.prevX = mPrevX;
+    state.prevY = mPrevY;
+    state.deltaX = mDeltaX;
+    state.deltaY = mDeltaY;
+    state.wheelDelta = mWheelDelta;
+}
+
+void Mouse::setState(const MouseState& state)
+{
+    for (unsigned i = 0; i < mCurrButtonState.size(); i++) {
+        mCurrButtonState[i] = (state.buttons >> i & 1) != 0;
+        mPrevButtonState[i] = (state.prevButtons >> i & 1) != 0;
+    }
+
+    mCurrX = state.x;
+    mCurrY = state.y;
+    mPrevX = state.prevX;
+    mPrevY = state.prevY;
+    mDeltaX = state.deltaX;
+    mDeltaY = state.deltaY;
+    mWheelDelta = state.wheelDelta;
+}
+
 
 GLApp::GLApp() 
     : mShell(NULL)
@@ -258,6 +318,23 @@ bool GLShell::update()
     float deltaT = t - mTime;
     mTime = t;
 
+    return update(deltaT);
+}
+
+bool GLShell::update(float deltaT)
+{
+    PROFILE_ZONE("GLShell::update");
+
+    if (smInputRecorder) {
+        if (smInputRecorder->isReplaying()) {
+            // recorded input and time step in place of the live ones, until the log runs out
+            if (!smInputRecorder->replayFrame(mKeyboard, mMouse, deltaT))
+                return false;
+        } else if (smInputRecorder->isRecording()) {
+            smInputRecorder->recordFrame(mKeyboard, mMouse, deltaT);
+        }
+    }
+
     if (mApp.update(deltaT)) {
         mKeyboard.update();
         mMouse.update();
@@ -477,6 +554,20 @@ int GLShell::CreateWindow(const std::string& title, int width, int height)
     return windowId;
 }
 
+void GLShell::SetInputRecorder(InputRecorder* recorder)
+{
+    smInputRecorder = recorder;
+}
+
+void* GLShell::GetProcAddress(const char* name)
+{
+#ifdef GLSHELL_USE_EGL
+    if (smHeadless)
+        return (void*)eglGetProcAddress(name);
+#endif
+    return (void*)glutGetProcAddress(name);
+}
+
 void GLShell::Run(GLApp& app, const std::string& title, int width, int height)
 {
     bool wasInitialized = glutGet(GLUT_INIT_STATE) == 1;
@@ -514,6 +605,231 @@ void GLShell::Run(GLApp& app, const std::string& title, int width, int height)
         glutMainLoop();
 }
 
+#ifdef GLSHELL_USE_EGL
+
+//
+// context for the headless shell: Mesa's surfaceless platform needs neither a display server
+// nor a GPU, other drivers get the default display; either way it is made current without a
+// surface (EGL_KHR_surfaceless_context) and the app draws into a framebuffer object
+//
+struct HeadlessContext {
+    EGLDisplay      display;
+    EGLContext      context;
+};
+
+static bool CreateHeadlessContext(HeadlessContext& hc)
+{
+    hc.display = EGL_NO_DISPLAY;
+    hc.context = EGL_NO_CONTEXT;
+
+    EGLint major, minor;
+
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay)
+        hc.display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+
+    if (hc.display == EGL_NO_DISPLAY || !eglInitialize(hc.display, &major, &minor)) {
+        hc.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (hc.display == EGL_NO_DISPLAY || !eglInitialize(hc.display, &major, &minor)) {
+            std::cerr << "*** Failed to initialize an EGL display" << std::endl;
+            return false;
+        }
+    }
+
+    // desktop GL, not GLES
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "*** EGL display does not support OpenGL" << std::endl;
+        eglTerminate(hc.display);
+        return false;
+    }
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(hc.display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0) {
+        std::cerr << "*** No EGL config supports OpenGL" << std::endl;
+        eglTerminate(hc.display);
+        return false;
+    }
+
+    // the same kind of context the window gets from freeglut
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+        EGL_NONE
+    };
+    hc.context = eglCreateContext(hc.display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (hc.context == EGL_NO_CONTEXT) {
+        std::cerr << "*** Failed to create an OpenGL 3.3 context (EGL error 0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+        eglTerminate(hc.display);
+        return false;
+    }
+
+    if (!eglMakeCurrent(hc.display, EGL_NO_SURFACE, EGL_NO_SURFACE, hc.context)) {
+        std::cerr << "*** Failed to make the context current without a surface (EGL error 0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+        eglDestroyContext(hc.display, hc.context);
+        eglTerminate(hc.display);
+        return false;
+    }
+
+    return true;
+}
+
+static void DestroyHeadlessContext(HeadlessContext& hc)
+{
+    eglMakeCurrent(hc.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(hc.display, hc.context);
+    eglTerminate(hc.display);
+}
+
+//
+// color and depth/stencil renderbuffers in place of the window's back buffer;
+// returns the framebuffer (left bound), or 0 on failure
+//
+static GLuint CreateOffscreenFramebuffer(int width, int height, GLuint renderbuffers[2])
+{
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "*** Offscreen framebuffer is incomplete (status 0x" << std::hex << status << std::dec << ")" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(2, renderbuffers);
+        return 0;
+    }
+
+    return fbo;
+}
+
+// save the color buffer of a framebuffer as a TGA image
+static bool SaveFramebuffer(GLuint fbo, int width, int height, const std::string& path)
+{
+    Image img;
+    img.Allocate(width, height, 4);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, img.getData());
+
+    return img.SaveTarga(path);
+}
+
+#endif
+
+int GLShell::RunHeadless(GLApp& app, const HeadlessSettings& settings)
+{
+#ifdef GLSHELL_USE_EGL
+    HeadlessContext hc;
+    if (!CreateHeadlessContext(hc))
+        return 1;
+
+    // GLEW loads the GL entry points before it looks for a GLX or WGL context, and fails
+    // there because this context has neither; the entry points are all the app needs
+    GLenum status = glewInit();
+    if (status != GLEW_OK && !GLEW_VERSION_3_3) {
+        std::cerr << "*** GLEW Error: " << glewGetErrorString(status) << std::endl;
+        DestroyHeadlessContext(hc);
+        return 1;
+    }
+
+    GLuint renderbuffers[2];
+    GLuint fbo = CreateOffscreenFramebuffer(settings.width, settings.height, renderbuffers);
+    if (!fbo) {
+        DestroyHeadlessContext(hc);
+        return 1;
+    }
+
+    GLShell* shell = new GLShell(app, 0);   // glut window ids start at 1
+    smHeadless = true;
+
+    int result = 0;
+    int numFrames = 0;
+    float startTime = GetTime();
+
+    // don't let any application exceptions escape this point
+    try {
+        app.initialize();
+        app.resize(settings.width, settings.height);
+        if (settings.checkGLErrors)
+            CHECK_GL_ERRORS("initialize");
+
+        while (numFrames < settings.numFrames && shell->update(settings.deltaT)) {
+            {
+                PROFILE_ZONE("GLShell::display");
+
+                // the app draws into whatever framebuffer is bound, as it would into the window's
+                glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+                app.draw();
+            }
+
+            if (!settings.dumpPrefix.empty() && numFrames % settings.dumpInterval == 0) {
+                std::ostringstream path;
+                path << settings.dumpPrefix << std::setw(5) << std::setfill('0') << numFrames << ".tga";
+                if (!SaveFramebuffer(fbo, settings.width, settings.height, path.str()))
+                    result = 1;
+            }
+
+            if (settings.checkGLErrors)
+                CHECK_GL_ERRORS("headless frame");
+
+            ++numFrames;
+        }
+
+        glFinish();
+
+    } catch (const std::exception& e) {
+        std::cerr << "*** Exception\n" << e.what() << "\n*** End of Exception" << std::endl;
+        result = 1;
+    }
+
+    float elapsed = GetTime() - startTime;
+    std::cout << "Drew " << numFrames << " frames in " << elapsed << " s";
+    if (numFrames > 0)
+        std::cout << " (" << 1000.0f * elapsed / numFrames << " ms per frame)";
+    std::cout << std::endl;
+
+    try {
+        app.shutdown();
+        if (settings.checkGLErrors)
+            CHECK_GL_ERRORS("shutdown");
+    } catch (const std::exception& e) {
+        std::cerr << "*** Exception\n" << e.what() << "\n*** End of Exception" << std::endl;
+        result = 1;
+    }
+
+    delete shell;
+    smHeadless = false;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(2, renderbuffers);
+
+    DestroyHeadlessContext(hc);
+
+    return result;
+#else
+    std::cerr << "*** Headless mode is not supported by this build (define GLSHELL_USE_EGL)" << std::endl;
+    return 1;
+#endif
+}
+
 void GLShell::WindowReshapeCallback(int w, int h)
 {
     GLShell* shell = static_cast<GLShell*>(glutGetWindowData());
@@ -680,6 +996,8 @@ void GLShell::MouseEntryCallback(int state)
 
 void GLShell::DisplayCallback()
 {
+    PROFILE_ZONE("GLShell::display");
+
     GLShell* shell = static_cast<GLShell*>(glutGetWindowData());
 
     // don't let any application exceptions escape this callback
@@ -44,6 +44,7 @@
 
 class GLShell;
 class GLApp;
+class InputRecorder;
 
 
 /**
@@ -87,6 +88,28 @@ enum MouseButton {
 };
 
 
+/** \brief Everything an application can query from a Keyboard in one frame.
+    Used to record and replay input, see InputRecorder.
+*/
+struct KeyboardState {
+    std::vector<bool>   keys;               // down in this frame, indexed by KeyCode
+    std::vector<bool>   prevKeys;           // down in the previous frame
+};
+
+
+/** \brief Everything an application can query from a Mouse in one frame.
+    Used to record and replay input, see InputRecorder.
+*/
+struct MouseState {
+    unsigned            buttons;            // a bit per MouseButton down in this frame
+    unsigned            prevButtons;        // ...and in the previous frame
+    int                 x, y;
+    int                 prevX, prevY;
+    int                 deltaX, deltaY;
+    int                 wheelDelta;
+};
+
+
 /** \brief A class that encapsulates the current keyboard state.
 
     A Keyboard object is used by the GLShell to communicate the keyboard status and events
@@ -159,6 +182,11 @@ public:
      */
     void                clear();
 
+    /** Get or replace the whole state, to record input or play it back.
+     */
+    void                getState(KeyboardState& state) const;
+    void                setState(const KeyboardState& state);
+
     //@}
 
 private:
@@ -331,6 +359,11 @@ public:
      */
     void                clear();
 
+    /** Get or replace the whole state, to record input or play it back.
+     */
+    void                getState(MouseState& state) const;
+    void                setState(const MouseState& state);
+
     //@}
 
 private:
@@ -405,6 +438,27 @@ inline int Mouse::getWheelDelta() const
     return mWheelDelta;
 }
 
+/** \brief Settings of a headless run, see GLShell::RunHeadless().
+*/
+struct HeadlessSettings {
+    int                 width, height;      // size of the offscreen framebuffer
+    int                 numFrames;          // frames to update and draw before shutting down
+    float               deltaT;             // time step passed to every update, in seconds
+
+    std::string         dumpPrefix;         // frames are saved as <prefix>NNNNN.tga, nothing if empty
+    int                 dumpInterval;       // save every n-th frame
+
+    bool                checkGLErrors;      // fail the run on a GL error left by initialize, a frame or shutdown
+
+    HeadlessSettings()
+        : width(800), height(600)
+        , numFrames(100), deltaT(1.0f / 60.0f)
+        , dumpInterval(1)
+        , checkGLErrors(false)
+    { }
+};
+
+
 /**
 
 shell = window + input handlers
@@ -425,6 +479,32 @@ public:
 
     static void         Run(GLApp& app, const std::string& title, int width, int height);
 
+    /** Run the app without a window, for render farms and CI machines.
+        @remarks
+            The app draws into an offscreen framebuffer of an EGL context that needs no
+            display server.  It is updated with a fixed time step for a fixed number of
+            frames, and no input, so runs are repeatable.  Needs a build with
+            GLSHELL_USE_EGL defined and linked with libEGL, like the Linux one (see Makefile).
+        @return
+            A process exit code: 0 if all frames were drawn.
+     */
+    static int          RunHeadless(GLApp& app, const HeadlessSettings& settings);
+
+    /** Record the input of every frame into a log, or replay one in place of the live input.
+        @remarks
+            The recorder sees the keyboard, mouse and time step right before each GLApp::update
+            and, when replaying, replaces them with the recorded ones.  The app is stopped
+            after the last recorded frame.  Pass NULL for live input again.
+     */
+    static void         SetInputRecorder(InputRecorder* recorder);
+
+    /** Address of a GL extension function of the current context, or NULL.
+        @remarks
+            Goes through glut for windows and EGL for headless runs, where glut is never
+            initialized.
+     */
+    static void*        GetProcAddress(const char* name);
+
     static float        GetTime();
 
 private:
@@ -439,6 +519,7 @@ private:
     Mouse&              getMouse();
 
     bool                update();
+    bool                update(float deltaT);
 
     void                lostFocus();
     void                gainFocus();
@@ -493,6 +574,10 @@ private:
     static std::vector<KeyCode>     smSpecialKeys;
 
     static std::vector<MouseButton> smMouseButtons;
+
+    static InputRecorder*           smInputRecorder;
+
+    static bool                     smHeadless;     // inside RunHeadless
 };
 
 
@@ -1,7 +1,278 @@
 #include "BasicSceneRenderer.h"
+#include "InputRecorder.h"
+#include "MicroBench.h"
+#include "SelfTest.h"
+#include "common.h"
 
-int main()
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+//
+// usage: BasicScene [--record FILE | --replay FILE]
+//        BasicScene --headless [--frames N] [--dt SECONDS] [--size WxH] [--dump PREFIX [--dump-every N]] [--replay FILE] [--check]
+//        BasicScene --benchmark [--scenes NAME,...] [--frames N] [--size WxH] [--out FILE]
+//        BasicScene --microbench [--filter TEXT] [--min-time SECONDS]
+//        BasicScene --selftest [--filter TEXT]
+//
+// Without options the scene opens in a window as usual. The input of a session can be recorded
+// and replayed later, in the window or headless, with the recorded time steps; a replay ends
+// with the last recorded frame unless --frames stops it earlier. A benchmark runs the built-in scenes
+// (or the ones named) headless, and writes their results to benchmark.json or FILE. The
+// micro-benchmarks (see MicroBenchmarks) time the loaders and math on their own and print
+// the results. The self-tests (see SelfTest.h) check the optimized code paths and exit with 1
+// on failure. A headless run with --check does the same for the GL side: it fails on any GL
+// error, and unless the GPU profiler read back pass times for the frames it drew.
+//
+// The headless modes need a build with GLSHELL_USE_EGL, like the Linux one (see Makefile).
+//
+struct Options {
+    HeadlessSettings    settings;
+    bool                framesGiven;
+    bool                check;
+
+    std::string         scenes;
+    std::string         outPath;
+    std::string         replayPath;
+
+    Options()
+        : framesGiven(false)
+        , check(false)
+        , outPath("benchmark.json")
+    { }
+};
+
+static bool ParseArgs(int argc, char** argv, bool benchmark, Options& options)
+{
+    HeadlessSettings& settings = options.settings;
+
+    for (int i = 2; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!benchmark && !std::strcmp(arg, "--check")) {
+            options.check = true;
+            settings.checkGLErrors = true;
+            continue;
+        }
+
+        if (!value) {
+            std::cerr << "*** Missing value for " << arg << std::endl;
+            return false;
+        }
+
+        bool ok = true;
+        if (!std::strcmp(arg, "--frames")) {
+            settings.numFrames = std::atoi(value);
+            options.framesGiven = true;
+        } else if (!std::strcmp(arg, "--size")) {
+            ok = std::sscanf(value, "%dx%d", &settings.width, &settings.height) == 2
+                && settings.width > 0 && settings.height > 0;
+        } else if (!benchmark && !std::strcmp(arg, "--dt")) {
+            settings.deltaT = (float)std::atof(value);
+        } else if (!benchmark && !std::strcmp(arg, "--dump")) {
+            settings.dumpPrefix = value;
+        } else if (!benchmark && !std::strcmp(arg, "--dump-every")) {
+            settings.dumpInterval = std::atoi(value);
+            ok = settings.dumpInterval > 0;
+        } else if (!benchmark && !std::strcmp(arg, "--replay")) {
+            options.replayPath = value;
+        } else if (benchmark && !std::strcmp(arg, "--scenes")) {
+            options.scenes = value;
+        } else if (benchmark && !std::strcmp(arg, "--out")) {
+            options.outPath = value;
+        } else {
+            std::cerr << "*** Unknown option " << arg << std::endl;
+            return false;
+        }
+
+        if (!ok) {
+            std::cerr << "*** Bad value for " << arg << ": " << value << std::endl;
+            return false;
+        }
+        ++i;
+    }
+
+    return true;
+}
+
+static int RunBenchmark(BasicSceneRenderer& app, Options& options)
 {
+    std::vector<BenchmarkScene> scenes;
+    if (options.scenes.empty()) {
+        scenes = SceneBenchmark::GetScenes();
+    } else {
+        std::string names = options.scenes;
+        std::replace(names.begin(), names.end(), ',', ' ');
+        std::vector<std::string> tokens = Tokenize(names);
+        for (unsigned i = 0; i < tokens.size(); i++) {
+            const BenchmarkScene* scene = SceneBenchmark::FindScene(tokens[i]);
+            if (!scene) {
+                std::cerr << "*** Unknown benchmark scene '" << tokens[i] << "'" << std::endl;
+                return 1;
+            }
+            scenes.push_back(*scene);
+        }
+    }
+
+    // the run ends after the last frame of the last scene
+    int framesPerScene = options.settings.numFrames;
+    options.settings.numFrames = 0;
+    for (unsigned i = 0; i < scenes.size(); i++) {
+        if (options.framesGiven)
+            scenes[i].numFrames = framesPerScene;
+        options.settings.numFrames += scenes[i].numFrames;
+    }
+
+    app.setBenchmarkScenes(scenes);
+
+    int result = GLShell::RunHeadless(app, options.settings);
+    if (result == 0 && !app.getBenchmark().writeJson(options.outPath, options.settings))
+        result = 1;
+
+    return result;
+}
+
+// after a headless run with --check: every frame drawn was measured, and the ones old enough
+// to read back were read (or counted as not ready), with sane pass times
+static bool CheckGpuProfiler(const GpuProfiler& profiler)
+{
+    if (!profiler.getNumFrames()) {
+        std::cerr << "*** GPU profiler: no frames measured (no timer queries?)" << std::endl;
+        return false;
+    }
+
+    unsigned expected = std::max((int)profiler.getNumFrames() - GpuProfiler::NUM_FRAMES, 0);
+    if (profiler.getNumRead() + profiler.getNumDropped() != expected) {
+        std::cerr << "*** GPU profiler: " << profiler.getNumRead() << " frames read and " << profiler.getNumDropped()
+                  << " dropped of " << profiler.getNumFrames() << " measured, expected " << expected << " in all" << std::endl;
+        return false;
+    }
+
+    if (!profiler.getNumRead()) {
+        std::cerr << "*** GPU profiler: no results read back (draw more than " << GpuProfiler::NUM_FRAMES << " frames)" << std::endl;
+        return false;
+    }
+
+    bool ok = profiler.getNumPasses() > 0;
+    std::cout << "GPU passes:";
+    for (unsigned i = 0; i < profiler.getNumPasses(); i++) {
+        double ms = profiler.getPassMillis(i);
+        std::cout << (i ? ", " : " ") << profiler.getPassName(i) << " " << ms << " ms";
+        ok = ok && ms >= 0 && ms < 60000;
+    }
+    std::cout << " (" << profiler.getNumRead() << " frames read, " << profiler.getNumDropped() << " not ready in time)" << std::endl;
+
+    if (!ok)
+        std::cerr << "*** GPU profiler: missing or impossible pass times" << std::endl;
+    return ok;
+}
+
+static int RunMicroBenchmarks(int argc, char** argv)
+{
+    std::string filter;
+    double minSeconds = 0.5;
+
+    for (int i = 2; i < argc; i += 2) {
+        if (i + 1 >= argc) {
+            std::cerr << "*** Missing value for " << argv[i] << std::endl;
+            return 1;
+        }
+        if (!std::strcmp(argv[i], "--filter")) {
+            filter = argv[i + 1];
+        } else if (!std::strcmp(argv[i], "--min-time")) {
+            minSeconds = std::atof(argv[i + 1]);
+        } else {
+            std::cerr << "*** Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    MicroBenchmarks bench(filter, minSeconds);
+
+    // LoadMesh needs a GL context; without EGL a small window provides one and closes when done
+#ifdef GLSHELL_USE_EGL
+    HeadlessSettings settings;
+    settings.numFrames = 0;
+    if (GLShell::RunHeadless(bench, settings) != 0)
+        return 1;
+#else
+    GLShell::Run(bench, "Micro-benchmarks", 320, 240);
+#endif
+
+    return bench.getNumRun() > 0 ? 0 : 1;
+}
+
+static int RunSelfTestsFromArgs(int argc, char** argv)
+{
+    std::string filter;
+
+    if (argc == 4 && !std::strcmp(argv[2], "--filter")) {
+        filter = argv[3];
+    } else if (argc != 2) {
+        std::cerr << "*** Usage: " << argv[0] << " --selftest [--filter TEXT]" << std::endl;
+        return 1;
+    }
+
+    return RunSelfTests(filter);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && !std::strcmp(argv[1], "--microbench"))
+        return RunMicroBenchmarks(argc, argv);
+    if (argc > 1 && !std::strcmp(argv[1], "--selftest"))
+        return RunSelfTestsFromArgs(argc, argv);
+
     BasicSceneRenderer app;
+    InputRecorder recorder;
+
+    bool headless = argc > 1 && !std::strcmp(argv[1], "--headless");
+    bool benchmark = argc > 1 && !std::strcmp(argv[1], "--benchmark");
+
+    if (headless || benchmark) {
+        Options options;
+        if (!ParseArgs(argc, argv, benchmark, options))
+            return 1;
+
+        if (benchmark)
+            return RunBenchmark(app, options);
+
+        if (!options.replayPath.empty()) {
+            if (!recorder.startReplay(options.replayPath))
+                return 1;
+            GLShell::SetInputRecorder(&recorder);
+            if (!options.framesGiven)
+                options.settings.numFrames = INT_MAX;
+        }
+
+        int result = GLShell::RunHeadless(app, options.settings);
+        GLShell::SetInputRecorder(NULL);
+
+        if (result == 0 && options.check && !CheckGpuProfiler(app.getGpuProfiler()))
+            result = 1;
+        return result;
+    }
+
+    bool record = argc > 1 && !std::strcmp(argv[1], "--record");
+    bool replay = argc > 1 && !std::strcmp(argv[1], "--replay");
+
+    if (record || replay) {
+        if (argc != 3) {
+            std::cerr << "*** Usage: " << argv[0] << " " << argv[1] << " FILE" << std::endl;
+            return 1;
+        }
+        if (!(record ? recorder.startRecording(argv[2]) : recorder.startReplay(argv[2])))
+            return 1;
+        GLShell::SetInputRecorder(&recorder);
+    } else if (argc > 1) {
+        std::cerr << "*** Unknown option " << argv[1] << std::endl;
+        return 1;
+    }
+
     GLShell::Run(app, "Basic Scene Renderer", 800, 600);
+    GLShell::SetInputRecorder(NULL);
 }
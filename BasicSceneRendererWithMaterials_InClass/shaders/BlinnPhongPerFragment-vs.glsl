@@ -1,13 +1,57 @@
 #version 330
 
+#ifdef MULTI_DRAW
+#extension GL_ARB_shader_draw_parameters : require
+#endif
+
 layout(location = 0) in vec4 in_Position;
 layout(location = 1) in vec3 in_Normal;
 layout(location = 3) in vec2 in_TexCoord;
 
 // transformations
 uniform mat4 u_ProjectionMatrix;
-uniform mat4 u_ModelviewMatrix;
-uniform mat3 u_NormalMatrix;
+
+// per-draw data, written to a ring buffer by the renderer
+// (must match DrawData in BasicSceneRenderer.cpp, and be the same in every shader that declares it)
+#ifdef MULTI_DRAW
+// one record per command of a multi-draw call (see MultiDraw.h)
+struct DrawRecord {
+    mat4 modelview;
+    mat3 normalMatrix;
+    vec4 tint;
+    vec3 emissive;
+    int texLayer;
+    vec3 specular;
+    float shininess;
+};
+
+layout(std140) uniform PerDraw {
+    DrawRecord u_Draws[MULTI_DRAW];
+};
+
+// the vertex shader knows which command it is drawing, and passes it on
+flat out int var_DrawID;
+#define DRAW_INDEX gl_DrawIDARB
+
+// the rest of the shader reads the record by its usual names
+#define u_ModelviewMatrix   u_Draws[DRAW_INDEX].modelview
+#define u_NormalMatrix      u_Draws[DRAW_INDEX].normalMatrix
+#define u_Tint              u_Draws[DRAW_INDEX].tint
+#define u_MatEmissiveColor  u_Draws[DRAW_INDEX].emissive
+#define u_TexLayer          u_Draws[DRAW_INDEX].texLayer
+#define u_MatSpecularColor  u_Draws[DRAW_INDEX].specular
+#define u_MatShininess      u_Draws[DRAW_INDEX].shininess
+#else
+layout(std140) uniform PerDraw {
+    mat4 u_ModelviewMatrix;
+    mat3 u_NormalMatrix;
+    vec4 u_Tint;
+    vec3 u_MatEmissiveColor;
+    int u_TexLayer;             // layer in u_TexArraySampler, or -1 to use u_TexSampler
+    vec3 u_MatSpecularColor;
+    float u_MatShininess;
+};
+#endif
 
 // outputs to rasterizer
 out vec2 var_TexCoord;
@@ -27,4 +71,8 @@ void main()
 
 	// transform position to eye (camera) space
 	var_Pos = vec3(u_ModelviewMatrix * in_Position);
+
+#ifdef MULTI_DRAW
+	var_DrawID = gl_DrawIDARB;
+#endif
 }
@@ -0,0 +1,167 @@
+#version 330
+
+// directional light info
+struct DirLight {
+	vec3 color;
+	vec3 dir;
+};
+
+
+// inputs from rasterizer
+in vec2 var_TexCoord;		// interpolated texture coordinate
+in vec3 var_Normal;
+in vec3 var_Pos;    // vertex position in eye (camera) space
+
+uniform sampler2D u_TexSampler;
+uniform sampler2DArray u_TexArraySampler;
+
+// global light info
+uniform vec3 u_AmbientLightColor;
+
+const int MAX_DIR_LIGHTS = 4;
+
+uniform DirLight u_DirLights[MAX_DIR_LIGHTS];
+uniform int u_NumDirLights;
+
+// point lights, binned into view-space clusters on the CPU (see LightClusters)
+uniform samplerBuffer u_LightData;       // 3 texels per light: (pos, radius), (color, attConst), (attQuad, attLin, -, -)
+uniform usamplerBuffer u_ClusterData;    // per cluster: (offset into u_LightIndices, number of lights)
+uniform usamplerBuffer u_LightIndices;
+
+uniform int u_ClustersX;
+uniform int u_ClustersY;
+uniform int u_ClustersZ;
+uniform vec2 u_ClusterScale;        // clusters per pixel
+uniform float u_ClusterNear;        // distance to the first depth slice
+uniform float u_ClusterDepthScale;  // depth slices per unit of log(distance / u_ClusterNear)
+
+// per-draw data, written to a ring buffer by the renderer
+// (must match DrawData in BasicSceneRenderer.cpp, and be the same in every shader that declares it)
+#ifdef MULTI_DRAW
+// one record per command of a multi-draw call (see MultiDraw.h)
+struct DrawRecord {
+    mat4 modelview;
+    mat3 normalMatrix;
+    vec4 tint;
+    vec3 emissive;
+    int texLayer;
+    vec3 specular;
+    float shininess;
+};
+
+layout(std140) uniform PerDraw {
+    DrawRecord u_Draws[MULTI_DRAW];
+};
+
+flat in int var_DrawID;
+#define DRAW_INDEX var_DrawID
+
+// the rest of the shader reads the record by its usual names
+#define u_ModelviewMatrix   u_Draws[DRAW_INDEX].modelview
+#define u_NormalMatrix      u_Draws[DRAW_INDEX].normalMatrix
+#define u_Tint              u_Draws[DRAW_INDEX].tint
+#define u_MatEmissiveColor  u_Draws[DRAW_INDEX].emissive
+#define u_TexLayer          u_Draws[DRAW_INDEX].texLayer
+#define u_MatSpecularColor  u_Draws[DRAW_INDEX].specular
+#define u_MatShininess      u_Draws[DRAW_INDEX].shininess
+#else
+layout(std140) uniform PerDraw {
+    mat4 u_ModelviewMatrix;
+    mat3 u_NormalMatrix;
+    vec4 u_Tint;
+    vec3 u_MatEmissiveColor;
+    int u_TexLayer;             // layer in u_TexArraySampler, or -1 to use u_TexSampler
+    vec3 u_MatSpecularColor;
+    float u_MatShininess;
+};
+#endif
+
+// output to framebuffer
+out vec4 out_Color;
+
+
+float attenuate(float dist, float Q, float L, float C)
+{
+	return 1.0 / (Q * dist * dist + L * dist + C);
+}
+
+
+void main()
+{
+	// texture lookup
+    vec4 matColor = (u_TexLayer >= 0) ? texture(u_TexArraySampler, vec3(var_TexCoord, u_TexLayer))
+                                      : texture2D(u_TexSampler, var_TexCoord);
+
+	vec3 accumColor = u_MatEmissiveColor;
+
+	accumColor += u_AmbientLightColor * matColor.rgb;
+
+	// can remove these normalizations if we're absolutely sure that normals and light directions are unit vectors
+	vec3 N = normalize(var_Normal);	    // surface normal
+
+	vec3 E = normalize(-var_Pos);    // direction to camera
+
+	for (int i = 0; i < u_NumDirLights; i++) {
+
+		// can remove this normalization if we're absolutely sure that light directions are unit vectors
+		vec3 L = normalize(u_DirLights[i].dir);		// compute direction to light
+
+		// compute diffuse lighting intensity
+		float NdotL = dot(N, L);
+
+		if (NdotL > 0) {
+
+			accumColor += NdotL * u_DirLights[i].color * matColor.rgb;
+
+			vec3 H = normalize(E + L);
+
+			float NdotH = dot(N, H);
+
+			if (NdotH > 0) {
+				float blinnTerm = pow(NdotH, u_MatShininess);
+				accumColor += blinnTerm * u_DirLights[i].color * u_MatSpecularColor;
+			}
+		}
+	}
+
+	// find the cluster containing this fragment
+	ivec2 tile = clamp(ivec2(gl_FragCoord.xy * u_ClusterScale), ivec2(0), ivec2(u_ClustersX - 1, u_ClustersY - 1));
+	int slice = clamp(int(log(-var_Pos.z / u_ClusterNear) * u_ClusterDepthScale), 0, u_ClustersZ - 1);
+	int cluster = (slice * u_ClustersY + tile.y) * u_ClustersX + tile.x;
+
+	uvec2 lightRange = texelFetch(u_ClusterData, cluster).xy;
+
+	for (uint k = 0u; k < lightRange.y; k++) {
+
+		int light = 3 * int(texelFetch(u_LightIndices, int(lightRange.x + k)).x);
+
+		vec4 posRadius = texelFetch(u_LightData, light);
+		vec4 colorConst = texelFetch(u_LightData, light + 1);
+		vec4 quadLin = texelFetch(u_LightData, light + 2);
+
+		vec3 L = normalize(posRadius.xyz - var_Pos);		// direction to light
+
+		// compute diffuse lighting intensity
+		float NdotL = dot(N, L);
+
+		if (NdotL > 0) {
+
+			// distance to light
+			float dist = length(posRadius.xyz - var_Pos);
+			float attenuationFactor = attenuate(dist, quadLin.x, quadLin.y, colorConst.w);
+
+			vec3 lightIntensity = attenuationFactor * colorConst.rgb;
+
+			accumColor += NdotL * lightIntensity * matColor.rgb;
+
+			vec3 H = normalize(E + L);
+			float NdotH = dot(N, H);
+			if (NdotH > 0) {
+				float blinnTerm = pow(NdotH, u_MatShininess);
+				accumColor += blinnTerm * lightIntensity * u_MatSpecularColor;
+			}
+		}
+	}
+
+	out_Color = vec4(accumColor, 1.0);
+}
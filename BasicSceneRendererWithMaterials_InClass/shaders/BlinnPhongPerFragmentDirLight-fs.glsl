@@ -6,6 +6,7 @@ in vec3 var_Normal;
 in vec3 var_Pos;    // vertex position in eye (camera) space
 
 uniform sampler2D u_TexSampler;
+uniform sampler2DArray u_TexArraySampler;
 
 // global light info
 uniform vec3 u_AmbientLightColor;
@@ -14,10 +15,17 @@ uniform vec3 u_AmbientLightColor;
 uniform vec3 u_LightColor;
 uniform vec3 u_LightDir;
 
-// material properties
-uniform vec3 u_MatEmissiveColor;
-uniform vec3 u_MatSpecularColor;
-uniform float u_MatShininess;
+// per-draw data, written to a ring buffer by the renderer
+// (must match DrawData in BasicSceneRenderer.cpp, and be the same in every shader that declares it)
+layout(std140) uniform PerDraw {
+    mat4 u_ModelviewMatrix;
+    mat3 u_NormalMatrix;
+    vec4 u_Tint;
+    vec3 u_MatEmissiveColor;
+    int u_TexLayer;             // layer in u_TexArraySampler, or -1 to use u_TexSampler
+    vec3 u_MatSpecularColor;
+    float u_MatShininess;
+};
 
 // output to framebuffer
 out vec4 out_Color;
@@ -25,7 +33,8 @@ out vec4 out_Color;
 void main()
 {
 	// texture lookup
-    vec4 matColor = texture2D(u_TexSampler, var_TexCoord);
+    vec4 matColor = (u_TexLayer >= 0) ? texture(u_TexArraySampler, vec3(var_TexCoord, u_TexLayer))
+                                      : texture2D(u_TexSampler, var_TexCoord);
 
 	vec3 accumColor = u_MatEmissiveColor;
 
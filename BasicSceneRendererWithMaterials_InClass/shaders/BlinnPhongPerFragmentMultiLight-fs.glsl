@@ -1,5 +1,17 @@
 #version 330
 
+// Features can be fixed at compile time by ShaderVariants, which defines all of these;
+// the defaults pick everything at runtime from the uniforms.
+#ifndef TEXTURE_MODE
+#define TEXTURE_MODE 3      // 0 = untextured, 1 = 2D texture, 2 = texture array, 3 = chosen by u_TexLayer
+#endif
+#ifndef SPECULAR
+#define SPECULAR 1
+#endif
+#ifndef EMISSIVE
+#define EMISSIVE 1
+#endif
+
 // directional light info
 struct DirLight {
 	vec3 color;
@@ -22,6 +34,7 @@ in vec3 var_Normal;
 in vec3 var_Pos;    // vertex position in eye (camera) space
 
 uniform sampler2D u_TexSampler;
+uniform sampler2DArray u_TexArraySampler;
 
 // global light info
 uniform vec3 u_AmbientLightColor;
@@ -33,13 +46,27 @@ const int MAX_POINT_LIGHTS = 8;
 uniform DirLight u_DirLights[MAX_DIR_LIGHTS];
 uniform PointLight u_PointLights[MAX_POINT_LIGHTS];
 
+#ifndef NUM_DIR_LIGHTS
 uniform int u_NumDirLights;
-uniform int u_NumPointLights;
+#define NUM_DIR_LIGHTS u_NumDirLights
+#endif
 
-// material properties
-uniform vec3 u_MatEmissiveColor;
-uniform vec3 u_MatSpecularColor;
-uniform float u_MatShininess;
+#ifndef NUM_POINT_LIGHTS
+uniform int u_NumPointLights;
+#define NUM_POINT_LIGHTS u_NumPointLights
+#endif
+
+// per-draw data, written to a ring buffer by the renderer
+// (must match DrawData in BasicSceneRenderer.cpp, and be the same in every shader that declares it)
+layout(std140) uniform PerDraw {
+    mat4 u_ModelviewMatrix;
+    mat3 u_NormalMatrix;
+    vec4 u_Tint;
+    vec3 u_MatEmissiveColor;
+    int u_TexLayer;             // layer in u_TexArraySampler, or -1 to use u_TexSampler
+    vec3 u_MatSpecularColor;
+    float u_MatShininess;
+};
 
 // output to framebuffer
 out vec4 out_Color;
@@ -54,9 +81,22 @@ float attenuate(float dist, float Q, float L, float C)
 void main()
 {
 	// texture lookup
+#if TEXTURE_MODE == 0
+    vec4 matColor = vec4(1.0);
+#elif TEXTURE_MODE == 1
     vec4 matColor = texture2D(u_TexSampler, var_TexCoord);
-
+#elif TEXTURE_MODE == 2
+    vec4 matColor = texture(u_TexArraySampler, vec3(var_TexCoord, u_TexLayer));
+#else
+    vec4 matColor = (u_TexLayer >= 0) ? texture(u_TexArraySampler, vec3(var_TexCoord, u_TexLayer))
+                                      : texture2D(u_TexSampler, var_TexCoord);
+#endif
+
+#if EMISSIVE
 	vec3 accumColor = u_MatEmissiveColor;
+#else
+	vec3 accumColor = vec3(0.0);
+#endif
 
 	accumColor += u_AmbientLightColor * matColor.rgb;
 
@@ -65,7 +105,7 @@ void main()
 
 	vec3 E = normalize(-var_Pos);    // direction to camera
 
-	for (int i = 0; i < u_NumDirLights; i++) {
+	for (int i = 0; i < NUM_DIR_LIGHTS; i++) {
 
 		// can remove this normalization if we're absolutely sure that light directions are unit vectors
 		vec3 L = normalize(u_DirLights[i].dir);		// compute direction to light
@@ -77,6 +117,7 @@ void main()
 
 			accumColor += NdotL * u_DirLights[i].color * matColor.rgb;
 
+#if SPECULAR
 			vec3 H = normalize(E + L);
 
 			float NdotH = dot(N, H);
@@ -85,10 +126,11 @@ void main()
 				float blinnTerm = pow(NdotH, u_MatShininess);
 				accumColor += blinnTerm * u_DirLights[i].color * u_MatSpecularColor;
 			}
+#endif
 		}
 	}
 
-	for (int i = 0;  i < u_NumPointLights; i++) {
+	for (int i = 0;  i < NUM_POINT_LIGHTS; i++) {
 
 		vec3 L = normalize(u_PointLights[i].pos - var_Pos);		// direction to light
 
@@ -105,12 +147,14 @@ void main()
 
 			accumColor += NdotL * lightIntensity * matColor.rgb;
 
+#if SPECULAR
 			vec3 H = normalize(E + L);
 			float NdotH = dot(N, H);
 			if (NdotH > 0) {
 				float blinnTerm = pow(NdotH, u_MatShininess);
 				accumColor += blinnTerm * lightIntensity * u_MatSpecularColor;
 			}
+#endif
 		}
 	}
 
@@ -0,0 +1,21 @@
+#version 330
+
+// unit wireframe cube, drawn once per box
+layout(location=0) in vec4 in_Position;
+
+// per-instance attributes: color and the transformation from the unit cube to world space
+layout(location=2) in vec4 in_Color;
+layout(location=4) in mat4 in_Transform;
+
+// transformations
+uniform mat4 u_ProjectionMatrix;
+uniform mat4 u_ModelviewMatrix;
+
+// output for rasterizer
+out vec4 var_Color;
+
+void main()
+{
+    gl_Position = u_ProjectionMatrix * u_ModelviewMatrix * in_Transform * in_Position;
+    var_Color = in_Color;
+}
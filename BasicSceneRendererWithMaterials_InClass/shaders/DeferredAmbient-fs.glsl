@@ -0,0 +1,90 @@
+#version 330
+
+// directional light info
+struct DirLight {
+	vec3 color;
+	vec3 dir;
+};
+
+// G-buffer (see GBuffer.h)
+uniform sampler2D u_GBufAlbedo;
+uniform sampler2D u_GBufNormal;
+uniform sampler2D u_GBufSpecular;
+uniform sampler2D u_GBufEmissive;
+uniform sampler2D u_GBufDepth;
+
+// for reconstructing eye space positions from depth
+uniform mat4 u_InvProjectionMatrix;
+uniform vec2 u_ScreenSize;
+
+// global light info
+uniform vec3 u_AmbientLightColor;
+
+const int MAX_DIR_LIGHTS = 4;
+
+uniform DirLight u_DirLights[MAX_DIR_LIGHTS];
+uniform int u_NumDirLights;
+
+// must match DeferredGeometry-fs.glsl
+const float MAX_SHININESS = 256.0;
+
+// output to framebuffer
+out vec4 out_Color;
+
+
+vec3 eyePosition(float depth)
+{
+	vec4 ndc = vec4(2.0 * gl_FragCoord.xy / u_ScreenSize - 1.0, 2.0 * depth - 1.0, 1.0);
+	vec4 pos = u_InvProjectionMatrix * ndc;
+	return pos.xyz / pos.w;
+}
+
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+
+	// leave the background alone
+	float depth = texelFetch(u_GBufDepth, texel, 0).r;
+	if (depth == 1.0)
+		discard;
+
+	vec3 matColor = texelFetch(u_GBufAlbedo, texel, 0).rgb;
+	vec3 N = texelFetch(u_GBufNormal, texel, 0).xyz;
+	vec4 specular = texelFetch(u_GBufSpecular, texel, 0);
+	float shininess = specular.a * MAX_SHININESS;
+
+	vec3 E = normalize(-eyePosition(depth));    // direction to camera
+
+	vec3 accumColor = texelFetch(u_GBufEmissive, texel, 0).rgb;
+
+	accumColor += u_AmbientLightColor * matColor;
+
+	for (int i = 0; i < u_NumDirLights; i++) {
+
+		// can remove this normalization if we're absolutely sure that light directions are unit vectors
+		vec3 L = normalize(u_DirLights[i].dir);		// compute direction to light
+
+		// compute diffuse lighting intensity
+		float NdotL = dot(N, L);
+
+		if (NdotL > 0) {
+
+			accumColor += NdotL * u_DirLights[i].color * matColor;
+
+			vec3 H = normalize(E + L);
+
+			float NdotH = dot(N, H);
+
+			if (NdotH > 0) {
+				float blinnTerm = pow(NdotH, shininess);
+				accumColor += blinnTerm * u_DirLights[i].color * specular.rgb;
+			}
+		}
+	}
+
+	out_Color = vec4(accumColor, 1.0);
+
+	// copy the scene depth, so light volumes and debug geometry are depth tested against it
+	gl_FragDepth = depth;
+}
@@ -0,0 +1,71 @@
+#version 330
+
+// inputs from rasterizer
+in vec2 var_TexCoord;		// interpolated texture coordinate
+in vec3 var_Normal;
+in vec3 var_Pos;    // vertex position in eye (camera) space
+
+uniform sampler2D u_TexSampler;
+uniform sampler2DArray u_TexArraySampler;
+
+// per-draw data, written to a ring buffer by the renderer
+// (must match DrawData in BasicSceneRenderer.cpp, and be the same in every shader that declares it)
+#ifdef MULTI_DRAW
+// one record per command of a multi-draw call (see MultiDraw.h)
+struct DrawRecord {
+    mat4 modelview;
+    mat3 normalMatrix;
+    vec4 tint;
+    vec3 emissive;
+    int texLayer;
+    vec3 specular;
+    float shininess;
+};
+
+layout(std140) uniform PerDraw {
+    DrawRecord u_Draws[MULTI_DRAW];
+};
+
+flat in int var_DrawID;
+#define DRAW_INDEX var_DrawID
+
+// the rest of the shader reads the record by its usual names
+#define u_ModelviewMatrix   u_Draws[DRAW_INDEX].modelview
+#define u_NormalMatrix      u_Draws[DRAW_INDEX].normalMatrix
+#define u_Tint              u_Draws[DRAW_INDEX].tint
+#define u_MatEmissiveColor  u_Draws[DRAW_INDEX].emissive
+#define u_TexLayer          u_Draws[DRAW_INDEX].texLayer
+#define u_MatSpecularColor  u_Draws[DRAW_INDEX].specular
+#define u_MatShininess      u_Draws[DRAW_INDEX].shininess
+#else
+layout(std140) uniform PerDraw {
+    mat4 u_ModelviewMatrix;
+    mat3 u_NormalMatrix;
+    vec4 u_Tint;
+    vec3 u_MatEmissiveColor;
+    int u_TexLayer;             // layer in u_TexArraySampler, or -1 to use u_TexSampler
+    vec3 u_MatSpecularColor;
+    float u_MatShininess;
+};
+#endif
+
+// shininess is stored as a fraction of this (must match the other Deferred*-fs shaders)
+const float MAX_SHININESS = 256.0;
+
+// outputs to the G-buffer (see GBuffer.h)
+layout(location = 0) out vec4 out_Albedo;
+layout(location = 1) out vec4 out_Normal;
+layout(location = 2) out vec4 out_Specular;
+layout(location = 3) out vec4 out_Emissive;
+
+void main()
+{
+	// texture lookup
+    vec4 matColor = (u_TexLayer >= 0) ? texture(u_TexArraySampler, vec3(var_TexCoord, u_TexLayer))
+                                      : texture2D(u_TexSampler, var_TexCoord);
+
+	out_Albedo = vec4(matColor.rgb, 1.0);
+	out_Normal = vec4(normalize(var_Normal), 0.0);
+	out_Specular = vec4(u_MatSpecularColor, u_MatShininess / MAX_SHININESS);
+	out_Emissive = vec4(u_MatEmissiveColor, 1.0);
+}
@@ -0,0 +1,84 @@
+#version 330
+
+flat in int var_Light;
+
+// lights in eye space, 3 texels each: (pos, radius), (color, attConst), (attQuad, attLin, -, -)
+uniform samplerBuffer u_LightData;
+
+// G-buffer (see GBuffer.h)
+uniform sampler2D u_GBufAlbedo;
+uniform sampler2D u_GBufNormal;
+uniform sampler2D u_GBufSpecular;
+uniform sampler2D u_GBufDepth;
+
+// for reconstructing eye space positions from depth
+uniform mat4 u_InvProjectionMatrix;
+uniform vec2 u_ScreenSize;
+
+// must match DeferredGeometry-fs.glsl
+const float MAX_SHININESS = 256.0;
+
+// output to framebuffer (added to what is already there)
+out vec4 out_Color;
+
+
+float attenuate(float dist, float Q, float L, float C)
+{
+	return 1.0 / (Q * dist * dist + L * dist + C);
+}
+
+
+vec3 eyePosition(float depth)
+{
+	vec4 ndc = vec4(2.0 * gl_FragCoord.xy / u_ScreenSize - 1.0, 2.0 * depth - 1.0, 1.0);
+	vec4 pos = u_InvProjectionMatrix * ndc;
+	return pos.xyz / pos.w;
+}
+
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+
+	vec3 pos = eyePosition(texelFetch(u_GBufDepth, texel, 0).r);
+
+	vec4 posRadius = texelFetch(u_LightData, 3 * var_Light);
+	vec4 colorConst = texelFetch(u_LightData, 3 * var_Light + 1);
+	vec4 quadLin = texelFetch(u_LightData, 3 * var_Light + 2);
+
+	// the volume also covers surfaces in front of the light's sphere, skip those
+	float dist = length(posRadius.xyz - pos);
+	if (dist > posRadius.w)
+		discard;
+
+	vec3 matColor = texelFetch(u_GBufAlbedo, texel, 0).rgb;
+	vec3 N = texelFetch(u_GBufNormal, texel, 0).xyz;
+	vec4 specular = texelFetch(u_GBufSpecular, texel, 0);
+	float shininess = specular.a * MAX_SHININESS;
+
+	vec3 E = normalize(-pos);    // direction to camera
+	vec3 L = (posRadius.xyz - pos) / dist;		// direction to light
+
+	vec3 accumColor = vec3(0.0);
+
+	// compute diffuse lighting intensity
+	float NdotL = dot(N, L);
+
+	if (NdotL > 0) {
+
+		float attenuationFactor = attenuate(dist, quadLin.x, quadLin.y, colorConst.w);
+
+		vec3 lightIntensity = attenuationFactor * colorConst.rgb;
+
+		accumColor += NdotL * lightIntensity * matColor;
+
+		vec3 H = normalize(E + L);
+		float NdotH = dot(N, H);
+		if (NdotH > 0) {
+			float blinnTerm = pow(NdotH, shininess);
+			accumColor += blinnTerm * lightIntensity * specular.rgb;
+		}
+	}
+
+	out_Color = vec4(accumColor, 1.0);
+}
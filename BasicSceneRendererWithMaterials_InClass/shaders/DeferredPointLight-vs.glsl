@@ -0,0 +1,24 @@
+#version 330
+
+// unit sphere, drawn once per light
+layout(location = 0) in vec4 in_Position;
+
+uniform mat4 u_ProjectionMatrix;
+
+// lights in eye space, 3 texels each: (pos, radius), (color, attConst), (attQuad, attLin, -, -)
+uniform samplerBuffer u_LightData;
+
+// makes the tessellated sphere enclose the true sphere of influence
+uniform float u_VolumeScale;
+
+flat out int var_Light;
+
+void main()
+{
+	vec4 posRadius = texelFetch(u_LightData, 3 * gl_InstanceID);
+
+	vec3 pos = posRadius.xyz + in_Position.xyz * (posRadius.w * u_VolumeScale);
+	gl_Position = u_ProjectionMatrix * vec4(pos, 1.0);
+
+	var_Light = gl_InstanceID;
+}
@@ -0,0 +1,9 @@
+#version 330
+
+// full-screen quad with corners at (-1, -1) and (1, 1)
+layout(location = 0) in vec4 in_Position;
+
+void main()
+{
+    gl_Position = vec4(in_Position.xy, 0.0, 1.0);
+}
@@ -6,6 +6,19 @@ in vec2 var_TexCoord;		// interpolated texture coordinate
 
 // input from application
 uniform sampler2D u_TexSampler;
+uniform sampler2DArray u_TexArraySampler;
+
+// per-draw data, written to a ring buffer by the renderer
+// (must match DrawData in BasicSceneRenderer.cpp, and be the same in every shader that declares it)
+layout(std140) uniform PerDraw {
+    mat4 u_ModelviewMatrix;
+    mat3 u_NormalMatrix;
+    vec4 u_Tint;
+    vec3 u_MatEmissiveColor;
+    int u_TexLayer;             // layer in u_TexArraySampler, or -1 to use u_TexSampler
+    vec3 u_MatSpecularColor;
+    float u_MatShininess;
+};
 
 // output to framebuffer
 out vec4 out_Color;
@@ -13,7 +26,8 @@ out vec4 out_Color;
 void main()
 {
     // texture lookup
-    vec4 texColor = texture2D(u_TexSampler, var_TexCoord);
+    vec4 texColor = (u_TexLayer >= 0) ? texture(u_TexArraySampler, vec3(var_TexCoord, u_TexLayer))
+                                      : texture2D(u_TexSampler, var_TexCoord);
 
 	// apply lighting
 	out_Color.rgb = texColor.rgb * var_LightColor;
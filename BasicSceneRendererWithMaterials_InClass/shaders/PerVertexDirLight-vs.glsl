@@ -7,8 +7,18 @@ layout(location = 3) in vec2 in_TexCoord;
 
 // transformations
 uniform mat4 u_ProjectionMatrix;
-uniform mat4 u_ModelviewMatrix;
-uniform mat3 u_NormalMatrix;
+
+// per-draw data, written to a ring buffer by the renderer
+// (must match DrawData in BasicSceneRenderer.cpp, and be the same in every shader that declares it)
+layout(std140) uniform PerDraw {
+    mat4 u_ModelviewMatrix;
+    mat3 u_NormalMatrix;
+    vec4 u_Tint;
+    vec3 u_MatEmissiveColor;
+    int u_TexLayer;             // layer in u_TexArraySampler, or -1 to use u_TexSampler
+    vec3 u_MatSpecularColor;
+    float u_MatShininess;
+};
 
 // directional light info
 uniform vec3 u_LightColor;